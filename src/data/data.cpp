@@ -4,7 +4,19 @@
 
 #include "data.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel.h"
+#include "utils.h"
 
 using namespace std;
 
@@ -13,7 +25,8 @@ bool OSMData::isWayClosed(const uint32_t id) const {
 	return false;
 }
 
-#define VALUES\
+// Members of the former format, before sections
+#define LEGACY_VALUES\
 	bbox,\
 	roads,\
 	roadOffsets,\
@@ -28,45 +41,390 @@ bool OSMData::isWayClosed(const uint32_t id) const {
 	capitals,\
 	roadNames\
 
-static void readData(istream &) {}
+// Members of version 1
+#define VALUES_1\
+	bbox,\
+	roads,\
+	roadOffsets,\
+	roadTypeOffsets,\
+	waterWayTypeOffsets,\
+	boundaries,\
+	lodTolerances,\
+	lodRoads,\
+	lodRoadOffsets,\
+	refs,\
+	refOffsets,\
+	forests,\
+	forestsR,\
+	forestIndices,\
+	forestLodCounts,\
+	forestLodPoints,\
+	forestLodIndices,\
+	forestLodOffsets,\
+	names,\
+	capitals,\
+	roadNames\
 
-template<typename T, typename... Ts>
-static void readData(istream &in, T &x, Ts &... xs) {
+// Members added by a version come after those of the previous versions
+#define VALUES\
+	VALUES_1,\
+	roadChunks,\
+	roadIndices\
+
+
+// Sections are aligned so that arrays mapped in memory are aligned for any of their elements
+struct FileHeader {
+	char magic[8];
+	uint32_t version, sections;
+};
+struct Section {
+	enum Encoding : uint32_t { RAW, DELTA_VARINT };
+	uint64_t offset, count;
+	uint32_t elementSize;
+	Encoding encoding;
+};
+static constexpr char MAGIC[8] = "OSMDATA";
+// Version 2: 64 bits offsets and roadChunks
+// Version 3: encoded sections of points
+// Version 4: roadIndices
+static constexpr uint32_t VERSION = 4;
+static constexpr uint64_t ALIGNMENT = 64;
+
+static uint64_t align(const uint64_t offset) {
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// DELTA_VARINT sections of points are cut in blocks of POINT_BLOCK points decoded independently.
+// The section starts with the offset of each block and of its end, then each point is the zigzag
+// varints of the differences of its coordinates with the previous point of its block, or with 0.
+static constexpr uint64_t POINT_BLOCK = 4096;
+
+static uint64_t pointBlocks(const uint64_t count) {
+	return (count + POINT_BLOCK - 1) / POINT_BLOCK;
+}
+
+static vector<char> encodePoints(const vector<vec2i> &pts) {
+	const uint64_t blocks = pointBlocks(pts.size());
+	vector<char> out((blocks+1) * sizeof(uint64_t));
+	out.reserve(out.size() + 3 * pts.size());
+	const auto put = [&](const int64_t d) {
+		uint64_t z = uint64_t(d) << 1 ^ uint64_t(d >> 63);
+		for(; z >= 0x80; z >>= 7) out.push_back(char(z | 0x80));
+		out.push_back(char(z));
+	};
+	for(uint64_t b = 0; b <= blocks; ++b) {
+		const uint64_t offset = out.size();
+		memcpy(out.data() + b * sizeof(uint64_t), &offset, sizeof(offset));
+		vec2i prev(0, 0);
+		for(uint64_t i = b * POINT_BLOCK; i < min<uint64_t>(pts.size(), (b+1) * POINT_BLOCK); ++i) {
+			put(int64_t(pts[i].x) - prev.x);
+			put(int64_t(pts[i].y) - prev.y);
+			prev = pts[i];
+		}
+	}
+	return out;
+}
+
+// Decode the `count` points of a section of `size` bytes, one block per task
+static void decodePoints(const char *data, const uint64_t size, const uint64_t count, vec2i *pts, const char *fileName) {
+	const auto corrupted = [&]() { THROW_ERROR("Corrupted points in " + string(fileName)); };
+	vector<uint64_t> offsets(pointBlocks(count) + 1);
+	if(size < offsets.size() * sizeof(uint64_t)) corrupted();
+	memcpy(offsets.data(), data, offsets.size() * sizeof(uint64_t));
+	if(offsets[0] != offsets.size() * sizeof(uint64_t) || offsets.back() > size || !ranges::is_sorted(offsets)) corrupted();
+	parallelFor(offsets.size()-1, max(1u, thread::hardware_concurrency()), [&](const uint32_t b, uint32_t) {
+		const uint8_t *p = reinterpret_cast<const uint8_t*>(data) + offsets[b];
+		const uint8_t *const end = reinterpret_cast<const uint8_t*>(data) + offsets[b+1];
+		const auto get = [&]()->int64_t {
+			uint64_t z = 0;
+			for(uint32_t shift = 0;; shift += 7) {
+				if(p == end || shift > 63) corrupted();
+				z |= uint64_t(*p & 0x7f) << shift;
+				if(!(*p++ & 0x80)) break;
+			}
+			return int64_t(z >> 1) ^ -int64_t(z & 1);
+		};
+		vec2i prev(0, 0);
+		for(uint64_t i = b * POINT_BLOCK; i < min(count, (b+1) * POINT_BLOCK); ++i) {
+			const int64_t x = prev.x + get();
+			pts[i] = prev = vec2i(x, prev.y + get());
+		}
+		if(p != end) corrupted();
+	});
+}
+
+// Bytes of a member in the file, and its section
+struct SectionData {
+	const char *data;
+	Section section;
+	vector<char> encoded;
+
+	uint64_t size() const {
+		return section.encoding == Section::RAW ? section.count * section.elementSize : encoded.size();
+	}
+};
+
+template<typename T>
+static SectionData describe(const bool, const T &x) {
+	return {reinterpret_cast<const char*>(&x), {0, 1, sizeof(T), Section::RAW}, {}};
+}
+
+template<typename T>
+static SectionData describe(const bool encode, const vector<T> &v) {
+	if constexpr(is_same_v<T, vec2i>) if(encode) {
+		SectionData d{nullptr, {0, v.size(), sizeof(T), Section::DELTA_VARINT}, encodePoints(v)};
+		d.data = d.encoded.data();
+		return d;
+	}
+	return {reinterpret_cast<const char*>(v.data()), {0, v.size(), sizeof(T), Section::RAW}, {}};
+}
+
+template<typename... Ts>
+static uint32_t countMembers(Ts const&...) {
+	return sizeof...(Ts);
+}
+
+template<typename... Ts>
+static void writeSections(ostream &out, const bool encode, Ts const&... xs) {
+	SectionData sections[] = {describe(encode, xs)...};
+	FileHeader header{{}, VERSION, sizeof...(xs)};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	uint64_t offset = sizeof(header) + sizeof...(xs) * sizeof(Section);
+	for(SectionData &s : sections) {
+		s.section.offset = align(offset);
+		offset = s.section.offset + s.size();
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for(const SectionData &s : sections) out.write(reinterpret_cast<const char*>(&s.section), sizeof(Section));
+	offset = sizeof(header) + sizeof...(xs) * sizeof(Section);
+	static constexpr char padding[ALIGNMENT] = {};
+	for(const SectionData &s : sections) {
+		out.write(padding, s.section.offset - offset);
+		out.write(s.data, s.size());
+		offset = s.section.offset + s.size();
+	}
+}
+
+// Sections of a file, checked against the members they are read into
+struct SectionTable {
+	const char *fileName;
+	uint64_t fileSize;
+	uint32_t version;
+	vector<Section> sections;
+	size_t next = 0;
+
+	// Members added by later versions are missing from files of former versions
+	bool done() const { return next == sections.size(); }
+	const Section& peek() const { return sections[next]; }
+
+	// Only arrays of points may be encoded, the bounds of their blocks are checked while decoding
+	const Section& get(const size_t elementSize, const bool isArray, const bool mayEncode = false) {
+		const Section &s = sections[next++];
+		const bool raw = s.encoding == Section::RAW;
+		if(s.elementSize != elementSize || (!isArray && s.count != 1)
+				|| !(raw || (mayEncode && s.encoding == Section::DELTA_VARINT))
+				|| s.offset + (raw ? s.count * s.elementSize : 0) > fileSize)
+			THROW_ERROR("Corrupted section " + to_string(next-1) + " in " + string(fileName));
+		return s;
+	}
+};
+
+// Header and section table at the start of a file, or false if the file is in the former format
+static bool readSectionTable(const char *data, const uint64_t size, SectionTable &table, const uint32_t members) {
+	FileHeader header;
+	if(size < sizeof(header)) return false;
+	memcpy(&header, data, sizeof(header));
+	if(memcmp(header.magic, MAGIC, sizeof(MAGIC))) return false;
+	if(header.version > VERSION || header.sections > members || (header.version == VERSION && header.sections != members))
+		THROW_ERROR("Unsupported version " + to_string(header.version) + " of " + string(table.fileName));
+	if(size < sizeof(header) + header.sections * sizeof(Section)) THROW_ERROR("Truncated file " + string(table.fileName));
+	table.fileSize = size;
+	table.version = header.version;
+	table.sections.resize(header.sections);
+	memcpy(table.sections.data(), data + sizeof(header), header.sections * sizeof(Section));
+	return true;
+}
+
+template<typename T>
+static void readSection(istream &in, SectionTable &table, T &x) {
+	if(table.done()) return;
+	const Section &s = table.get(sizeof(T), false);
+	in.seekg(s.offset);
 	in.read(reinterpret_cast<char*>(&x), sizeof(T));
-	readData(in, xs...);
 }
 
-template<typename T, typename... Ts>
-static void readData(istream &in, vector<T> &v, Ts &... xs) {
-	volatile uint32_t size;
-	in.read(reinterpret_cast<char*>(const_cast<uint32_t*>(&size)), sizeof(size));
-	v.resize(size);
+template<typename T>
+static void readSection(istream &in, SectionTable &table, vector<T> &v) {
+	if(table.done()) return;
+	// Offsets were on 32 bits before version 2
+	if constexpr(is_same_v<T, uint64_t>) if(table.peek().elementSize == sizeof(uint32_t)) {
+		vector<uint32_t> narrow;
+		readSection(in, table, narrow);
+		v.assign(narrow.begin(), narrow.end());
+		return;
+	}
+	const Section &s = table.get(sizeof(T), true, is_same_v<T, vec2i>);
+	v.resize(s.count);
+	in.seekg(s.offset);
+	if constexpr(is_same_v<T, vec2i>) if(s.encoding == Section::DELTA_VARINT) {
+		// Offsets of the blocks, then the blocks up to the end of the last one
+		vector<char> encoded((pointBlocks(s.count)+1) * sizeof(uint64_t));
+		in.read(encoded.data(), encoded.size());
+		const size_t head = encoded.size();
+		uint64_t size;
+		memcpy(&size, encoded.data() + head - sizeof(size), sizeof(size));
+		if(!in || size < head || size > table.fileSize - s.offset) THROW_ERROR("Corrupted points in " + string(table.fileName));
+		encoded.resize(size);
+		in.read(encoded.data() + head, size - head);
+		decodePoints(encoded.data(), encoded.size(), s.count, v.data(), table.fileName);
+		return;
+	}
 	in.read(reinterpret_cast<char*>(v.data()), v.size()*sizeof(T));
-	readData(in, xs...);
 }
 
-void OSMData::read(const char *fileName) {
-	ifstream in(fileName);
-	readData(in, VALUES);
+template<typename... Ts>
+static void readSections(istream &in, SectionTable &table, Ts &... xs) {
+	(readSection(in, table, xs), ...);
 }
 
-static void writeData(ostream &) {}
+// Encoded sections are decoded in `decoded`
+template<typename T>
+static void viewSection(const char *data, SectionTable &table, vector<unique_ptr<vec2i[]>>&, T &x) {
+	if(table.done()) return;
+	memcpy(reinterpret_cast<char*>(&x), data + table.get(sizeof(T), false).offset, sizeof(T));
+}
+
+template<typename T>
+static void viewSection(const char *data, SectionTable &table, vector<unique_ptr<vec2i[]>> &decoded, span<const T> &v) {
+	if(table.done()) return;
+	const Section &s = table.get(sizeof(T), true, is_same_v<T, vec2i>);
+	if constexpr(is_same_v<T, vec2i>) if(s.encoding == Section::DELTA_VARINT) {
+		vec2i *const pts = decoded.emplace_back(make_unique_for_overwrite<vec2i[]>(s.count)).get();
+		decodePoints(data + s.offset, table.fileSize - s.offset, s.count, pts, table.fileName);
+		v = {pts, s.count};
+		return;
+	}
+	v = {reinterpret_cast<const T*>(data + s.offset), s.count};
+}
+
+template<typename... Ts>
+static void viewSections(const char *data, SectionTable &table, vector<unique_ptr<vec2i[]>> &decoded, Ts &... xs) {
+	(viewSection(data, table, decoded, xs), ...);
+}
+
+// Former format, still read: each member in turn, arrays preceded by their size on 32 bits.
+// Sizes are bounded by the bytes left in the file, which must all be read.
+struct LegacyFile {
+	const char *fileName;
+	uint64_t left;
+
+	void take(const uint64_t bytes) {
+		if(bytes > left) THROW_ERROR("Corrupted file " + string(fileName));
+		left -= bytes;
+	}
+};
+
+static void readLegacyData(istream &, LegacyFile &) {}
 
 template<typename T, typename... Ts>
-static void writeData(ostream &out, const T &x, Ts const&... xs) {
-	out.write(reinterpret_cast<const char*>(&x), sizeof(T));
-	writeData(out, xs...);
+static void readLegacyData(istream &in, LegacyFile &file, T &x, Ts &... xs) {
+	file.take(sizeof(T));
+	in.read(reinterpret_cast<char*>(&x), sizeof(T));
+	readLegacyData(in, file, xs...);
 }
 
 template<typename T, typename... Ts>
-static void writeData(ostream &out, const vector<T> &v, Ts const&... xs) {
-	volatile uint32_t size = v.size();
-	out.write(reinterpret_cast<const char*>(const_cast<uint32_t*>(&size)), sizeof(size));
-	out.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
-	writeData(out, xs...);
+static void readLegacyData(istream &in, LegacyFile &file, vector<T> &v, Ts &... xs) {
+	uint32_t size;
+	file.take(sizeof(size));
+	in.read(reinterpret_cast<char*>(&size), sizeof(size));
+	// Offsets were on 32 bits
+	using Stored = conditional_t<is_same_v<T, uint64_t>, uint32_t, T>;
+	file.take(uint64_t(size) * sizeof(Stored));
+	vector<Stored> stored(size);
+	in.read(reinterpret_cast<char*>(stored.data()), stored.size()*sizeof(Stored));
+	if constexpr(is_same_v<T, Stored>) v = std::move(stored);
+	else v.assign(stored.begin(), stored.end());
+	readLegacyData(in, file, xs...);
+}
+
+void OSMData::read(const char *fileName) {
+	ifstream in(fileName, ios::binary);
+	if(!in) THROW_ERROR("Failed to open " + string(fileName));
+	read(in, fileName);
+}
+
+void OSMData::read(istream &in, const char *fileName) {
+	const uint32_t members = countMembers(VALUES);
+	in.seekg(0, ios::end);
+	const uint64_t size = in.tellg();
+	vector<char> start(min<uint64_t>(size, sizeof(FileHeader) + members * sizeof(Section)));
+	in.seekg(0);
+	in.read(start.data(), start.size());
+	SectionTable table{fileName, 0, 0, {}};
+	if(readSectionTable(start.data(), start.size(), table, members)) {
+		table.fileSize = size;
+		readSections(in, table, VALUES);
+	} else {
+		in.seekg(0);
+		LegacyFile file{fileName, size};
+		readLegacyData(in, file, LEGACY_VALUES);
+		if(file.left || !in || roadOffsets.empty() || roadOffsets.back() != roads.size()
+				|| refOffsets.empty() || refOffsets.back() != refs.size())
+			THROW_ERROR("Corrupted file " + string(fileName));
+		// No levels of detail, and areas are not triangulated: the file must be converted again to draw them
+		lodRoadOffsets.assign(1, 0);
+		forestLodOffsets.assign(1, 0);
+	}
+	if(!in) THROW_ERROR("Truncated file " + string(fileName));
+	// Files before version 2 have less than 2^32 points in roads
+	if(roadChunks.empty()) roadChunks = {0, (uint32_t) roadOffsets.size()-1};
+}
+
+void OSMData::write(const char *fileName, const bool encode) const {
+	ofstream out(fileName, ios::binary);
+	write(out, encode);
+	if(!out) THROW_ERROR("Failed to write " + string(fileName));
+}
+
+void OSMData::write(ostream &out, const bool encode) const {
+	writeSections(out, encode, VALUES);
+}
+
+OSMView::OSMView(const char *fileName) {
+	const int fd = open(fileName, O_RDONLY);
+	if(fd < 0) THROW_ERROR("Failed to open " + string(fileName));
+	struct stat st;
+	if(fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		THROW_ERROR("Failed to read " + string(fileName));
+	}
+	mapSize = st.st_size;
+	map = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		map = nullptr;
+		THROW_ERROR("Failed to map " + string(fileName));
+	}
+	const char *data = static_cast<const char*>(map);
+	SectionTable table{fileName, 0, 0, {}};
+	// 32 bits offsets before version 2
+	if(!readSectionTable(data, mapSize, table, countMembers(VALUES)) || table.version < 2) {
+		// Former version or format, converted in memory
+		istringstream in(string(data, mapSize));
+		munmap(map, mapSize);
+		map = nullptr;
+		OSMData osm;
+		osm.read(in, fileName);
+		ostringstream out;
+		osm.write(out);
+		legacy = std::move(out).str();
+		data = legacy.data();
+		readSectionTable(data, legacy.size(), table, countMembers(VALUES));
+	}
+	viewSections(data, table, decoded, VALUES);
 }
 
-void OSMData::write(const char *fileName) const {
-	ofstream out(fileName);
-	writeData(out, VALUES);
+OSMView::~OSMView() {
+	if(map) munmap(map, mapSize);
 }
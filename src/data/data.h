@@ -5,6 +5,11 @@
 #pragma once
 
 #include <array>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "vec.h"
@@ -27,15 +32,34 @@ struct OSMData {
 
 	// polylines
 	std::vector<vec2i> roads;
-	std::vector<uint32_t> roadOffsets;
+	std::vector<uint64_t> roadOffsets;
 	std::array<uint32_t, (size_t) RoadType::NUM + 1> roadTypeOffsets;
 	std::array<uint32_t, (size_t) WaterWayType::NUM + 1> waterWayTypeOffsets;
 	std::pair<uint32_t, uint32_t> boundaries;
+	// simplified polylines, level after level: polyline i < boundaries.second of level l
+	// is lodRoads[lodRoadOffsets[l*boundaries.second + i]..lodRoadOffsets[l*boundaries.second + i+1])
+	std::vector<uint32_t> lodTolerances; // maximal distance to the polylines of each level
+	std::vector<vec2i> lodRoads;
+	std::vector<uint64_t> lodRoadOffsets;
+	// polylines roadChunks[c]..roadChunks[c+1] have at most 2^32-1 points, at full detail and at each level,
+	// so that they are indexed on 32 bits from the first point of the chunk
+	std::vector<uint32_t> roadChunks;
+	// Indexed layout, when not empty: polylines share their equal points, roads holds distinct points and
+	// point j of the polylines is roads[roadIndices[j]], roadOffsets and roadChunks indexing roadIndices
+	std::vector<uint32_t> roadIndices;
 
 	// areas
 	std::vector<uint32_t> refs;
-	std::vector<uint32_t> refOffsets;
+	std::vector<uint64_t> refOffsets;
 	std::pair<uint32_t, uint32_t> forests, forestsR;
+	// triangles of forests and forestsR by decreasing area, as indices in roads, which limits roads to 2^32 points
+	std::vector<uint32_t> forestIndices;
+	// for each level of detail: the first forestLodCounts[l] forestIndices are the areas bigger than a pixel,
+	// smaller ones are replaced by the triangles forestLodIndices[forestLodOffsets[l]..forestLodOffsets[l+1])
+	// of points in forestLodPoints
+	std::vector<uint32_t> forestLodCounts;
+	std::vector<vec2i> forestLodPoints;
+	std::vector<uint32_t> forestLodIndices, forestLodOffsets;
 
 	// named points
 	std::vector<char> names;
@@ -47,6 +71,54 @@ struct OSMData {
 	bool isWayClosed(uint32_t id) const;
 
 	// IO
+	// Files start with a header and a table of sections, each section holding one of the members
+	// at an offset aligned on 64 bytes, with 64 bits counts. Files of former versions (32 bits offsets,
+	// no chunks, no indexed layout) and of the former format, a plain sequence of members, are still read.
 	void read(const char *fileName); 
-	void write(const char *fileName) const;
+	void read(std::istream &in, const char *fileName);
+	// With `encode`, arrays of points are delta coded into varints, 1.5 to 3 times smaller,
+	// and decoded in parallel when read
+	void write(const char *fileName, bool encode = false) const;
+	void write(std::ostream &out, bool encode = false) const;
+};
+
+// Read only OSMData whose file is mapped in memory: arrays are used in place,
+// so only the pages of the sections that are used are loaded. Encoded arrays are decoded at construction.
+// Files of former versions or of the former format are read in memory instead.
+struct OSMView {
+	Box<vec2i> bbox;
+
+	std::span<const vec2i> roads;
+	std::span<const uint64_t> roadOffsets;
+	std::array<uint32_t, (size_t) RoadType::NUM + 1> roadTypeOffsets;
+	std::array<uint32_t, (size_t) WaterWayType::NUM + 1> waterWayTypeOffsets;
+	std::pair<uint32_t, uint32_t> boundaries;
+	std::span<const uint32_t> lodTolerances;
+	std::span<const vec2i> lodRoads;
+	std::span<const uint64_t> lodRoadOffsets;
+	std::span<const uint32_t> roadChunks;
+	std::span<const uint32_t> roadIndices;
+
+	std::span<const uint32_t> refs;
+	std::span<const uint64_t> refOffsets;
+	std::pair<uint32_t, uint32_t> forests, forestsR;
+	std::span<const uint32_t> forestIndices;
+	std::span<const uint32_t> forestLodCounts;
+	std::span<const vec2i> forestLodPoints;
+	std::span<const uint32_t> forestLodIndices, forestLodOffsets;
+
+	std::span<const char> names;
+	std::span<const std::pair<vec2i, uint32_t>> capitals;
+	std::span<const std::pair<vec2i, uint32_t>> roadNames;
+
+	OSMView(const char *fileName);
+	~OSMView();
+	OSMView(const OSMView&) = delete;
+	OSMView& operator=(const OSMView&) = delete;
+
+protected:
+	void *map = nullptr;
+	size_t mapSize = 0;
+	std::string legacy;
+	std::vector<std::unique_ptr<vec2i[]>> decoded;
 };
\ No newline at end of file
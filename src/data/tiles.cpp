@@ -0,0 +1,89 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "tiles.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "utils.h"
+
+using namespace std;
+
+struct TilesHeader {
+	char magic[8];
+	uint32_t version, tiles;
+	uint64_t directory;
+};
+static constexpr char MAGIC[8] = "OSMTILE";
+static constexpr uint32_t VERSION = 1;
+// Leaves are aligned as sections of OSMData files
+static constexpr uint64_t ALIGNMENT = 64;
+
+TileSet::TileSet(const char *fileName): fileName(fileName) {
+	ifstream in(fileName, ios::binary);
+	if(!in) THROW_ERROR("Failed to open " + string(fileName));
+	TilesHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(!in || memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.version != VERSION)
+		THROW_ERROR("Not a tiles file of version " + to_string(VERSION) + ": " + string(fileName));
+	tiles.resize(header.tiles);
+	in.seekg(header.directory);
+	in.read(reinterpret_cast<char*>(tiles.data()), tiles.size() * sizeof(Tile));
+	if(!in || tiles.empty()) THROW_ERROR("Truncated file " + string(fileName));
+	for(const Tile &t : tiles)
+		if(t.children != LEAF && (t.children >= tiles.size() || tiles.size() - t.children < 4))
+			THROW_ERROR("Corrupted directory in " + string(fileName));
+}
+
+vector<uint32_t> TileSet::query(const Box<vec2i> &viewport) const {
+	vector<uint32_t> leaves, stack = {0};
+	while(!stack.empty()) {
+		const uint32_t i = stack.back();
+		stack.pop_back();
+		const Tile &t = tiles[i];
+		if(viewport.max.x < t.bbox.min.x || t.bbox.max.x <= viewport.min.x
+			|| viewport.max.y < t.bbox.min.y || t.bbox.max.y <= viewport.min.y) continue;
+		if(t.children == LEAF) leaves.push_back(i);
+		else for(uint32_t c = 4; c--;) stack.push_back(t.children + c);
+	}
+	return leaves;
+}
+
+OSMData TileSet::load(const uint32_t tile) const {
+	const Tile &t = tiles[tile];
+	if(t.children != LEAF) THROW_ERROR("Tile " + to_string(tile) + " is not a leaf");
+	ifstream in(fileName, ios::binary);
+	string bytes(t.size, '\0');
+	in.seekg(t.offset);
+	in.read(bytes.data(), bytes.size());
+	if(!in) THROW_ERROR("Truncated file " + fileName);
+	istringstream tileIn(std::move(bytes));
+	OSMData data;
+	data.read(tileIn, fileName.c_str());
+	return data;
+}
+
+void TileSet::writeHeader(ostream &out) {
+	const TilesHeader header{};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void TileSet::writeLeaf(ostream &out, const uint32_t tile, const OSMData &data, const bool encode) {
+	static constexpr char padding[ALIGNMENT] = {};
+	const uint64_t end = out.tellp();
+	out.write(padding, (ALIGNMENT - end % ALIGNMENT) % ALIGNMENT);
+	tiles[tile].offset = out.tellp();
+	data.write(out, encode);
+	tiles[tile].size = uint64_t(out.tellp()) - tiles[tile].offset;
+}
+
+void TileSet::writeDirectory(ostream &out) const {
+	TilesHeader header{{}, VERSION, (uint32_t) tiles.size(), (uint64_t) out.tellp()};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	out.write(reinterpret_cast<const char*>(tiles.data()), tiles.size() * sizeof(Tile));
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
@@ -0,0 +1,44 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vec.h"
+
+#include "data.h"
+
+// Quadtree of tiles, each leaf being an OSMData whose polylines and areas are clipped to its box.
+// The file starts with a header, then the OSMData of the leaves, then the directory of all the tiles.
+struct TileSet {
+	static inline constexpr uint32_t LEAF = -1;
+
+	struct Tile {
+		Box<vec2i> bbox; // points p with bbox.min <= p < bbox.max
+		uint32_t children; // index of the first of the 4 children, LEAF for leaves
+		uint32_t level;
+		uint64_t offset, size; // bytes of the OSMData of a leaf in the file
+	};
+	// Tile 0 is the root
+	std::vector<Tile> tiles;
+
+	TileSet() = default;
+	TileSet(const char *fileName);
+
+	// Leaves intersecting the viewport, whose bounds are included
+	std::vector<uint32_t> query(const Box<vec2i> &viewport) const;
+	OSMData load(uint32_t tile) const;
+
+	// Writes the header, then the leaves are appended with writeLeaf, and writeDirectory ends the file
+	static void writeHeader(std::ostream &out);
+	void writeLeaf(std::ostream &out, uint32_t tile, const OSMData &data, bool encode);
+	void writeDirectory(std::ostream &out) const;
+
+protected:
+	std::string fileName;
+};
@@ -6,11 +6,10 @@
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <numbers>
-#include <numeric>
 #include <ranges>
 
-#include "triangulate.h"
 #include "utils.h"
 #include "vec.h"
 #include "window.h"
@@ -42,148 +41,11 @@ int main(int argc, const char* argv[]) {
 		return 1;
 	}
 
-	// Get data
-	OSMData data;
-	data.read(argv[1]);
-
-	// Triangulate multipolygons
-	vector<uint32_t> forestIndices;
-	vector<pair<uint32_t, uint32_t>> edgesA, edgesB;
-	const auto vec2Comp = [&](const vec2i &a, const vec2i &b) {
-		return a.x < b.x || (a.x == b.x && a.y < b.y);
-	};
-	const auto edgeComp = [&](const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b) {
-		const vec2i &u = data.roads[a.first], &v = data.roads[b.first];
-		if(u == v) [[unlikely]] return vec2Comp(data.roads[a.second], data.roads[b.second]);
-		return vec2Comp(u, v);
-	};
-	for(const uint32_t i : views::iota(data.forestsR.first, data.forestsR.second)) {
-		const span<uint32_t> refs(data.refs.data() + data.refOffsets[i], data.refs.data() + data.refOffsets[i+1]);
-		size_t size = 0;
-		for(const uint32_t j : refs) size += data.roadOffsets[j+1]-data.roadOffsets[j];
-		unique_ptr<uint32_t[]> remap(new uint32_t[size + refs.size()]);
-		uint32_t *const ends = remap.get() + size;
-		bool out = true;
-		edgesA.clear();
-		edgesB.clear();
-		for(auto j = refs.begin(); j != refs.end(); ++j) {
-			// get a closed way
-			uint32_t *m = remap.get() + (data.roadOffsets[*j+1] - data.roadOffsets[*j]);
-			iota(remap.get(), m, data.roadOffsets[*j]);
-			if(!data.isWayClosed(*j)) {
-				while(data.roads[remap[0]] != data.roads[*(m-1)]) {
-					if((++j) == refs.end()) THROW_ERROR("way not closed");
-					uint32_t *const m0 = m;
-					m += data.roadOffsets[*j+1] - data.roadOffsets[*j] - 1;
-					if(data.roads[*(m0-1)] == data.roads[data.roadOffsets[*j]]) {
-						iota(m0, m, data.roadOffsets[*j]+1);
-					} else if(data.roads[*(m0-1)] == data.roads[data.roadOffsets[*j+1]-1]) {
-						ranges::iota(span(m0, m) | views::reverse, data.roadOffsets[*j]);
-					} else THROW_ERROR("way not closed");
-				}
-				--m;
-			}
-
-			// correct orientation
-			int64_t area = 0;
-			const int N = m-remap.get();
-			for(int i = 0; i < N; ++i) {
-				const vec2i &a = data.roads[remap[i]];
-				const vec2i &b = data.roads[remap[(i+1)%N]];
-				area += int64_t(a.x - b.x) * (a.y + b.y);
-			}
-			if(out != (area > 0)) reverse(remap.get(), m);
-			out = false;
-
-			// update graph
-			for(int i = 0; i < N; ++i) {
-				const uint32_t a = remap[i];
-				const uint32_t b = remap[(i+1)%N];
-				if(vec2Comp(data.roads[a], data.roads[b])) edgesA.emplace_back(a, b);
-				else edgesB.emplace_back(b, a);
-			}
-		}
-
-		ranges::sort(edgesA, edgeComp);
-		ranges::sort(edgesB, edgeComp);
-		auto itA = edgesA.begin(), itB = edgesB.begin();
-		auto wA = itA, wB = itB;
-		while(itA != edgesA.end() && itB != edgesB.end()) {
-			const vec2i &u = data.roads[itA->first], &v = data.roads[itB->first];
-			if(u != v) {
-				if(vec2Comp(u, v)) *(wA++) = *(itA++);
-				else *(wB++) = *(itB++);
-				continue;
-			}
-			const vec2i &u2 = data.roads[itA->second], &v2 = data.roads[itB->second];
-			if(u2 != v2) {
-				if(vec2Comp(u2, v2)) *(wA++) = *(itA++);
-				else *(wB++) = *(itB++);
-				continue;
-			}
-			++ itA;
-			++ itB;
-		}
-		wA = copy(itA, edgesA.end(), wA);
-		wB = copy(itB, edgesB.end(), wB);
-		edgesB.resize(wB - edgesB.begin());
-		edgesA.resize((wA - edgesA.begin()) + edgesB.size());
-		for(auto &[a, b] : edgesB) swap(a, b);
-		ranges::sort(edgesB, edgeComp);
-		wA = edgesA.end();
-		itA = wA - edgesB.size();
-		itB = edgesB.end();
-		while(itA != edgesA.begin() && itB != edgesB.begin()) {
-			const vec2i &u = data.roads[(itA-1)->first], &v = data.roads[(itB-1)->first];
-			*(--wA) = vec2Comp(u, v) ? *(--itB) : *(--itA);
-		}
-		copy(edgesB.begin(), itB, edgesA.begin());
-		bool bad = false;
-		for(int j = 1; j < (int) edgesA.size(); ++j) {
-			if(data.roads[edgesA[j-1].first] == data.roads[edgesA[j].first]) {
-				bad = true;
-				break;
-			}
-		}
-		if(bad) {
-			cerr << "touching holes: " << i - data.forestsR.first << ' ' << refs.size() << endl;
-			continue;
-		}
-
-		uint32_t *e = ends;
-		uint32_t *m = remap.get();
-		uint32_t n_out = 0;
-		for(auto &[a, b] : edgesA) {
-			if(b == numeric_limits<uint32_t>::max()) continue;
-			*(m++) = a;
-			vec2i *u = data.roads.data() + b;
-			b = numeric_limits<uint32_t>::max();
-			const vec2i &v = data.roads[a];
-			int64_t area = int64_t(v.x - u->x) * (v.y + u->y);
-			while(*u != v) {
-				auto it = ranges::lower_bound(edgesA, *u, vec2Comp, [&](const pair<uint32_t, uint32_t> &edge) {
-					return data.roads[edge.first];
-				});
-				if(it == edgesA.end() || data.roads[it->first] != *u) THROW_ERROR("dsqf,sdjkg");
-				vec2i* const u2 = data.roads.data() + it->second;
-				area += int64_t(u->x - u2->x) * (u->y + u2->y);
-				u = u2;
-				it->second = numeric_limits<uint32_t>::max();
-				*(m++) = it->first;
-			}
-			*(e++) = m - remap.get();
-			if(area > 0) ++ n_out;
-		}
-
-		unique_ptr<vec2i[]> pts(new vec2i[m - remap.get()]);
-		transform(remap.get(), m, pts.get(), [&](const uint32_t j) {
-			return data.roads[j];
-		});
-		const vector<uint32_t> indices = triangulate(pts.get(), ends, e-ends, n_out);
-		forestIndices.insert_range(forestIndices.end(), indices | views::transform([&](const uint32_t i) {
-			return remap[i];
-		}));
-	}
+	// Get data, mapped so that sections the viewer does not use are never loaded
+	const OSMView data(argv[1]);
+	// Files of the former format have areas but not their triangles
+	if(data.forestIndices.empty() && (data.forests.first < data.forests.second || data.forestsR.first < data.forestsR.second))
+		cerr << "Warning: the areas of " << argv[1] << " are not triangulated and will not be drawn, convert it again to draw them\n";
 
 	// Create window
 	Window window;
@@ -203,7 +65,7 @@ int main(int argc, const char* argv[]) {
 			wr.col = styles[i].col;
 			wr.col2 = styles[i].col2;
 			wr.border = styles[i].border;
-			wr.offset = (const void*) (CMDcount * sizeof(DrawCommand));
+			wr.first = CMDcount;
 			CMDcount += (wr.count = typeOff[i+1] - typeOff[i]);
 		}
 	};
@@ -213,53 +75,126 @@ int main(int argc, const char* argv[]) {
 		Window::Road &wr = window.roads.emplace_back();
 		wr.col = countryBorderColor;
 		wr.border = false;
-		wr.offset = (const void*) (CMDcount * sizeof(DrawCommand));
+		wr.first = CMDcount;
 		CMDcount += (wr.count = data.boundaries.second - data.boundaries.first);
 	}
-	// Forests
-	window.forestsCount =
-		3 * (data.roadOffsets[data.forests.second] - data.roadOffsets[data.forests.first])
-		- 6 * (data.forests.second - data.forests.first)
-		+ forestIndices.size();
-	// Capitals points
-	window.capitalsFirst = data.roads.size();
-	window.capitalsCount = data.capitals.size();
+	// Forests, with the aggregates of levels of detail after them in the EBO
+	window.forestsCount = data.forestIndices.size();
+	for(uint32_t l = 0; l < data.forestLodCounts.size(); ++l) {
+		window.forestLods.push_back({
+			(GLsizei) data.forestLodCounts[l],
+			(const void*) ((data.forestIndices.size() + data.forestLodOffsets[l]) * sizeof(uint32_t)),
+			(GLsizei) (data.forestLodOffsets[l+1] - data.forestLodOffsets[l])
+		});
+	}
+	// Polylines are drawn by chunks, each indexing its points on 32 bits from its own offset in the VBO,
+	// while forests index the points of the polylines and the EBO holds 32 bits indices
+	if(data.capitals.size() > (size_t) numeric_limits<GLsizei>::max()
+			|| data.forestIndices.size() + data.forestLodIndices.size() > (size_t) numeric_limits<GLsizei>::max())
+		THROW_ERROR("Too many capitals or areas for the viewer, convert a smaller extract");
+	const uint32_t P = data.boundaries.second;
+	const uint32_t lods = data.lodTolerances.size();
+	for(uint32_t c = 0; c+1 < data.roadChunks.size(); ++c) {
+		const uint32_t first = min(data.roadChunks[c], P), end = min(data.roadChunks[c+1], P);
+		for(uint32_t l = 0; l <= lods; ++l) {
+			const uint64_t *const offsets = l ? data.lodRoadOffsets.data() + (l-1) * P : data.roadOffsets.data();
+			if(offsets[end] - offsets[first] > numeric_limits<GLuint>::max())
+				THROW_ERROR("Chunk of more than 2^32 points, convert with --chunk-vertices");
+		}
+	}
 
-	// VBO, EBO, cmdBuffer
-	GLuint VBO, EBO;
-	glCreateBuffers(1, &VBO);
-	glNamedBufferStorage(VBO, (window.capitalsFirst + window.capitalsCount) * sizeof(vec2f), nullptr, GL_MAP_WRITE_BIT);
-	glCreateBuffers(1, &EBO);
-	glNamedBufferStorage(EBO, window.forestsCount * sizeof(uint32_t), nullptr, GL_MAP_WRITE_BIT);
-	glCreateBuffers(1, &window.cmdBuffer);
-	glNamedBufferStorage(window.cmdBuffer, CMDcount * sizeof(DrawCommand), nullptr, GL_MAP_WRITE_BIT);
-	vec2f* bufMap = (vec2f*) glMapNamedBuffer(VBO, GL_WRITE_ONLY);
+	// VBO: polylines, their levels of detail, capitals and the points of aggregated forests
+	glCreateBuffers(1, &window.VBO);
+	const size_t lodFirst = data.roads.size();
+	const size_t capitalsFirst = lodFirst + data.lodRoads.size();
+	const size_t forestLodFirst = capitalsFirst + data.capitals.size();
+	glNamedBufferStorage(window.VBO, (forestLodFirst + data.forestLodPoints.size()) * sizeof(vec2f), nullptr, GL_MAP_WRITE_BIT);
+	vec2f* bufMap = (vec2f*) glMapNamedBuffer(window.VBO, GL_WRITE_ONLY);
 	bufMap = ranges::transform(data.roads, bufMap, mercator).out;
+	bufMap = ranges::transform(data.lodRoads, bufMap, mercator).out;
 	bufMap = ranges::transform(data.capitals, bufMap, [&](const auto &c) { return mercator(c.first); }).out;
-	glUnmapNamedBuffer(VBO);
-	DrawCommand *cmdMap = (DrawCommand*) glMapNamedBuffer(window.cmdBuffer, GL_WRITE_ONLY);
-	for(uint32_t i = 0; i < data.boundaries.second; ++i) {
-		cmdMap[i].count = data.roadOffsets[i+1] - data.roadOffsets[i];
-		cmdMap[i].instanceCount = 1;
-		cmdMap[i].first = data.roadOffsets[i];
-		cmdMap[i].baseInstance = 0;
+	bufMap = ranges::transform(data.forestLodPoints, bufMap, mercator).out;
+	glUnmapNamedBuffer(window.VBO);
+	window.capitalsOffset = capitalsFirst * sizeof(vec2f);
+	window.capitalsCount = data.capitals.size();
+	window.forestLodPointsOffset = forestLodFirst * sizeof(vec2f);
+
+	// Chunks. Polylines of the indexed layout are drawn at full detail through the indices of their chunk.
+	window.indexedRoads = !data.roadIndices.empty();
+	for(uint32_t c = 0; c+1 < data.roadChunks.size(); ++c) {
+		const uint32_t first = min(data.roadChunks[c], P), end = min(data.roadChunks[c+1], P);
+		Window::Chunk &chunk = window.chunks.emplace_back();
+		chunk.first = first;
+		chunk.count = end - first;
+		chunk.offsets.push_back(window.indexedRoads ? 0 : data.roadOffsets[first] * sizeof(vec2f));
+		for(uint32_t l = 0; l < lods; ++l)
+			chunk.offsets.push_back((lodFirst + data.lodRoadOffsets[l * P + first]) * sizeof(vec2f));
+		chunk.EBO = 0;
+		if(!window.indexedRoads) continue;
+		const span<const uint32_t> indices = data.roadIndices.subspan(data.roadOffsets[first], data.roadOffsets[end] - data.roadOffsets[first]);
+		glCreateBuffers(1, &chunk.EBO);
+		glNamedBufferStorage(chunk.EBO, max<size_t>(indices.size(), 1) * sizeof(uint32_t), nullptr, GL_MAP_WRITE_BIT);
+		GLuint *indMap = (GLuint*) glMapNamedBuffer(chunk.EBO, GL_WRITE_ONLY);
+		ranges::copy(indices, indMap);
+		glUnmapNamedBuffer(chunk.EBO);
 	}
-	glUnmapNamedBuffer(window.cmdBuffer);
-	GLuint *indMap = (GLuint*) glMapNamedBuffer(EBO, GL_WRITE_ONLY);
-	for(uint32_t i = data.forests.first; i < data.forests.second; ++i) {
-		const vector<uint32_t> indices = triangulate(
-			data.roads.data() + data.roadOffsets[i],
-			data.roadOffsets[i+1]-data.roadOffsets[i]
-		);
-		indMap = ranges::transform(indices, indMap, [&](uint32_t x) { return x + data.roadOffsets[i]; }).out;
+
+	// cmdBuffer, levels of detail after full detail commands
+	const GLsizeiptr fullDetailSize = CMDcount * (window.indexedRoads ? sizeof(DrawElementsCommand) : sizeof(DrawCommand));
+	for(uint32_t l = 0; l <= lods; ++l)
+		window.lodOffsets.push_back(l ? fullDetailSize + (l-1) * CMDcount * sizeof(DrawCommand) : 0);
+	for(const uint32_t tolerance : data.lodTolerances) {
+		// The level is drawn while its tolerance is below half a pixel, a pixel being 2/scale radians of longitude
+		window.lodScales.push_back(180e7 / (numbers::pi * tolerance));
+	}
+	glCreateBuffers(1, &window.cmdBuffer);
+	glNamedBufferStorage(window.cmdBuffer, fullDetailSize + lods * CMDcount * sizeof(DrawCommand), nullptr, GL_MAP_WRITE_BIT);
+	char *cmdMap = (char*) glMapNamedBuffer(window.cmdBuffer, GL_WRITE_ONLY);
+	for(const Window::Chunk &chunk : window.chunks) {
+		const uint32_t first = chunk.first, end = chunk.first + chunk.count;
+		if(window.indexedRoads) {
+			DrawElementsCommand *const fullMap = (DrawElementsCommand*) cmdMap;
+			for(uint32_t i = first; i < end; ++i) {
+				fullMap[i].count = data.roadOffsets[i+1] - data.roadOffsets[i];
+				fullMap[i].instanceCount = 1;
+				fullMap[i].firstIndex = data.roadOffsets[i] - data.roadOffsets[first];
+				fullMap[i].baseVertex = 0;
+				fullMap[i].baseInstance = 0;
+			}
+		} else {
+			DrawCommand *const fullMap = (DrawCommand*) cmdMap;
+			for(uint32_t i = first; i < end; ++i) {
+				fullMap[i].count = data.roadOffsets[i+1] - data.roadOffsets[i];
+				fullMap[i].instanceCount = 1;
+				fullMap[i].first = data.roadOffsets[i] - data.roadOffsets[first];
+				fullMap[i].baseInstance = 0;
+			}
+		}
+		for(uint32_t l = 0; l < lods; ++l) {
+			DrawCommand *const levelMap = (DrawCommand*) (cmdMap + window.lodOffsets[l+1]);
+			const uint64_t *const levelOffsets = data.lodRoadOffsets.data() + l * P;
+			for(uint32_t i = first; i < end; ++i) {
+				levelMap[i].count = levelOffsets[i+1] - levelOffsets[i];
+				levelMap[i].instanceCount = 1;
+				levelMap[i].first = levelOffsets[i] - levelOffsets[first];
+				levelMap[i].baseInstance = 0;
+			}
+		}
 	}
-	indMap = ranges::copy(forestIndices, indMap).out;
-	glUnmapNamedBuffer(EBO);
+	glUnmapNamedBuffer(window.cmdBuffer);
+
+	// EBO of forests, the aggregates indexing the points of aggregated forests
+	glCreateBuffers(1, &window.EBO);
+	glNamedBufferStorage(window.EBO, max<size_t>(data.forestIndices.size() + data.forestLodIndices.size(), 1) * sizeof(uint32_t), nullptr, GL_MAP_WRITE_BIT);
+	GLuint *indMap = (GLuint*) glMapNamedBuffer(window.EBO, GL_WRITE_ONLY);
+	indMap = ranges::copy(data.forestIndices, indMap).out;
+	ranges::copy(data.forestLodIndices, indMap);
+	glUnmapNamedBuffer(window.EBO);
 
-	// VAO
+	// VAO, its vertex and element buffers being bound again for each chunk and for each kind of draw
 	glCreateVertexArrays(1, &window.VAO);
-	glVertexArrayVertexBuffer(window.VAO, 0, VBO, 0, sizeof(vec2f));
-	glVertexArrayElementBuffer(window.VAO, EBO);
+	glVertexArrayVertexBuffer(window.VAO, 0, window.VBO, 0, sizeof(vec2f));
+	glVertexArrayElementBuffer(window.VAO, window.EBO);
 	window.progs.main.bind_p(window.VAO, 0, 0);
 
 	// Text VBO
@@ -0,0 +1,40 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Run f(task, thread) for every task in [0, N) on `threads` threads.
+// Tasks are handed out in increasing order. The first exception thrown by a task
+// stops the distribution of new tasks and is rethrown once all threads joined.
+template<typename F>
+void parallelFor(const uint32_t N, const uint32_t threads, F &&f) {
+	if(threads <= 1) {
+		for(uint32_t i = 0; i < N; ++i) f(i, 0u);
+		return;
+	}
+	std::atomic<uint32_t> next = 0;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	{
+		std::vector<std::jthread> workers;
+		workers.reserve(threads);
+		for(uint32_t t = 0; t < threads; ++t) workers.emplace_back([&, t]() {
+			try {
+				for(uint32_t i; (i = next++) < N;) f(i, t);
+			} catch(...) {
+				next = N;
+				const std::lock_guard lock(errorMutex);
+				if(!error) error = std::current_exception();
+			}
+		});
+	}
+	if(error) std::rethrow_exception(error);
+}
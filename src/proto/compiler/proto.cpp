@@ -401,6 +401,7 @@ int main(int argc, char* argv[]) {
 	const filesystem::path outputDir = argv[2];
 
 	ofstream Hfile(outputDir / (protoPath.stem() += ".pb.h"));
+	Hfile << "#pragma once\n\n";
 	Hfile << "#include <cstdint>\n";
 	Hfile << "#include <string>\n";
 	Hfile << "#include <span>\n";
@@ -486,6 +487,8 @@ int main(int argc, char* argv[]) {
 		}
 		Hfile << "\n\t" << msg.name << "() = default;\n";
 		Hfile << "\t" << msg.name << "(const std::span<const uint8_t> &wire);\n";
+		Hfile << "\t// Append the wire of the message\n";
+		Hfile << "\tvoid write(std::vector<uint8_t> &wire) const;\n";
 		if(msg.non_default) Hfile << "\t~" << msg.name << "();\n";
 		Hfile << "};\n";
 	}
@@ -577,6 +580,48 @@ int main(int argc, char* argv[]) {
 		Cfile << "\t\t}\n";
 	};
 
+	// Write one value `var` of a field, or all the values of a packed field
+	const auto writeField = [&](const string &var, const Field::Type ftype, const uint32_t number, const Field::Label label, const string &indent) {
+		switch(ftype) {
+		case Field::Type::MSG:
+			Cfile << indent << "writeKey(wire, " << number << ", 2);\n";
+			Cfile << indent << "const std::size_t start = wire.size();\n";
+			Cfile << indent << var << ".write(wire);\n";
+			Cfile << indent << "writeLength(wire, start);\n";
+			break;
+		case Field::Type::STRING:
+		case Field::Type::BYTES:
+			Cfile << indent << "writeKey(wire, " << number << ", 2);\n";
+			Cfile << indent << "writeBytes(wire, " << var << ");\n";
+			break;
+		case Field::Type::ENUM:
+		case Field::Type::BOOL:
+		case Field::Type::INT32:
+		case Field::Type::INT64:
+		case Field::Type::SINT32:
+		case Field::Type::SINT64:
+		case Field::Type::UINT32: {
+			// Negative int32 are sign extended to 64 bits, as protobuf does
+			const bool zigzag = ftype == Field::Type::SINT32 || ftype == Field::Type::SINT64;
+			const auto value = [&](const string &x) {
+				return zigzag ? "writeSint64(wire, " + x + ")" : "writeInt64(wire, int64_t(" + x + "))";
+			};
+			if(label == Field::Label::PACKED) {
+				Cfile << indent << "writeKey(wire, " << number << ", 2);\n";
+				Cfile << indent << "const std::size_t start = wire.size();\n";
+				Cfile << indent << "for(const auto x : " << var << ") " << value("x") << ";\n";
+				Cfile << indent << "writeLength(wire, start);\n";
+			} else {
+				Cfile << indent << "writeKey(wire, " << number << ", 0);\n";
+				Cfile << indent << value(var) << ";\n";
+			}
+			break;
+		}
+		default:
+			cerr << "Not implemented (" << __FILE__ << ':' << __LINE__ << "): " << ftype << endl;
+		}
+	};
+
 	for(const Message &msg : messages) {
 		// Destroy
 		for(const Field &f : msg.fields) if(f.non_default) {
@@ -653,6 +698,51 @@ int main(int argc, char* argv[]) {
 		}
 		Cfile << "}\n\n";
 
+		// Write
+		Cfile << "void " << msg.name << "::write(vector<uint8_t> &wire) const {\n";
+		for(const Field &f : msg.fields) {
+			switch(f.label) {
+			case Field::Label::REQUIRED:
+				Cfile << "\t{\n";
+				writeField(f.name, f.type, f.number, f.label, "\t\t");
+				Cfile << "\t}\n";
+				break;
+			case Field::Label::OPTIONAL:
+				Cfile << "\tif(_has_" << f.name << ") {\n";
+				writeField(f.name, f.type, f.number, f.label, "\t\t");
+				Cfile << "\t}\n";
+				break;
+			case Field::Label::REPEATED:
+				Cfile << "\tfor(const auto &x : " << f.name << ") {\n";
+				writeField("x", f.type, f.number, f.label, "\t\t");
+				Cfile << "\t}\n";
+				break;
+			case Field::Label::PACKED:
+				Cfile << "\tif(!" << f.name << ".empty()) {\n";
+				writeField(f.name, f.type, f.number, f.label, "\t\t");
+				Cfile << "\t}\n";
+				break;
+			case Field::Label::ONEOF: {
+				string FNAME = f.name, CNAME;
+				for(char &c : FNAME) c = toupper(c);
+				Cfile << "\tswitch(_" << f.name << "_choice) {\n";
+				for(const Field::Case &c : f.cases) {
+					CNAME = c.name;
+					for(char &c : CNAME) c = toupper(c);
+					Cfile << "\tcase " << FNAME << "_" << CNAME << ": {\n";
+					writeField(f.name + "." + c.name, c.type, c.number, f.label, "\t\t");
+					Cfile << "\t\tbreak;\n";
+					Cfile << "\t}\n";
+				}
+				Cfile << "\tdefault:\n";
+				Cfile << "\t\tbreak;\n";
+				Cfile << "\t}\n";
+				break;
+			}
+			}
+		}
+		Cfile << "}\n\n";
+
 		if(!msg.non_default) continue;
 		// Destructor
 		Cfile << msg.name << "::~" << msg.name << "() {\n";
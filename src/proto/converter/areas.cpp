@@ -0,0 +1,265 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "areas.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <unordered_map>
+
+#include "parallel.h"
+#include "triangulate.h"
+#include "utils.h"
+
+using namespace std;
+
+using Edges = vector<pair<uint32_t, uint32_t>>;
+
+static bool vec2Comp(const vec2i &a, const vec2i &b) {
+	return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+// Indices in data.roads of the triangles of multipolygon i:
+// its ways are stitched into loops, oriented, and loops sharing edges are merged.
+// Multipolygons whose loops touch at a node are counted in `touching` and not triangulated.
+static vector<uint32_t> triangulateRelation(const OSMData &data, const uint32_t i, Edges &edgesA, Edges &edgesB, atomic<uint32_t> &touching) {
+	const auto edgeComp = [&](const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b) {
+		const vec2i &u = data.roads[a.first], &v = data.roads[b.first];
+		if(u == v) [[unlikely]] return vec2Comp(data.roads[a.second], data.roads[b.second]);
+		return vec2Comp(u, v);
+	};
+	const span<const uint32_t> refs(data.refs.data() + data.refOffsets[i], data.refs.data() + data.refOffsets[i+1]);
+	size_t size = 0;
+	for(const uint32_t j : refs) size += data.roadOffsets[j+1]-data.roadOffsets[j];
+	unique_ptr<uint32_t[]> remap(new uint32_t[size + refs.size()]);
+	uint32_t *const ends = remap.get() + size;
+	bool out = true;
+	edgesA.clear();
+	edgesB.clear();
+	for(auto j = refs.begin(); j != refs.end(); ++j) {
+		// get a closed way
+		uint32_t *m = remap.get() + (data.roadOffsets[*j+1] - data.roadOffsets[*j]);
+		iota(remap.get(), m, data.roadOffsets[*j]);
+		if(!data.isWayClosed(*j)) {
+			while(data.roads[remap[0]] != data.roads[*(m-1)]) {
+				if((++j) == refs.end()) THROW_ERROR("way not closed");
+				uint32_t *const m0 = m;
+				m += data.roadOffsets[*j+1] - data.roadOffsets[*j] - 1;
+				if(data.roads[*(m0-1)] == data.roads[data.roadOffsets[*j]]) {
+					iota(m0, m, data.roadOffsets[*j]+1);
+				} else if(data.roads[*(m0-1)] == data.roads[data.roadOffsets[*j+1]-1]) {
+					ranges::iota(span(m0, m) | views::reverse, data.roadOffsets[*j]);
+				} else THROW_ERROR("way not closed");
+			}
+			--m;
+		}
+
+		// correct orientation
+		int64_t area = 0;
+		const int N = m-remap.get();
+		for(int i = 0; i < N; ++i) {
+			const vec2i &a = data.roads[remap[i]];
+			const vec2i &b = data.roads[remap[(i+1)%N]];
+			area += int64_t(a.x - b.x) * (a.y + b.y);
+		}
+		if(out != (area > 0)) reverse(remap.get(), m);
+		out = false;
+
+		// update graph
+		for(int i = 0; i < N; ++i) {
+			const uint32_t a = remap[i];
+			const uint32_t b = remap[(i+1)%N];
+			if(vec2Comp(data.roads[a], data.roads[b])) edgesA.emplace_back(a, b);
+			else edgesB.emplace_back(b, a);
+		}
+	}
+
+	ranges::sort(edgesA, edgeComp);
+	ranges::sort(edgesB, edgeComp);
+	auto itA = edgesA.begin(), itB = edgesB.begin();
+	auto wA = itA, wB = itB;
+	while(itA != edgesA.end() && itB != edgesB.end()) {
+		const vec2i &u = data.roads[itA->first], &v = data.roads[itB->first];
+		if(u != v) {
+			if(vec2Comp(u, v)) *(wA++) = *(itA++);
+			else *(wB++) = *(itB++);
+			continue;
+		}
+		const vec2i &u2 = data.roads[itA->second], &v2 = data.roads[itB->second];
+		if(u2 != v2) {
+			if(vec2Comp(u2, v2)) *(wA++) = *(itA++);
+			else *(wB++) = *(itB++);
+			continue;
+		}
+		++ itA;
+		++ itB;
+	}
+	wA = copy(itA, edgesA.end(), wA);
+	wB = copy(itB, edgesB.end(), wB);
+	edgesB.resize(wB - edgesB.begin());
+	edgesA.resize((wA - edgesA.begin()) + edgesB.size());
+	for(auto &[a, b] : edgesB) swap(a, b);
+	ranges::sort(edgesB, edgeComp);
+	wA = edgesA.end();
+	itA = wA - edgesB.size();
+	itB = edgesB.end();
+	while(itA != edgesA.begin() && itB != edgesB.begin()) {
+		const vec2i &u = data.roads[(itA-1)->first], &v = data.roads[(itB-1)->first];
+		*(--wA) = vec2Comp(u, v) ? *(--itB) : *(--itA);
+	}
+	copy(edgesB.begin(), itB, edgesA.begin());
+	bool bad = false;
+	for(int j = 1; j < (int) edgesA.size(); ++j) {
+		if(data.roads[edgesA[j-1].first] == data.roads[edgesA[j].first]) {
+			bad = true;
+			break;
+		}
+	}
+	if(bad) {
+		++ touching;
+		return {};
+	}
+
+	uint32_t *e = ends;
+	uint32_t *m = remap.get();
+	uint32_t n_out = 0;
+	for(auto &[a, b] : edgesA) {
+		if(b == numeric_limits<uint32_t>::max()) continue;
+		*(m++) = a;
+		const vec2i *u = data.roads.data() + b;
+		b = numeric_limits<uint32_t>::max();
+		const vec2i &v = data.roads[a];
+		int64_t area = int64_t(v.x - u->x) * (v.y + u->y);
+		while(*u != v) {
+			auto it = ranges::lower_bound(edgesA, *u, vec2Comp, [&](const pair<uint32_t, uint32_t> &edge) {
+				return data.roads[edge.first];
+			});
+			if(it == edgesA.end() || data.roads[it->first] != *u)
+				THROW_ERROR("Multipolygon " + to_string(i - data.forestsR.first) + " of the forests has a loop that is not closed");
+			const vec2i* const u2 = data.roads.data() + it->second;
+			area += int64_t(u->x - u2->x) * (u->y + u2->y);
+			u = u2;
+			it->second = numeric_limits<uint32_t>::max();
+			*(m++) = it->first;
+		}
+		*(e++) = m - remap.get();
+		if(area > 0) ++ n_out;
+	}
+
+	unique_ptr<vec2i[]> pts(new vec2i[m - remap.get()]);
+	transform(remap.get(), m, pts.get(), [&](const uint32_t j) {
+		return data.roads[j];
+	});
+	vector<uint32_t> indices = triangulate(pts.get(), ends, e-ends, n_out);
+	for(uint32_t &j : indices) j = remap[j];
+	return indices;
+}
+
+void triangulateAreas(OSMData &data, const uint32_t threads) {
+	const auto startTime = chrono::steady_clock::now();
+	if(data.roads.size() > numeric_limits<uint32_t>::max())
+		THROW_ERROR("Triangles of areas index " + to_string(data.roads.size()) + " points on 32 bits");
+	const uint32_t F = data.forests.second - data.forests.first;
+	const uint32_t R = data.forestsR.second - data.forestsR.first;
+	vector<vector<uint32_t>> indices(F + R);
+	vector<Edges> edgesA(threads), edgesB(threads);
+	atomic<uint32_t> touching = 0;
+	parallelFor(F + R, threads, [&](const uint32_t k, const uint32_t t) {
+		if(k < F) {
+			const uint32_t i = data.forests.first + k;
+			indices[k] = triangulate(
+				data.roads.data() + data.roadOffsets[i],
+				data.roadOffsets[i+1]-data.roadOffsets[i]
+			);
+			for(uint32_t &j : indices[k]) j += data.roadOffsets[i];
+		} else indices[k] = triangulateRelation(data, data.forestsR.first + k - F, edgesA[t], edgesB[t], touching);
+	});
+
+	// Area and centroid of each area, from its triangles
+	struct Shape {
+		double area = 0., x = 0., y = 0.;
+	};
+	vector<Shape> shapes(F + R);
+	for(uint32_t k = 0; k < F + R; ++k) {
+		Shape &s = shapes[k];
+		for(uint32_t t = 0; t+2 < indices[k].size(); t += 3) {
+			const vec2i &a = data.roads[indices[k][t]], &b = data.roads[indices[k][t+1]], &c = data.roads[indices[k][t+2]];
+			const double area = abs((double(b.x) - a.x) * (double(c.y) - a.y) - (double(c.x) - a.x) * (double(b.y) - a.y)) / 2.;
+			s.area += area;
+			s.x += area * (double(a.x) + b.x + c.x) / 3.;
+			s.y += area * (double(a.y) + b.y + c.y) / 3.;
+		}
+		if(s.area > 0.) {
+			s.x /= s.area;
+			s.y /= s.area;
+		}
+	}
+
+	// Areas by decreasing area, so that those bigger than a pixel at some zoom are a prefix
+	vector<uint32_t> order(F + R);
+	iota(order.begin(), order.end(), 0);
+	ranges::stable_sort(order, greater<double>{}, [&](const uint32_t k) { return shapes[k].area; });
+	size_t size = 0;
+	for(const vector<uint32_t> &v : indices) size += v.size();
+	data.forestIndices.clear();
+	data.forestIndices.reserve(size);
+	vector<size_t> ends; // end in forestIndices of each area in order
+	ends.reserve(F + R);
+	for(const uint32_t k : order) {
+		data.forestIndices.insert_range(data.forestIndices.end(), indices[k]);
+		indices[k] = {};
+		ends.push_back(data.forestIndices.size());
+	}
+	cout << "Areas: " << F << " closed ways and " << R << " multipolygons triangulated in "
+		<< chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s, "
+		<< data.forestIndices.size() / 3 << " triangles, " << touching << " multipolygons with touching loops skipped" << endl;
+
+	// For each level of detail, areas smaller than a pixel are dropped, and pixels of a grid mostly
+	// covered by dropped areas, counted at their centroid, are drawn instead as rectangles joining
+	// the filled pixels of a row
+	data.forestLodCounts.clear();
+	data.forestLodPoints.clear();
+	data.forestLodIndices.clear();
+	data.forestLodOffsets.assign(1, 0);
+	cout << "Areas levels of detail (kept and aggregate triangles):";
+	for(const uint32_t tolerance : data.lodTolerances) {
+		const int64_t pixel = 2 * int64_t(tolerance);
+		const double pixelArea = double(pixel) * pixel;
+		const size_t kept = ranges::partition_point(order, [&](const uint32_t k) { return shapes[k].area >= pixelArea; }) - order.begin();
+		data.forestLodCounts.push_back(kept ? ends[kept-1] : 0);
+
+		unordered_map<uint64_t, double> covered;
+		const auto cell = [&](const double v) { return (int32_t) floor(v / pixel); };
+		for(size_t o = kept; o < order.size(); ++o) {
+			const Shape &s = shapes[order[o]];
+			covered[uint64_t(uint32_t(cell(s.y))) << 32 | uint32_t(cell(s.x))] += s.area;
+		}
+		vector<pair<int32_t, int32_t>> filled; // (row, column)
+		for(const auto &[key, area] : covered)
+			if(2. * area >= pixelArea) filled.emplace_back(int32_t(key >> 32), int32_t(uint32_t(key)));
+		ranges::sort(filled);
+		for(size_t i = 0; i < filled.size();) {
+			size_t j = i+1;
+			while(j < filled.size() && filled[j].first == filled[i].first && filled[j].second == filled[j-1].second + 1) ++ j;
+			const int32_t x0 = filled[i].second * pixel, x1 = (filled[j-1].second + 1) * pixel;
+			const int32_t y0 = filled[i].first * pixel, y1 = (filled[i].first + 1) * pixel;
+			const uint32_t p = data.forestLodPoints.size();
+			data.forestLodPoints.insert(data.forestLodPoints.end(), {vec2i(x0, y0), vec2i(x1, y0), vec2i(x1, y1), vec2i(x0, y1)});
+			data.forestLodIndices.insert(data.forestLodIndices.end(), {p, p+1, p+2, p, p+2, p+3});
+			i = j;
+		}
+		data.forestLodOffsets.push_back(data.forestLodIndices.size());
+		cout << ' ' << data.forestLodCounts.back() / 3 << '+'
+			<< (data.forestLodOffsets.back() - data.forestLodOffsets[data.forestLodOffsets.size()-2]) / 3;
+	}
+	cout << endl;
+}
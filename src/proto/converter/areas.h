@@ -0,0 +1,13 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+
+#include "data/data.h"
+
+// Fill data.forestIndices with the triangles of the closed ways of data.forests
+// and of the multipolygons of data.forestsR, and their levels of detail for data.lodTolerances
+void triangulateAreas(OSMData &data, uint32_t threads);
@@ -0,0 +1,243 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+using namespace std;
+
+// Columns are aligned so that they are mapped in memory aligned for any of their elements
+struct CacheHeader {
+	char magic[8];
+	uint32_t version, columns;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	Box<vec2i> bbox;
+};
+struct ColumnSection {
+	uint64_t offset, count, elementSize;
+};
+static constexpr char MAGIC[8] = "OSMCACH";
+static constexpr uint32_t VERSION = 1;
+static constexpr uint64_t ALIGNMENT = 64;
+
+static uint64_t align(const uint64_t offset) {
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static uint32_t countColumns() {
+	const EntityCache cache;
+	return EntityCache::columns(cache, [](const auto &... xs) { return (uint32_t) sizeof...(xs); });
+}
+
+EntityCache::EntityCache() {
+	stringOffsets = nodeTagOffsets = wayRefOffsets = wayTagOffsets = memberOffsets = relationTagOffsets = {0};
+}
+
+EntityCacheWriter::EntityCacheWriter(const char *fileName, const Box<vec2i> &bbox): fileName(fileName), bbox(bbox) {
+	const uint32_t C = countColumns();
+	for(uint32_t c = 0; c < C; ++c) {
+		partNames.push_back(this->fileName + ".part" + to_string(c));
+		parts.emplace_back(partNames.back(), ios::binary);
+		if(!parts.back()) THROW_ERROR("Failed to open " + partNames.back());
+	}
+	counts.assign(C, 0);
+}
+
+EntityCacheWriter::~EntityCacheWriter() {
+	parts.clear();
+	error_code ec;
+	for(const string &part : partNames) filesystem::remove(part, ec);
+}
+
+void EntityCacheWriter::append(const EntityCache &block) {
+	vector<uint32_t> blockStrings(block.stringOffsets.size()-1);
+	for(size_t s = 0; s < blockStrings.size(); ++s) {
+		string str(block.stringChars.data() + block.stringOffsets[s], block.stringOffsets[s+1] - block.stringOffsets[s]);
+		const auto [it, added] = ids.try_emplace(std::move(str), strings);
+		if(added) {
+			pending.stringChars.insert(pending.stringChars.end(), it->first.begin(), it->first.end());
+			pending.stringOffsets.push_back(pending.stringOffsets.back() + it->first.size());
+			++ strings;
+		}
+		blockStrings[s] = it->second;
+	}
+	const auto appendOffsets = [](vector<uint64_t> &to, const vector<uint64_t> &from) {
+		const uint64_t base = to.back();
+		to.insert_range(to.end(), from | views::drop(1) | views::transform([&](const uint64_t o) { return base + o; }));
+	};
+	const auto appendStrings = [&]<typename T>(vector<T> &to, const vector<T> &from) {
+		to.insert_range(to.end(), from | views::transform([&](const T s) { return (T) blockStrings[s]; }));
+	};
+
+	pending.nodeIds.insert(pending.nodeIds.end(), block.nodeIds.begin(), block.nodeIds.end());
+	pending.nodeCoords.insert(pending.nodeCoords.end(), block.nodeCoords.begin(), block.nodeCoords.end());
+	pending.taggedNodes.insert_range(pending.taggedNodes.end(), block.taggedNodes | views::transform([&](const uint64_t n) { return nodes + n; }));
+	appendOffsets(pending.nodeTagOffsets, block.nodeTagOffsets);
+	appendStrings(pending.nodeKeys, block.nodeKeys);
+	appendStrings(pending.nodeVals, block.nodeVals);
+
+	pending.wayIds.insert(pending.wayIds.end(), block.wayIds.begin(), block.wayIds.end());
+	appendOffsets(pending.wayRefOffsets, block.wayRefOffsets);
+	pending.wayRefs.insert(pending.wayRefs.end(), block.wayRefs.begin(), block.wayRefs.end());
+	appendOffsets(pending.wayTagOffsets, block.wayTagOffsets);
+	appendStrings(pending.wayKeys, block.wayKeys);
+	appendStrings(pending.wayVals, block.wayVals);
+
+	pending.relationIds.insert(pending.relationIds.end(), block.relationIds.begin(), block.relationIds.end());
+	appendOffsets(pending.memberOffsets, block.memberOffsets);
+	pending.memberIds.insert(pending.memberIds.end(), block.memberIds.begin(), block.memberIds.end());
+	pending.memberTypes.insert(pending.memberTypes.end(), block.memberTypes.begin(), block.memberTypes.end());
+	appendStrings(pending.memberRoles, block.memberRoles);
+	appendOffsets(pending.relationTagOffsets, block.relationTagOffsets);
+	appendStrings(pending.relationKeys, block.relationKeys);
+	appendStrings(pending.relationVals, block.relationVals);
+
+	nodes += block.nodeIds.size();
+	ways += block.wayIds.size();
+	relations += block.relationIds.size();
+	flush(false);
+}
+
+void EntityCacheWriter::flush(const bool last) {
+	const vector<uint64_t> *const offsets[] = {&pending.stringOffsets, &pending.nodeTagOffsets, &pending.wayRefOffsets,
+		&pending.wayTagOffsets, &pending.memberOffsets, &pending.relationTagOffsets};
+	uint32_t c = 0;
+	EntityCache::columns(pending, [&]<typename... Ts>(vector<Ts> &... xs) {
+		([&](vector<Ts> &x) {
+			// The last offset is written with the next block, as its first offset
+			size_t n = x.size();
+			if constexpr(is_same_v<Ts, uint64_t>) if(!last && ranges::find(offsets, &x) != end(offsets)) -- n;
+			parts[c].write(reinterpret_cast<const char*>(x.data()), n * sizeof(Ts));
+			counts[c++] += n;
+			x.erase(x.begin(), x.begin() + n);
+		}(xs), ...);
+	});
+}
+
+void EntityCacheWriter::close(const uint64_t sourceSize, const int64_t sourceTime) {
+	flush(true);
+	for(uint32_t c = 0; c < parts.size(); ++c) {
+		parts[c].close();
+		if(!parts[c]) THROW_ERROR("Failed to write " + partNames[c]);
+	}
+	EntityCache::columns(pending, [&]<typename... Ts>(const vector<Ts> &... xs) {
+		CacheHeader header{{}, VERSION, sizeof...(xs), sourceSize, sourceTime, bbox};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		ColumnSection sections[] = {{0, 0, sizeof(Ts)}...};
+		uint64_t offset = sizeof(header) + sizeof(sections);
+		for(uint32_t c = 0; c < sizeof...(xs); ++c) {
+			sections[c].count = counts[c];
+			sections[c].offset = align(offset);
+			offset = sections[c].offset + counts[c] * sections[c].elementSize;
+		}
+
+		// The header is written last, a file left incomplete is not taken for a cache
+		ofstream out(fileName, ios::binary);
+		if(!out) THROW_ERROR("Failed to open " + fileName);
+		const CacheHeader blank{};
+		out.write(reinterpret_cast<const char*>(&blank), sizeof(blank));
+		out.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+		offset = sizeof(header) + sizeof(sections);
+		static constexpr char padding[ALIGNMENT] = {};
+		for(uint32_t c = 0; c < sizeof...(xs); ++c) {
+			out.write(padding, sections[c].offset - offset);
+			ifstream part(partNames[c], ios::binary);
+			if(counts[c]) out << part.rdbuf();
+			offset = sections[c].offset + counts[c] * sections[c].elementSize;
+			if(uint64_t(out.tellp()) != offset) THROW_ERROR("Failed to write " + fileName);
+		}
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.close();
+		if(!out) THROW_ERROR("Failed to write " + fileName);
+	});
+}
+
+bool EntityCacheView::matches(const char *fileName, const uint64_t sourceSize, const int64_t sourceTime) {
+	ifstream in(fileName, ios::binary);
+	CacheHeader header;
+	if(!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	return !memcmp(header.magic, MAGIC, sizeof(MAGIC)) && header.version == VERSION && header.columns == countColumns()
+		&& header.sourceSize == sourceSize && header.sourceTime == sourceTime;
+}
+
+EntityCacheView::EntityCacheView(const char *fileName) {
+	const int fd = open(fileName, O_RDONLY);
+	if(fd < 0) THROW_ERROR("Failed to open " + std::string(fileName));
+	struct stat st;
+	if(fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		THROW_ERROR("Failed to read " + std::string(fileName));
+	}
+	mapSize = st.st_size;
+	map = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		map = nullptr;
+		THROW_ERROR("Failed to map " + std::string(fileName));
+	}
+	const char *data = static_cast<const char*>(map);
+	const auto corrupted = [&]() { THROW_ERROR("Corrupted entity cache " + std::string(fileName)); };
+
+	CacheHeader header;
+	const uint32_t C = countColumns();
+	if(mapSize < sizeof(header) + C * sizeof(ColumnSection)) corrupted();
+	memcpy(&header, data, sizeof(header));
+	if(memcmp(header.magic, MAGIC, sizeof(MAGIC))) THROW_ERROR("Not an entity cache: " + std::string(fileName));
+	if(header.version != VERSION || header.columns != C) THROW_ERROR("Unsupported version of " + std::string(fileName));
+	bbox = header.bbox;
+	vector<ColumnSection> sections(C);
+	memcpy(sections.data(), data + sizeof(header), C * sizeof(ColumnSection));
+	uint32_t c = 0;
+	columns(*this, [&]<typename... Ts>(span<const Ts> &... xs) {
+		([&](span<const Ts> &x) {
+			const ColumnSection &s = sections[c++];
+			if(s.elementSize != sizeof(Ts) || s.offset % ALIGNMENT || s.offset > mapSize || s.count > (mapSize - s.offset) / sizeof(Ts))
+				corrupted();
+			x = {reinterpret_cast<const Ts*>(data + s.offset), s.count};
+		}(xs), ...);
+	});
+
+	// Everything the conversion indexes with
+	const auto checkOffsets = [&](const span<const uint64_t> offsets, const size_t entities, const size_t elements) {
+		if(offsets.size() != entities+1 || offsets.front() != 0 || offsets.back() != elements || !ranges::is_sorted(offsets))
+			corrupted();
+	};
+	const auto checkStrings = [&]<typename T>(const span<const T> strings) {
+		if(ranges::any_of(strings, [&](const T s) { return uint64_t(int64_t(s)) >= stringOffsets.size()-1; })) corrupted();
+	};
+	if(stringOffsets.empty()) corrupted();
+	checkOffsets(stringOffsets, stringOffsets.size()-1, stringChars.size());
+	if(nodeCoords.size() != nodeIds.size() || !ranges::is_sorted(taggedNodes)
+			|| (!taggedNodes.empty() && taggedNodes.back() >= nodeIds.size()))
+		corrupted();
+	checkOffsets(nodeTagOffsets, taggedNodes.size(), nodeKeys.size());
+	checkOffsets(wayRefOffsets, wayIds.size(), wayRefs.size());
+	checkOffsets(wayTagOffsets, wayIds.size(), wayKeys.size());
+	checkOffsets(memberOffsets, relationIds.size(), memberIds.size());
+	checkOffsets(relationTagOffsets, relationIds.size(), relationKeys.size());
+	if(nodeVals.size() != nodeKeys.size() || wayVals.size() != wayKeys.size() || relationVals.size() != relationKeys.size()
+			|| memberTypes.size() != memberIds.size() || memberRoles.size() != memberIds.size()
+			|| ranges::any_of(memberTypes, [](const uint8_t t) { return t > 2; })) // NODE, WAY or RELATION
+		corrupted();
+	for(const span<const uint32_t> strings : {nodeKeys, nodeVals, wayKeys, wayVals, relationKeys, relationVals}) checkStrings(strings);
+	checkStrings(memberRoles);
+}
+
+EntityCacheView::~EntityCacheView() {
+	if(map) munmap(map, mapSize);
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vec.h"
+
+// Decoded entities of a PBF in columns, in the order of the PBF. Refs of ways and ids of members are
+// delta coded as in PBF, tags and roles index the strings interned over the whole file, and the
+// elements of entity i of a column cut by offsets are in [offsets[i], offsets[i+1]).
+template<template<typename> typename C>
+struct EntityColumns {
+	C<uint64_t> stringOffsets;
+	C<char> stringChars;
+
+	C<int64_t> nodeIds;
+	C<vec2i> nodeCoords;
+	// Indices of the nodes with tags
+	C<uint64_t> taggedNodes, nodeTagOffsets;
+	C<uint32_t> nodeKeys, nodeVals;
+
+	C<int64_t> wayIds;
+	C<uint64_t> wayRefOffsets;
+	C<int64_t> wayRefs;
+	C<uint64_t> wayTagOffsets;
+	C<uint32_t> wayKeys, wayVals;
+
+	C<int64_t> relationIds;
+	C<uint64_t> memberOffsets;
+	C<int64_t> memberIds;
+	C<uint8_t> memberTypes;
+	C<int32_t> memberRoles;
+	C<uint64_t> relationTagOffsets;
+	C<uint32_t> relationKeys, relationVals;
+
+	Box<vec2i> bbox; // of the header of the PBF, empty if it has none
+
+	// Call f with all the columns of `e`, in the order of the file
+	template<typename E, typename F>
+	static auto columns(E &e, F &&f) {
+		return f(e.stringOffsets, e.stringChars,
+			e.nodeIds, e.nodeCoords, e.taggedNodes, e.nodeTagOffsets, e.nodeKeys, e.nodeVals,
+			e.wayIds, e.wayRefOffsets, e.wayRefs, e.wayTagOffsets, e.wayKeys, e.wayVals,
+			e.relationIds, e.memberOffsets, e.memberIds, e.memberTypes, e.memberRoles, e.relationTagOffsets, e.relationKeys, e.relationVals);
+	}
+};
+
+template<typename T> using Column = std::vector<T>;
+template<typename T> using ColumnView = std::span<const T>;
+
+// Entities of a block of a PBF, as decoded before they are written to the cache
+struct EntityCache : EntityColumns<Column> {
+	EntityCache();
+};
+
+// Written next to a PBF, so that conversions with other rules map it in memory instead of inflating
+// and parsing the PBF. Blocks are appended in the order of the PBF and each column goes to its own
+// temporary file, which close puts together, so that only one block and the strings are in memory.
+class EntityCacheWriter {
+public:
+	EntityCacheWriter(const char *fileName, const Box<vec2i> &bbox);
+	~EntityCacheWriter();
+	EntityCacheWriter(const EntityCacheWriter&) = delete;
+	EntityCacheWriter& operator=(const EntityCacheWriter&) = delete;
+
+	// Add the entities of a block after those already written, its strings are interned over the whole file
+	void append(const EntityCache &block);
+	// The size and modification time of the PBF are kept to know when the cache is stale
+	void close(uint64_t sourceSize, int64_t sourceTime);
+
+	uint64_t nodes = 0, ways = 0, relations = 0;
+	uint32_t strings = 0;
+
+protected:
+	std::string fileName;
+	Box<vec2i> bbox;
+	// Entities of the last block, offsets columns keeping their last offset that the next block starts from
+	EntityCache pending;
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<std::string> partNames;
+	std::vector<std::ofstream> parts;
+	std::vector<uint64_t> counts;
+
+	void flush(bool last);
+};
+
+struct EntityCacheView : EntityColumns<ColumnView> {
+	EntityCacheView(const char *fileName);
+	~EntityCacheView();
+	EntityCacheView(const EntityCacheView&) = delete;
+	EntityCacheView& operator=(const EntityCacheView&) = delete;
+
+	// Whether the file is a cache of this version made from a PBF of this size and modification time
+	static bool matches(const char *fileName, uint64_t sourceSize, int64_t sourceTime);
+
+	std::string_view string(const uint64_t s) const {
+		return {stringChars.data() + stringOffsets[s], stringOffsets[s+1] - stringOffsets[s]};
+	}
+
+protected:
+	void *map = nullptr;
+	size_t mapSize = 0;
+};
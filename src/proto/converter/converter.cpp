@@ -2,23 +2,43 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 // See <https://www.gnu.org/licenses/>
 
+#include <atomic>
 #include <bitset>
 #include <cassert>
+#include <chrono>
 #include <concepts>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <numeric>
 #include <ranges>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 // TODO: rewrite decompression
 #include <zlib.h>
 
-#include "string_switch.h"
-
+#include "areas.h"
+#include "cache.h"
+#include "edge_grid.h"
 #include "hashmap.h"
+#include "memory.h"
+#include "osc.h"
+#include "parallel.h"
+#include "pbf_writer.h"
+#include "polylines.h"
+#include "ref_arena.h"
+#include "rules.h"
+#include "sharded.h"
+#include "source.h"
+#include "tiles.h"
 #include "utils.h"
 #include "vec.h"
 
@@ -26,6 +46,7 @@
 
 #include "enums/enums.h"
 
+#include "proto/proto_common.h"
 #include "proto/generated/osm.pb.h"
 
 using namespace std;
@@ -43,12 +64,104 @@ struct BinStream : public ifstream {
 	}
 };
 
+struct BlobInfo {
+	enum Type { HEADER, DATA } type;
+	uint64_t offset; // offset of the Blob message in the file
+	uint32_t size;
+	// Bitmask of the PrimitiveGroup fields present in the blob (bit i for field i), all set while unknown
+	uint8_t groups = UNKNOWN;
+	static constexpr uint8_t NODES = 1u << 1;
+	static constexpr uint8_t DENSE = 1u << 2;
+	static constexpr uint8_t WAYS = 1u << 3;
+	static constexpr uint8_t RELATIONS = 1u << 4;
+	static constexpr uint8_t UNKNOWN = 0xffu;
+};
+
+// Walk the file reading only the BlobHeaders
+static vector<BlobInfo> indexBlobs(BinStream &input) {
+	vector<BlobInfo> blobs;
+	uint32_t blobHeaderSize;
+	vector<uint8_t> wire;
+	while(input.readInt(blobHeaderSize)) {
+		wire.resize(blobHeaderSize);
+		input.read(reinterpret_cast<char*>(wire.data()), wire.size());
+		const Proto::BlobHeader header(wire);
+		BlobInfo &blob = blobs.emplace_back();
+		if(header.type == "OSMHeader") blob.type = BlobInfo::HEADER;
+		else if(header.type == "OSMData") blob.type = BlobInfo::DATA;
+		else THROW_ERROR("Not recognized blob type: " + header.type);
+		blob.offset = input.tellg();
+		blob.size = header.datasize;
+		input.seekg(header.datasize, ios::cur);
+	}
+	input.clear();
+	return blobs;
+}
+
+static void readBlob(BinStream &input, const BlobInfo &info, vector<uint8_t> &wire, vector<uint8_t> &blobData) {
+	wire.resize(info.size);
+	input.seekg(info.offset);
+	input.read(reinterpret_cast<char*>(wire.data()), wire.size());
+	const Proto::Blob blob(wire);
+	blobData.resize(blob.raw_size);
+	if(blob._data_choice == Proto::Blob::DATA_ZLIB_DATA) {
+		uLongf data_size = blob.raw_size;
+		if(uncompress(blobData.data(), &data_size, blob.data.zlib_data.data(), blob.data.zlib_data.size()) != Z_OK)
+			THROW_ERROR("Failed to uncompress...");
+	} else THROW_ERROR("Uncompression of blob data not implemented " + to_string(blob._data_choice));
+}
+
+// Look at the raw PrimitiveBlock wire for the kind of entities it contains, without parsing it
+static uint8_t scanGroups(const vector<uint8_t> &blobData) {
+	const auto skip = [](const uint8_t* &it, uint64_t key) {
+		switch(key & 7) {
+		case 0: Proto::readInt64(it); break;
+		case 1: it += 8; break;
+		case 2: it += Proto::readInt64(it); break;
+		case 5: it += 4; break;
+		default: THROW_ERROR("Unsupported wire type");
+		}
+	};
+	uint8_t groups = 0;
+	const uint8_t *it = blobData.data(), *const end = it + blobData.size();
+	while(it < end) {
+		const uint64_t key = Proto::readInt64(it);
+		if(key != ((2 << 3) | 2)) {
+			skip(it, key);
+			continue;
+		}
+		const uint64_t size = Proto::readInt64(it);
+		const uint8_t *const groupEnd = it + size;
+		while(it < groupEnd) {
+			const uint64_t groupKey = Proto::readInt64(it);
+			if((groupKey >> 3) < 8) groups |= 1u << (groupKey >> 3);
+			skip(it, groupKey);
+		}
+	}
+	return groups;
+}
+
+static Proto::PrimitiveBlock parsePrimitiveBlock(const vector<uint8_t> &blobData) {
+	Proto::PrimitiveBlock pb(blobData);
+	if((pb.lat_offset % MIN_GRANULARITY) != 0 || (pb.lon_offset % MIN_GRANULARITY) != 0 || (pb.granularity % MIN_GRANULARITY) != 0)
+		THROW_ERROR("Coordinates should be multiple of " + to_string(MIN_GRANULARITY));
+	pb.lat_offset /= MIN_GRANULARITY;
+	pb.lon_offset /= MIN_GRANULARITY;
+	pb.granularity /= MIN_GRANULARITY;
+	for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
+		if(!pg.nodes.empty()) THROW_ERROR("Not implemented");
+		if(!pg.changesets.empty()) THROW_ERROR("Not implemented");
+	}
+	return pb;
+}
+
 unordered_set<string> supported_features = {
 	"OsmSchema-V0.6",
 	"DenseNodes",
 };
 
-static void readHeader(const vector<uint8_t> &blobData, OSMData &data) {
+// Returns whether the blobs are sorted by entity type and then by id
+static bool readHeader(const vector<uint8_t> &blobData, OSMData &data) {
 	const Proto::HeaderBlock hb(blobData);
 	if(hb._has_bbox) {
 		data.bbox.min.x = hb.bbox.left / MIN_GRANULARITY;
@@ -60,10 +173,11 @@ static void readHeader(const vector<uint8_t> &blobData, OSMData &data) {
 		if(!supported_features.count(feature))
 			THROW_ERROR("Not supported required feature: " + feature);
 	}
-	if(hb.optional_features.empty()) return;
+	if(hb.optional_features.empty()) return false;
 	cout << "Optional features:\n";
 	for(const string &s : hb.optional_features)
 		cout << '\t' << s << endl;
+	return ranges::count(hb.optional_features, "Sort.Type_then_ID") > 0;
 }
 
 template<typename T, typename E>
@@ -73,7 +187,7 @@ protected:
 	using BS = bitset<static_cast<size_t>(E::COUNT)>;
 public:
 	vector<T> data;
-	vector<uint32_t> off = {0};
+	vector<uint64_t> off = {0};
 	struct Flag : BS {
 		void set(E x) { BS::set((size_t) x); }
 		bool test(E x) { return BS::test((size_t) x); }
@@ -81,6 +195,9 @@ public:
 	void end() {
 		off.push_back(data.size());
 	}
+	size_t memory() const {
+		return Memory::bytes(data) + Memory::bytes(off);
+	}
 };
 
 enum class TmpRoadFlag {
@@ -108,47 +225,82 @@ struct TmpData {
 	}
 };
 
-static inline string_view getString(const vector<vector<uint8_t>> &ST, uint32_t i) {
-	return string_view(reinterpret_cast<const char*>(ST[i].data()), ST[i].size());
+// What is produced from one blob, merged in file order once all blobs are read
+struct BlockData {
+	TmpData tmp;
+	vector<char> names;
+	vector<pair<vec2i, uint32_t>> capitals;
+	vector<int64_t> capitalIds;
+	// Ways of the layers, kept for the source index
+	vector<SourceIndex::Way> sourceWays;
+	bool denseRead = false;
 };
 
 //////////////
 //// NODE ////
 //////////////
 
-HashMap<vec2i> nodes;
+Sharded<HashMap<vec2i>> nodes;
+
+static inline vec2i getNode(const int64_t id) {
+	const HashMap<vec2i> &shard = nodes(id);
+	const auto it = shard.find(id);
+	return it == shard.end() ? vec2i(0, 0) : it->second;
+}
+
+// Keep the node if it is a capital
+static void readCapital(const int64_t id, const vec2i node, const NodeTags &tags, BlockData &data) {
+	if(tags.place == Place::CITY && tags.capital >= 0 && tags.capital <= 6) {
+		data.capitals.emplace_back(node, data.names.size());
+		data.capitalIds.push_back(id);
+		data.names.insert(data.names.end(), tags.name.begin(), tags.name.end());
+		data.names.push_back('\0');
+	}
+}
+
+// Nodes are inserted by batch to lock each shard once
+using NodeBatches = array<vector<pair<int64_t, vec2i>>, decltype(nodes)::SHARDS>;
 
-static void readDense(const Proto::PrimitiveBlock &pb, const Proto::DenseNodes &dense, const vector<vector<uint8_t>> &ST, OSMData &data) {
+static void insertNodes(const NodeBatches &batches) {
+	for(size_t s = 0; s < batches.size(); ++s) {
+		if(batches[s].empty()) continue;
+		const auto lock = nodes.lockShard(s);
+		for(const auto &[id, node] : batches[s])
+			nodes.shards[s][id] = node;
+	}
+}
+
+// Returns whether the tags were read, they are skipped when the block has no key needed to produce a capital
+static bool readDense(const Proto::PrimitiveBlock &pb, const Proto::DenseNodes &dense, const TagTable &table, BlockData &data) {
 	const int N = dense.id.size();
 	if(N != (int) dense.lat.size() || N != (int) dense.lon.size())
 		THROW_ERROR("Sizes mismatch in denseNodes...");
+	const bool readTags = !dense.keys_vals.empty() && table.has(TagKey::PLACE) && table.has(TagKey::CAPITAL);
+	NodeBatches batches;
 	auto kv_it = dense.keys_vals.begin();
 	int64_t id = 0, lat = 0, lon = 0;
 	for(int i = 0; i < N; ++i) {
 		id += dense.id[i];
 		lat += dense.lat[i];
 		lon += dense.lon[i];
-		vec2i &node = nodes[id];
-		node.x = pb.lon_offset + pb.granularity * lon;
-		node.y = pb.lat_offset + pb.granularity * lat;
+		const vec2i node(pb.lon_offset + pb.granularity * lon, pb.lat_offset + pb.granularity * lat);
+		batches[nodes.index(id)].emplace_back(id, node);
+		if(!readTags) continue;
 
 		// Read tags
 		NodeTags tags;
 		while(*kv_it) {
-			const string_view key = getString(ST, *(kv_it++));
-			const string_view val = getString(ST, *(kv_it++));
-			tags.readTag(key, val);
+			const uint32_t key = *(kv_it++);
+			const uint32_t val = *(kv_it++);
+			tags.readTag(table, key, val);
 		}
 		++ kv_it;
-
-		// Process
-		if(tags.place == Place::CITY && tags.capital >= 0 && tags.capital <= 6) {
-			data.capitals.emplace_back(node, data.names.size());
-			data.names.insert(data.names.end(), tags.name.begin(), tags.name.end());
-			data.names.push_back('\0');
-		}
+		readCapital(id, node, tags, data);
 	}
-	if(kv_it != dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+	if(readTags && kv_it != dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+	insertNodes(batches);
+	data.denseRead = true;
+	return readTags;
 }
 
 /////////////
@@ -156,73 +308,154 @@ static void readDense(const Proto::PrimitiveBlock &pb, const Proto::DenseNodes &
 /////////////
 
 struct Way {
-	vector<int64_t> way;
+	uint32_t run;
 	TmpRef ref{};
-	bool isClosed() const { return way.size() >= 2 && way[0] == way.back(); };
 };
 
-static void addRoad(TmpRoad &roads, Way &w) {
-	w.ref.storage = &roads;
-	w.ref.ind = roads.off.size()-1;
-	if(roads.flags.test(TmpRoadFlag::RENDERED_AREA) && !w.isClosed())
+static inline bool isClosed(const vector<int64_t> &refs) {
+	return refs.size() >= 2 && refs[0] == refs.back();
+}
+
+static TmpRef addRoad(TmpRoad &roads, const vector<int64_t> &refs) {
+	const TmpRef ref{&roads, (uint32_t) roads.off.size()-1};
+	if(roads.flags.test(TmpRoadFlag::RENDERED_AREA) && !isClosed(refs))
 		THROW_ERROR("rendered area should be closed");
 	roads.data.insert_range(roads.data.end(),
-		w.way
+		refs
 		| views::drop(roads.flags.test(TmpRoadFlag::RENDERED_AREA) ? 1 : 0)
-		| views::transform([&](const int64_t id) {
-			return nodes[id];
-		})
+		| views::transform(getNode)
 	);
 	roads.end();
+	return ref;
 };
 
-HashMap<Way> ways;
+struct WayStore {
+	HashMap<Way> map;
+	RefArena refs;
+};
+Sharded<WayStore> ways;
+// Sorted ids of the ways referenced by processed relations, only those are kept in `ways`
+vector<int64_t> neededWays;
 
-static void readWay(const Proto::Way &way, const vector<vector<uint8_t>> &ST, TmpData &data) {
-	if(!way.lat.empty() || !way.lon.empty()) THROW_ERROR("lat and lon fields in Way are not supported");
-	Way &w = ways[way.id] = {way.refs};
-	int64_t cur = 0;
-	for(int64_t &ref : w.way) {
-		cur += ref;
-		ref = cur;
-	}
+// Zooms of 256 pixels tiles for which polylines are simplified, from the most detailed
+static constexpr uint32_t LOD_ZOOMS[] = {12, 10, 8, 6};
 
-	// Read Tags
-	const int T = way.keys.size();
-	if(T != (int) way.vals.size()) THROW_ERROR("Sizes mismatch in way's tags...");
-	constexpr WayTags tags0;
-	WayTags tags;
-	for(int i = 0; i < T; ++i) {
-		const string_view key = getString(ST, way.keys[i]);
-		const string_view val = getString(ST, way.vals[i]);
-		tags.readTag(key, val);
+// Half a pixel of a 256 pixels tile at the zoom, a pixel spanning 360° / 2^zoom / 256 of longitude
+static uint32_t lodTolerance(const uint32_t zoom) {
+	return 360e7 / (256u << zoom) / 2;
+}
+
+// Layers of ways as named in the rules, in the order of wayLayer()
+static constexpr const char* wayLayers[] = {
+	"road.motorway", "road.trunk", "road.primary",
+	"waterway.river",
+	"boundary",
+	"forest",
+};
+static_assert(size(wayLayers) == (size_t) RoadType::NUM + (size_t) WaterWayType::NUM + 2);
+// Forests, whose layer an update makes again with all the areas
+static constexpr uint32_t FOREST_LAYER = size(wayLayers) - 1;
+unique_ptr<Rules> wayRules;
+
+static TmpRoad& wayLayer(TmpData &data, uint32_t layer) {
+	if(layer < data.roads.size()) return data.roads[layer];
+	layer -= data.roads.size();
+	if(layer < data.waterWays.size()) return data.waterWays[layer];
+	layer -= data.waterWays.size();
+	return layer == 0 ? data.boundaries : data.forests;
+}
+
+static TmpRef addLayerWay(TmpData &data, const uint32_t layer, const vector<int64_t> &refs) {
+	TmpRoad &roads = wayLayer(data, layer);
+	if(roads.flags.test(TmpRoadFlag::RENDERED_AREA)) {
+		if(refs.back() != refs[0]) THROW_ERROR("Not closed");
+		if(refs.size() < 4) THROW_ERROR("area with less than 3 nodes");
 	}
+	return addRoad(roads, refs);
+}
+
+// Keep a way needed by a relation, from its delta coded refs
+static void keepWay(const int64_t id, span<const int64_t> deltas, const TmpRef ref) {
+	const auto lock = ways.lock(id);
+	WayStore &store = ways(id);
+	store.map[id] = {store.refs.push(deltas), ref};
+}
+
+// A way from its tags and delta coded refs
+static void readWay(const int64_t id, span<const uint32_t> keys, span<const uint32_t> vals, span<const int64_t> deltas,
+		const Rules::Block &block, BlockData &data, const bool source) {
+	// Classify by the tags, unless no rule can match in the block
+	if(keys.size() != vals.size()) THROW_ERROR("Sizes mismatch in way's tags...");
+	const uint32_t layer = block.mayMatch ? wayRules->match(block, keys, vals) : Rules::NONE;
+	const bool needed = ranges::binary_search(neededWays, id);
+	if(layer == Rules::NONE && !needed) return;
 
 	// Process
-	if((uint32_t) tags.highway != tags.UNDEF) addRoad(data.roads[(uint32_t) tags.highway], w);
-	else if((uint32_t) tags.waterway != tags.UNDEF) addRoad(data.waterWays[(uint32_t) tags.waterway], w);
-	else if(tags.boundary == Boundary::ADMINISTRATIVE && tags.admin_level >= 0 && tags.admin_level <= 4) {
-		// TODO: different boundaries depending on admin level
-		addRoad(data.boundaries, w);
-	} else if(tags.landuse == Landuse::FOREST || tags.natural == Natural::WOOD) {
-		if(w.way.back() != w.way[0]) THROW_ERROR("Not closed");
-		if(w.way.size() < 4) THROW_ERROR("area with less than 3 nodes");
-		addRoad(data.forests, w);
+	TmpRef ref;
+	if(layer != Rules::NONE) {
+		thread_local vector<int64_t> refs;
+		refs.resize(deltas.size());
+		int64_t cur = 0;
+		for(size_t i = 0; i < refs.size(); ++i) {
+			cur += deltas[i];
+			refs[i] = cur;
+		}
+		ref = addLayerWay(data.tmp, layer, refs);
+		if(source) data.sourceWays.push_back({id, layer, refs});
 	}
+
+	// Keep the way if a relation needs it
+	if(needed) keepWay(id, deltas, ref);
 }
 
 //////////////////
 //// RELATION ////
 //////////////////
 
-static void processMultipolygon(const Proto::Relation &relation, const vector<vector<uint8_t>> &ST, TmpRoad &misc, TmpRelation &polygons) {
-	struct Component {
-		vector<Way*> outer, inner;
-		int64_t area = 0;
+// Assembly time of multipolygons, with the slowest relations
+struct MultipolygonStats {
+	static constexpr uint32_t SLOWEST = 5;
+	uint32_t count = 0, skipped = 0;
+	double seconds = 0.;
+	vector<pair<double, int64_t>> slowest; // decreasing time, relation id
+
+	void add(const int64_t id, const double t) {
+		++ count;
+		seconds += t;
+		slowest.emplace(ranges::upper_bound(slowest, t, greater<double>{}, &pair<double, int64_t>::first), t, id);
+		if(slowest.size() > SLOWEST) slowest.pop_back();
+	}
+};
+MultipolygonStats multipolygonStats;
+
+// A forest multipolygon, queued while relations are read and assembled once they all are.
+// Assembly only reads the nodes and ways so multipolygons are assembled in parallel,
+// then added to the output one after the other in the order they were queued.
+struct Multipolygon {
+	enum Role : uint8_t { OUTER, INNER, OTHER };
+	// Member ways with their decoded node references and coordinates
+	struct Member {
+		Way *w;
+		vector<int64_t> way;
+		vector<vec2i> pts;
+		Member(Way *w, vector<int64_t> &&way): w(w), way(std::move(way)), pts(this->way.size()) {
+			ranges::transform(this->way, pts.begin(), getNode);
+		}
 	};
-	vector<Component> cs;
-	vector<vector<Way*>> inners;
-	vector<Way*> outerWays, innerWays;
+
+	int64_t id;
+	vector<pair<int64_t, Role>> ways; // way members and their role
+
+	// Set by assembleMultipolygon
+	bool assembled = false; // false for ill-formed multipolygons
+	vector<Member> members;
+	vector<vector<Member*>> components; // outer then inner ways of each component
+	double seconds = 0.;
+};
+
+static void queueMultipolygon(const Proto::Relation &relation, const TagTable &table, vector<Multipolygon> &multipolygons) {
+	Multipolygon &mp = multipolygons.emplace_back();
+	mp.id = relation.id;
 	int64_t memid = 0;
 	const int M = relation.memids.size();
 	for(int i = 0; i < M; ++i) {
@@ -231,67 +464,141 @@ static void processMultipolygon(const Proto::Relation &relation, const vector<ve
 			// Currently ignore members that are not ways
 			continue;
 		}
-		const string_view role = getString(ST, relation.roles_sid[i]);
-		const auto it = ways.find(memid);
-		if(it == ways.end()) THROW_ERROR("way not found");
+		const string_view role = table.strings[relation.roles_sid[i]];
+		mp.ways.emplace_back(memid, role == "outer" ? Multipolygon::OUTER : role == "inner" ? Multipolygon::INNER : Multipolygon::OTHER);
+	}
+}
+
+static void assembleMultipolygon(Multipolygon &mp) {
+	using Member = Multipolygon::Member;
+	const auto startTime = chrono::steady_clock::now();
+	struct Component {
+		vector<Member*> outer, inner;
+		int64_t area = 0;
+	};
+	vector<Component> cs;
+	vector<vector<Member*>> inners;
+	vector<Member*> outerWays, innerWays;
+	vector<Member> &members = mp.members;
+	members.reserve(mp.ways.size());
+	for(const auto &[memid, role] : mp.ways) {
+		WayStore &store = ways(memid);
+		const auto it = store.map.find(memid);
+		if(it == store.map.end()) THROW_ERROR("way not found");
 		Way &w = it->second;
-		if(role == "outer") {
+		// Ways of less than 2 nodes have no edge, and no direction to leave their node by when merging
+		if(role != Multipolygon::OTHER && store.refs[w.run].size() < 2) continue;
+		if(role == Multipolygon::OUTER) {
 			if(w.ref.storage && w.ref.storage->flags.test(TmpRoadFlag::RENDERED_AREA)) {
 				// Currently ignore outer members that are already rendered
 				continue;
 			}
-			if(w.isClosed()) cs.emplace_back().outer.push_back(&w);
-			else outerWays.push_back(&w);
-		} else if(role == "inner") {
-			if(w.isClosed()) inners.emplace_back().push_back(&w);
-			else innerWays.push_back(&w);
+			Member &m = members.emplace_back(&w, store.refs[w.run].decode());
+			if(isClosed(m.way)) cs.emplace_back().outer.push_back(&m);
+			else outerWays.push_back(&m);
+		} else if(role == Multipolygon::INNER) {
+			Member &m = members.emplace_back(&w, store.refs[w.run].decode());
+			if(isClosed(m.way)) inners.emplace_back().push_back(&m);
+			else innerWays.push_back(&m);
 		} else {
 			// Currently ignore members that are neither outer nor inner
 			continue;
 		}
 	}
 
-	// Merge ways
-	// Slow implementation, could be improved
-	const auto merge = [&](const vector<Way*> &ways, vector<vector<Way*>> &groups)->bool {
+	// Merge open ways into rings, walking from way to way through a hash of their endpoints.
+	// Where more than two ways meet, the walk leaves a node by the first way clockwise from
+	// the one it arrived by, and a ring coming back to such a node before closing is split there,
+	// so that rings touching at a node are made separate rings.
+	const auto merge = [&](const vector<Member*> &ways, vector<vector<Member*>> &groups)->bool {
 		const uint32_t N = ways.size();
 		if(!N) return true;
-		unique_ptr<bool[]> seen(new bool[N]());
-		unique_ptr<uint32_t[]> G(new uint32_t[2*N]);
-		constexpr uint32_t END = 1u<<31;
-		iota(G.get(), G.get()+N, 0);
-		iota(G.get()+N, G.get()+2*N, END);
-		const auto getNode = [&](uint32_t i)->int64_t {
-			if(i&END) return ways[i^END]->way.back();
-			return ways[i]->way[0];
+		// Endpoint e is the first node of ways[e/2] if e is even, its last node otherwise
+		vector<int64_t> ends(2*N);
+		for(uint32_t i = 0; i < N; ++i) {
+			ends[2*i] = ways[i]->way[0];
+			ends[2*i+1] = ways[i]->way.back();
+		}
+		const auto node = [&](const uint32_t e) { return ends[e]; };
+		// Direction of the way leaving its endpoint e
+		const auto direction = [&](const uint32_t e)->vec2i {
+			const vector<vec2i> &pts = ways[e/2]->pts;
+			return (e&1) ? pts[pts.size()-2] - pts.back() : pts[1] - pts[0];
 		};
-		span<uint32_t> GSpan(G.get(), 2*N);
-		ranges::sort(GSpan, less<int64_t>{}, getNode);
+		HashMap<uint32_t> heads; // 1 + first endpoint at a node
+		heads.reserve(2*N);
+		vector<uint32_t> chain(2*N); // 1 + next endpoint at the same node
+		for(uint32_t e = 0; e < 2*N; ++e) {
+			uint32_t &h = heads[node(e)];
+			chain[e] = h;
+			h = e+1;
+		}
+
+		// Whether leaving by endpoint f comes before leaving by endpoint g, turning clockwise from d
+		const auto clockwiseBefore = [&](const vec2i d, const uint32_t f, const uint32_t g) {
+			const auto half = [&](const vec2i u) {
+				const int64_t c = int64_t(d.x) * u.y - int64_t(d.y) * u.x;
+				if(c < 0) return 0;
+				if(c > 0) return 1;
+				return int64_t(d.x) * u.x + int64_t(d.y) * u.y < 0 ? 1 : 2; // going back along d last
+			};
+			const vec2i u = direction(f), v = direction(g);
+			const int hu = half(u), hv = half(v);
+			if(hu != hv) return hu < hv;
+			return int64_t(u.x) * v.y - int64_t(u.y) * v.x < 0;
+		};
+
+		// A ring is a list of endpoints where its ways arrive, the first way must be followed
+		// from its first node as users of the rings expect
+		const auto addRing = [&](span<const uint32_t> ring) {
+			vector<Member*> &g = groups.emplace_back();
+			g.reserve(ring.size());
+			const auto fwd = ranges::find_if(ring, [](const uint32_t e) { return (e&1) != 0; });
+			if(fwd == ring.end()) {
+				for(const uint32_t e : ring | views::reverse) g.push_back(ways[e/2]);
+				return;
+			}
+			for(auto it = fwd; it != ring.end(); ++it) g.push_back(ways[*it/2]);
+			for(auto it = ring.begin(); it != fwd; ++it) g.push_back(ways[*it/2]);
+		};
+
+		vector<bool> used(N, false);
+		vector<uint32_t> path;
+		vector<pair<int64_t, uint32_t>> junctions; // nodes of the path where more than two ways meet, and their position
 		for(uint32_t i = 0; i < N; ++i) {
-			if(seen[i]) continue;
-			seen[i] = true;
-			vector<Way*> &g = groups.emplace_back(1, ways[i]);
-			const int64_t first = getNode(i);
-			int64_t last = getNode(END|i);
-			while(last != first) {
-				auto it = ranges::lower_bound(GSpan, last, less<int64_t>{}, getNode);
-				if(it+1 >= GSpan.end() || getNode(it[1]) != last)
-					THROW_ERROR("Node in only one way");
-				if(it+2 < GSpan.end() && getNode(it[2]) == last) {
-					// Currently ignore ill-formed multipolygons
+			if(used[i]) continue;
+			used[i] = true;
+			path.assign(1, 2*i+1);
+			junctions.clear();
+			const int64_t first = node(2*i);
+			for(int64_t last; (last = node(path.back())) != first;) {
+				const uint32_t head = heads.find(last)->second;
+				if(chain[head-1] && chain[chain[head-1]-1]) {
+					const auto it = ranges::find(junctions, last, &pair<int64_t, uint32_t>::first);
+					if(it != junctions.end()) {
+						addRing(span(path).subspan(it->second));
+						path.resize(it->second);
+						junctions.erase(it+1, junctions.end());
+					} else junctions.emplace_back(last, path.size());
+				}
+				uint32_t next = -1;
+				for(uint32_t h = head; h; h = chain[h-1]) {
+					const uint32_t f = h-1;
+					if(used[f/2]) continue;
+					if(next == uint32_t(-1) || clockwiseBefore(direction(path.back()), f, next)) next = f;
+				}
+				if(next == uint32_t(-1)) {
+					// Currently ignore multipolygons with rings that are not closed
 					return false;
 				}
-				if(ways[(*it)&(~END)] == g.back()) ++it;
-				const uint32_t j = (*it)&(~END);
-				assert(!seen[j]);
-				seen[j] = true;
-				g.push_back(ways[j]);
-				last = getNode((*it)^END);
+				used[next/2] = true;
+				path.push_back(next^1);
 			}
+			addRing(path);
 		}
 		return true;
 	};
-	vector<vector<Way*>> outers;
+	vector<vector<Member*>> outers;
 	if(!merge(outerWays, outers)) return;
 	if(!merge(innerWays, inners)) return;
 	cs.resize(cs.size() + outers.size());
@@ -301,14 +608,12 @@ static void processMultipolygon(const Proto::Relation &relation, const vector<ve
 	// Sort outers by increasing area
 	for(Component &c : cs) {
 		int64_t last = c.outer[0]->way[0];
-		for(const Way* way : c.outer) {
+		for(const Member* way : c.outer) {
 			const vector<int64_t> &w = way->way;
+			const vector<vec2i> &pts = way->pts;
 			int64_t wa = 0;
-			for(uint32_t i = 1; i < w.size(); ++i) {
-				const vec2i &a = nodes[w[i-1]];
-				const vec2i &b = nodes[w[i]];
-				wa += int64_t(a.x - b.x) * (a.y + b.y);
-			}
+			for(uint32_t i = 1; i < pts.size(); ++i)
+				wa += int64_t(pts[i-1].x - pts[i].x) * (pts[i-1].y + pts[i].y);
 			if(last == w[0]) {
 				c.area += wa;
 				last = w.back();
@@ -322,32 +627,23 @@ static void processMultipolygon(const Proto::Relation &relation, const vector<ve
 	ranges::sort(cs, less<int64_t>{}, [&](const Component &c) { return c.area; });
 
 	// Add inners to components
-	for(const vector<Way*> &in : inners) {
-		for(Component &c : cs) {
-			for(const Way* inWay : in) {
-				for(const int64_t id : inWay->way) {
-					const vec2i &v = nodes[id];
-					uint32_t winding = 0;
-					for(const Way* way : c.outer) {
-						const vector<int64_t> &w = way->way;
-						for(uint32_t i = 1; i < w.size(); ++i) {
-							vec2i a = nodes[w[i-1]];
-							vec2i b = nodes[w[i]];
-							if(a.y > b.y) swap(a, b);
-							if(v.y < a.y) continue;
-							if(b.y <= v.y) continue;
-							const int64_t diff = int64_t(v.x-a.x) * (b.y-a.y) - int64_t(b.x-a.x) * (v.y-a.y);
-							if(diff > 0) ++ winding;
-							else if(diff == 0) goto v_over_outer;
-						}
-					}
-					if(winding&1) {
+	// The edge grids of outers are built when first needed
+	vector<unique_ptr<EdgeGrid>> grids(cs.size());
+	for(const vector<Member*> &in : inners) {
+		for(uint32_t ci = 0; ci < cs.size(); ++ci) {
+			Component &c = cs[ci];
+			for(const Member* inWay : in) {
+				for(const vec2i v : inWay->pts) {
+					if(!grids[ci]) grids[ci] = make_unique<EdgeGrid>(c.outer | views::transform([](const Member *m)->const vector<vec2i>& { return m->pts; }));
+					switch(grids[ci]->locate(v)) {
+					case EdgeGrid::INSIDE:
 						c.inner.insert_range(c.inner.end(), in);
 						goto outer_found;
+					case EdgeGrid::OUTSIDE:
+						goto not_inside;
+					case EdgeGrid::ON_EDGE:
+						continue;
 					}
-					goto not_inside;
-					v_over_outer:
-					continue;
 				}
 			}
 			THROW_ERROR("All nodes of inner loop over an outer loop");
@@ -360,20 +656,32 @@ static void processMultipolygon(const Proto::Relation &relation, const vector<ve
 		continue;
 	}
 
-	// Add components to polygons
-	for(const Component &c : cs) {
-		for(const auto ways : {&c.outer, &c.inner}) {
-			for(Way *w : *ways) {
-				if(!w->ref.storage) addRoad(misc, *w);
-				polygons.data.push_back(w->ref);
+	mp.components.reserve(cs.size());
+	for(Component &c : cs) {
+		vector<Member*> &ways = mp.components.emplace_back(std::move(c.outer));
+		ways.insert_range(ways.end(), c.inner);
+	}
+	mp.assembled = true;
+	mp.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+// Add the components of an assembled multipolygon to polygons, and release its members
+static void addMultipolygon(Multipolygon &mp, TmpRoad &misc, TmpRelation &polygons) {
+	if(mp.assembled) {
+		for(const vector<Multipolygon::Member*> &c : mp.components) {
+			for(Multipolygon::Member *m : c) {
+				if(!m->w->ref.storage) m->w->ref = addRoad(misc, m->way);
+				polygons.data.push_back(m->w->ref);
 			}
+			polygons.end();
 		}
-		if(polygons.off.size() == 2641) cerr << relation.id << endl;
-		polygons.end();
-	}
+		multipolygonStats.add(mp.id, mp.seconds);
+	} else ++ multipolygonStats.skipped;
+	mp.members = {};
+	mp.components = {};
 }
 
-static void readRelation(const Proto::Relation &relation, const vector<vector<uint8_t>> &ST, OSMData &data, TmpData &tmpData) {
+static RelationTags readRelationTags(const Proto::Relation &relation, const TagTable &table) {
 	const int T = relation.keys.size();
 	if(T != (int) relation.vals.size()) THROW_ERROR("Sizes mismatch in relation's tags...");
 	const int M = relation.memids.size();
@@ -383,21 +691,111 @@ static void readRelation(const Proto::Relation &relation, const vector<vector<ui
 	// Find type
 	RelationTags tags;
 	for(int i = 0; i < T; ++i) {
-		const string_view key = getString(ST, relation.keys[i]);
-		if(key != "type") continue;
-		const string_view val = getString(ST, relation.vals[i]);
-		tags.readType(val);
+		if(table.entries[relation.keys[i]].key != TagKey::TYPE) continue;
+		tags.readType(table, relation.vals[i]);
 		break;
 	}
-	if((uint32_t) tags.type == RelationTags::UNDEF) return;
+	if((uint32_t) tags.type == RelationTags::UNDEF) return tags;
 	tags.init();
 
 	// Read other tags
 	for(int i = 0; i < T; ++i) {
-		const string_view key = getString(ST, relation.keys[i]);
-		const string_view val = getString(ST, relation.vals[i]);
-		tags.readTag(key, val);
+		tags.readTag(table, relation.keys[i], relation.vals[i]);
 	}
+	return tags;
+}
+
+static inline bool isFRRoute(const RelationTags &tags) {
+	return tags.type == RelationType::ROUTE
+		&& (tags.route.network == Network::FR_A_ROAD || tags.route.network == Network::FR_N_ROAD);
+}
+
+static inline bool isForestMultipolygon(const RelationTags &tags) {
+	return tags.type == RelationType::MULTIPOLYGON && tags.multipolygon.landuse == Landuse::FOREST;
+}
+
+// Add the ids of the member ways of a relation
+static void addMemberWays(const Proto::Relation &relation, vector<int64_t> &ids) {
+	int64_t memid = 0;
+	for(size_t i = 0; i < relation.memids.size(); ++i) {
+		memid += relation.memids[i];
+		if(relation.types[i] == Proto::Relation::MemberType::WAY) ids.push_back(memid);
+	}
+}
+
+static void prescanRelations(BinStream &input, vector<BlobInfo> &blobs, bool sorted) {
+	vector<uint8_t> wire, blobData;
+	uint32_t scanned = 0;
+	// When sorted, relations are in the last blobs so we scan backward until reaching a blob without relations
+	for(BlobInfo &blob : blobs | views::reverse) {
+		if(blob.type != BlobInfo::DATA) continue;
+		readBlob(input, blob, wire, blobData);
+		++ scanned;
+		blob.groups = scanGroups(blobData);
+		if(!(blob.groups & BlobInfo::RELATIONS)) {
+			if(sorted) break;
+			continue;
+		}
+		const Proto::PrimitiveBlock pb(blobData);
+		const TagTable table(pb.stringtable.s);
+		for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
+			for(const Proto::Relation &relation : pg.relations) {
+				const RelationTags tags = readRelationTags(relation, table);
+				if(isFRRoute(tags) || isForestMultipolygon(tags)) addMemberWays(relation, neededWays);
+			}
+		}
+	}
+	ranges::sort(neededWays);
+	neededWays.erase(ranges::unique(neededWays).begin(), neededWays.end());
+	neededWays.shrink_to_fit();
+	cout << "Relation prescan: " << scanned << " blobs read, " << neededWays.size() << " ways needed" << endl;
+}
+
+// Estimate the number of nodes from the number of blobs with dense nodes and the content of the first one
+static size_t estimateNodes(BinStream &input, vector<BlobInfo> &blobs, bool sorted) {
+	vector<uint8_t> wire, blobData;
+	const auto hasDense = [&](BlobInfo &blob)->bool {
+		if(blob.groups == BlobInfo::UNKNOWN) {
+			readBlob(input, blob, wire, blobData);
+			blob.groups = scanGroups(blobData);
+		}
+		return blob.groups & BlobInfo::DENSE;
+	};
+	uint32_t first = 1, denseBlobs = 0;
+	if(sorted) {
+		// Blobs with nodes come first, binary search the first one without
+		uint32_t a = 1, b = blobs.size();
+		while(a < b) {
+			const uint32_t m = (a + b) / 2;
+			if(hasDense(blobs[m])) a = m+1;
+			else b = m;
+		}
+		denseBlobs = a - 1;
+	} else {
+		// All blobs have been scanned by the relation prescan
+		denseBlobs = ranges::count_if(blobs, [](const BlobInfo &b) { return b.type == BlobInfo::DATA && (b.groups & BlobInfo::DENSE); });
+		while(first < blobs.size() && !(blobs[first].groups & BlobInfo::DENSE)) ++ first;
+	}
+	if(!denseBlobs) return 0;
+	readBlob(input, blobs[first], wire, blobData);
+	size_t count = 0;
+	for(const Proto::PrimitiveGroup &pg : parsePrimitiveBlock(blobData).primitivegroup)
+		count += pg.dense.id.size();
+	return count * denseBlobs;
+}
+
+template<typename T>
+static void printStats(const char *name, const typename HashMap<T>::Stats &stats) {
+	cout << name << " hash map: " << stats.size << " elements in " << stats.buckets << " buckets (load factor " << stats.loadFactor() << "), "
+		<< stats.bytes << " bytes, " << stats.rehashes << " rehashes in " << stats.rehashSeconds << "s\n";
+	cout << "\tchain lengths:";
+	for(size_t l = 0; l < stats.chains.size(); ++l) cout << ' ' << l << ':' << stats.chains[l];
+	cout << endl;
+}
+
+// Returns whether the relation may produce output
+static bool readRelation(const Proto::Relation &relation, const TagTable &table, OSMData &data, vector<Multipolygon> &multipolygons) {
+	const RelationTags tags = readRelationTags(relation, table);
 
 	// Process
 	switch(tags.type) {
@@ -408,7 +806,7 @@ static void readRelation(const Proto::Relation &relation, const vector<vector<ui
 		// 	for(int i = 0; i < M; ++i) {
 		// 		memid += relation.memids[i];
 		// 		if(relation.types[i] != Proto::Relation::MemberType::WAY) continue;
-		// 		const string_view role = getString(ST, relation.roles_sid[i]);
+		// 		const string_view role = table.strings[relation.roles_sid[i]];
 		// 		if(role == "main_stream" && rivers.contains(memid))
 		// 			mainRivers.push_back(memid);
 		// 	}
@@ -416,13 +814,14 @@ static void readRelation(const Proto::Relation &relation, const vector<vector<ui
 		break;
 	case RelationType::ROUTE: {
 		const auto &route = tags.route;
-		if(route.network == Network::FR_A_ROAD || route.network == Network::FR_N_ROAD) {
+		if(isFRRoute(tags)) {
 			int64_t id = 0;
 			for(const int64_t mem : relation.memids) {
 				id += mem;
-				const auto it = ways.find(id);
-				if(it == ways.end()) continue;
-				data.roadNames.emplace_back(nodes[it->second.way[0]], data.names.size());
+				const WayStore &store = ways(id);
+				const auto it = store.map.find(id);
+				if(it == store.map.end()) continue;
+				data.roadNames.emplace_back(getNode(store.refs[it->second.run].front()), data.names.size());
 				data.names.insert(data.names.end(), route.ref.begin(), route.ref.end());
 				data.names.push_back('\0');
 				break;
@@ -431,12 +830,847 @@ static void readRelation(const Proto::Relation &relation, const vector<vector<ui
 		break;
 	}
 	case RelationType::MULTIPOLYGON:
-		if(tags.multipolygon.landuse == Landuse::FOREST)
-			processMultipolygon(relation, ST, tmpData.misc, tmpData.forestsR);
+		if(isForestMultipolygon(tags))
+			queueMultipolygon(relation, table, multipolygons);
 		break;
 	default:
 		break;
 	}
+	return isFRRoute(tags) || isForestMultipolygon(tags);
+}
+
+// Copy of a relation whose tags and roles index `to`, where the strings of `from` are added as needed
+static Proto::Relation internRelation(const Proto::Relation &relation, span<const string_view> from,
+		Proto::StringTable &to, unordered_map<string, uint32_t> &ids) {
+	const auto intern = [&](const uint32_t s) {
+		const string_view str = from[s];
+		const auto [it, added] = ids.try_emplace(string(str), to.s.size());
+		if(added) to.s.emplace_back(str.begin(), str.end());
+		return it->second;
+	};
+	Proto::Relation r;
+	r.id = relation.id;
+	r.keys.insert_range(r.keys.end(), relation.keys | views::transform(intern));
+	r.vals.insert_range(r.vals.end(), relation.vals | views::transform(intern));
+	r.memids = relation.memids;
+	r.types = relation.types;
+	r.roles_sid.insert_range(r.roles_sid.end(), relation.roles_sid | views::transform(intern));
+	return r;
+}
+
+// Merge blocks in file order, so that the output does not depend on the number of threads
+static void mergeBlocks(vector<BlockData> &blocks, OSMData &data, TmpData &tmpData, SourceIndex *source) {
+	unordered_map<const TmpRoad*, TmpRef> blockRoads; // block storage => merged storage and index of its first road
+	const auto mergeRoads = [&](TmpRoad &roads, TmpRoad &blockRoad) {
+		blockRoads[&blockRoad] = {&roads, (uint32_t) roads.off.size()-1};
+		const uint64_t off = roads.data.size();
+		roads.data.insert_range(roads.data.end(), blockRoad.data);
+		roads.off.insert_range(roads.off.end(),
+			blockRoad.off
+			| views::drop(1)
+			| views::transform([&](const uint64_t o) { return off + o; })
+		);
+		blockRoad.data.clear();
+		blockRoad.data.shrink_to_fit();
+	};
+	for(BlockData &block : blocks) {
+		for(uint32_t i = 0; i < tmpData.roads.size(); ++i) mergeRoads(tmpData.roads[i], block.tmp.roads[i]);
+		for(uint32_t i = 0; i < tmpData.waterWays.size(); ++i) mergeRoads(tmpData.waterWays[i], block.tmp.waterWays[i]);
+		mergeRoads(tmpData.boundaries, block.tmp.boundaries);
+		mergeRoads(tmpData.forests, block.tmp.forests);
+		const uint32_t namesOff = data.names.size();
+		data.names.insert_range(data.names.end(), block.names);
+		data.capitals.insert_range(data.capitals.end(), block.capitals | views::transform([&](const pair<vec2i, uint32_t> &c) {
+			return make_pair(c.first, c.second + namesOff);
+		}));
+		if(source) {
+			for(size_t c = 0; c < block.capitals.size(); ++c)
+				source->capitals.push_back({block.capitalIds[c], block.names.data() + block.capitals[c].second});
+			source->ways.insert(source->ways.end(), make_move_iterator(block.sourceWays.begin()), make_move_iterator(block.sourceWays.end()));
+		}
+	}
+	for(WayStore &store : ways.shards) {
+		for(Way &w : store.map | views::values) {
+			if(!w.ref.storage) continue;
+			const TmpRef &r = blockRoads.at(w.ref.storage);
+			w.ref = {r.storage, r.ind + w.ref.ind};
+		}
+	}
+	blocks.clear();
+	blocks.shrink_to_fit();
+	if(source) {
+		// Ways only needed by relations
+		for(const WayStore &store : ways.shards)
+			for(const auto &[id, w] : store.map)
+				if(!w.ref.storage) source->ways.push_back({id, Rules::NONE, store.refs[w.run].decode()});
+		ranges::sort(source->ways, {}, &SourceIndex::Way::id);
+	}
+}
+
+// Nodes and relations of the source index, once all are read
+static void endSource(SourceIndex &source) {
+	ranges::sort(source.relations, {}, &Proto::Relation::id);
+	for(const HashMap<vec2i> &shard : nodes.shards) source.nodes.insert(source.nodes.end(), shard.begin(), shard.end());
+	ranges::sort(source.nodes, {}, &pair<int64_t, vec2i>::first);
+}
+
+// Size the stores beforehand so that they do not rehash while growing
+static void reserveStores(const size_t nodesEstimate) {
+	for(HashMap<vec2i> &shard : nodes.shards) shard.reserve(nodesEstimate / nodes.SHARDS + nodesEstimate / (16 * nodes.SHARDS));
+	array<size_t, decltype(ways)::SHARDS> waysPerShard {};
+	for(const int64_t id : neededWays) ++ waysPerShard[ways.index(id)];
+	for(size_t s = 0; s < waysPerShard.size(); ++s) ways.shards[s].map.reserve(waysPerShard[s]);
+}
+
+// Read the PBF up to its relations: nodes, polylines of the ways of the layers, ways needed by relations
+// and queued multipolygons. The entities the output is made of are gathered in `source` if it is given.
+static void readPBF(const char *inputFile, const uint32_t threads, OSMData &data, TmpData &tmpData, vector<BlockData> &blocks,
+		vector<Multipolygon> &multipolygons, SourceIndex *source, const function<void(const string&)> &endPhase) {
+	BinStream input(inputFile);
+	vector<uint8_t> wire, blobData;
+
+	vector<BlobInfo> blobs = indexBlobs(input);
+	if(blobs.empty() || blobs[0].type != BlobInfo::HEADER) THROW_ERROR("OSMData blob before any OSMHeader...");
+	if(ranges::count(blobs, BlobInfo::HEADER, &BlobInfo::type) > 1) THROW_ERROR("multiple OSMHeader...");
+	readBlob(input, blobs[0], wire, blobData);
+	const bool sorted = readHeader(blobData, data);
+	if(source) source->bbox = data.bbox;
+	prescanRelations(input, blobs, sorted);
+
+	const size_t nodesEstimate = estimateNodes(input, blobs, sorted);
+	cout << "Estimated nodes: " << nodesEstimate << endl;
+	reserveStores(nodesEstimate);
+	endPhase("prescan");
+
+	struct Worker {
+		BinStream input;
+		vector<uint8_t> wire, blobData;
+		Worker(const char *fileName): input(fileName) {}
+	};
+	deque<Worker> workers;
+	for(uint32_t t = 0; t < threads; ++t) workers.emplace_back(inputFile);
+	blocks.resize(blobs.size());
+
+	// Blocks whose string table shows that none of their entities can produce output
+	atomic<uint32_t> nodeBlocks = 0, skippedNodeBlocks = 0, wayBlocks = 0, skippedWayBlocks = 0;
+
+	// Nodes
+	// In a sorted file, blobs after the first one without nodes are left to the ways pass
+	atomic<uint32_t> firstWithoutNodes = blobs.size();
+	parallelFor(blobs.size(), threads, [&](const uint32_t i, const uint32_t t) {
+		BlobInfo &blob = blobs[i];
+		if(blob.type != BlobInfo::DATA || !(blob.groups & BlobInfo::DENSE)) return;
+		if(sorted && i > firstWithoutNodes) return;
+		Worker &w = workers[t];
+		readBlob(w.input, blob, w.wire, w.blobData);
+		blob.groups = scanGroups(w.blobData);
+		if(!(blob.groups & BlobInfo::DENSE)) {
+			uint32_t first = firstWithoutNodes;
+			while(i < first && !firstWithoutNodes.compare_exchange_weak(first, i));
+			return;
+		}
+		const Proto::PrimitiveBlock pb = parsePrimitiveBlock(w.blobData);
+		const TagTable table(pb.stringtable.s);
+		bool tagsRead = false;
+		for(const Proto::PrimitiveGroup &pg : pb.primitivegroup)
+			if(pg._has_dense) tagsRead |= readDense(pb, pg.dense, table, blocks[i]);
+		++ nodeBlocks;
+		if(!tagsRead) ++ skippedNodeBlocks;
+	});
+	endPhase("nodes");
+
+	// Ways
+	parallelFor(blobs.size(), threads, [&](const uint32_t i, const uint32_t t) {
+		BlobInfo &blob = blobs[i];
+		if(blob.type != BlobInfo::DATA || !(blob.groups & BlobInfo::WAYS)) return;
+		Worker &w = workers[t];
+		readBlob(w.input, blob, w.wire, w.blobData);
+		blob.groups = scanGroups(w.blobData);
+		if((blob.groups & BlobInfo::DENSE) && !blocks[i].denseRead) THROW_ERROR("Nodes after ways in a file sorted by type");
+		if(!(blob.groups & BlobInfo::WAYS)) return;
+		const Proto::PrimitiveBlock pb = parsePrimitiveBlock(w.blobData);
+		const TagTable table(pb.stringtable.s);
+		const Rules::Block rulesBlock = wayRules->classify(table);
+		for(const Proto::PrimitiveGroup &pg : pb.primitivegroup)
+			for(const Proto::Way &way : pg.ways) {
+				if(!way.lat.empty() || !way.lon.empty()) THROW_ERROR("lat and lon fields in Way are not supported");
+				readWay(way.id, way.keys, way.vals, way.refs, rulesBlock, blocks[i], source != nullptr);
+			}
+		++ wayBlocks;
+		if(!rulesBlock.mayMatch) ++ skippedWayBlocks;
+	});
+	workers.clear();
+	cout << "Tags skipped in " << skippedNodeBlocks << "/" << nodeBlocks << " node blocks and "
+		<< skippedWayBlocks << "/" << wayBlocks << " way blocks" << endl;
+	endPhase("ways");
+
+	mergeBlocks(blocks, data, tmpData, source);
+	endPhase("merge");
+
+	// Relations
+	unordered_map<string, uint32_t> relationStrings;
+	for(BlobInfo &blob : blobs) {
+		if(blob.type != BlobInfo::DATA || !(blob.groups & BlobInfo::RELATIONS)) continue;
+		readBlob(input, blob, wire, blobData);
+		const Proto::PrimitiveBlock pb = parsePrimitiveBlock(blobData);
+		const TagTable table(pb.stringtable.s);
+		for(const Proto::PrimitiveGroup &pg : pb.primitivegroup)
+			for(const Proto::Relation &relation : pg.relations)
+				if(readRelation(relation, table, data, multipolygons) && source)
+					source->relations.push_back(internRelation(relation, table.strings, source->relationStrings, relationStrings));
+	}
+	input.close();
+	if(source) endSource(*source);
+}
+
+// Size and modification time of a file, that an entity cache keeps from its PBF
+static pair<uint64_t, int64_t> fileStamp(const char *fileName) {
+	return {filesystem::file_size(fileName), filesystem::last_write_time(fileName).time_since_epoch().count()};
+}
+
+// Decode all the entities of the PBF once into an entity cache, whatever the rules use
+static void writeCache(const char *inputFile, const char *cacheFile, const uint32_t threads) {
+	BinStream input(inputFile);
+	vector<uint8_t> wire, blobData;
+	const vector<BlobInfo> blobs = indexBlobs(input);
+	if(blobs.empty() || blobs[0].type != BlobInfo::HEADER) THROW_ERROR("OSMData blob before any OSMHeader...");
+	if(ranges::count(blobs, BlobInfo::HEADER, &BlobInfo::type) > 1) THROW_ERROR("multiple OSMHeader...");
+	readBlob(input, blobs[0], wire, blobData);
+	OSMData header;
+	readHeader(blobData, header);
+	input.close();
+
+	struct Worker {
+		BinStream input;
+		vector<uint8_t> wire, blobData;
+		Worker(const char *fileName): input(fileName) {}
+	};
+	deque<Worker> workers;
+	for(uint32_t t = 0; t < threads; ++t) workers.emplace_back(inputFile);
+	EntityCacheWriter writer(cacheFile, header.bbox);
+	// Blobs are decoded a window at a time and appended in file order, so that only the window is in memory
+	const uint32_t window = 4 * threads;
+	vector<EntityCache> blocks(window);
+	for(uint32_t first = 0; first < blobs.size(); first += window) {
+		const uint32_t count = min<uint32_t>(window, blobs.size() - first);
+		parallelFor(count, threads, [&](const uint32_t k, const uint32_t t) {
+			const uint32_t i = first + k;
+			if(blobs[i].type != BlobInfo::DATA) return;
+			Worker &w = workers[t];
+			readBlob(w.input, blobs[i], w.wire, w.blobData);
+			const Proto::PrimitiveBlock pb = parsePrimitiveBlock(w.blobData);
+			EntityCache &block = blocks[k];
+
+			// Strings used by the entities, in their order of first use
+			vector<uint32_t> strings(pb.stringtable.s.size(), numeric_limits<uint32_t>::max());
+			const auto str = [&](const uint32_t s) {
+				if(s >= strings.size()) THROW_ERROR("String index out of the string table...");
+				if(strings[s] == numeric_limits<uint32_t>::max()) {
+					strings[s] = block.stringOffsets.size()-1;
+					block.stringChars.insert(block.stringChars.end(), pb.stringtable.s[s].begin(), pb.stringtable.s[s].end());
+					block.stringOffsets.push_back(block.stringChars.size());
+				}
+				return strings[s];
+			};
+			for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
+				if(pg._has_dense) {
+					const Proto::DenseNodes &dense = pg.dense;
+					const size_t N = dense.id.size();
+					if(N != dense.lat.size() || N != dense.lon.size()) THROW_ERROR("Sizes mismatch in denseNodes...");
+					auto kv_it = dense.keys_vals.begin();
+					int64_t id = 0, lat = 0, lon = 0;
+					for(size_t n = 0; n < N; ++n) {
+						id += dense.id[n];
+						lat += dense.lat[n];
+						lon += dense.lon[n];
+						block.nodeIds.push_back(id);
+						block.nodeCoords.emplace_back(pb.lon_offset + pb.granularity * lon, pb.lat_offset + pb.granularity * lat);
+						if(dense.keys_vals.empty()) continue;
+						if(kv_it == dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+						if(!*kv_it) {
+							++ kv_it;
+							continue;
+						}
+						block.taggedNodes.push_back(block.nodeIds.size()-1);
+						while(*kv_it) {
+							if(dense.keys_vals.end() - kv_it < 3) THROW_ERROR("Sizes mismatch in denseNodes...");
+							block.nodeKeys.push_back(str(*(kv_it++)));
+							block.nodeVals.push_back(str(*(kv_it++)));
+						}
+						++ kv_it;
+						block.nodeTagOffsets.push_back(block.nodeKeys.size());
+					}
+					if(kv_it != dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+				}
+				for(const Proto::Way &way : pg.ways) {
+					if(!way.lat.empty() || !way.lon.empty()) THROW_ERROR("lat and lon fields in Way are not supported");
+					if(way.keys.size() != way.vals.size()) THROW_ERROR("Sizes mismatch in way's tags...");
+					block.wayIds.push_back(way.id);
+					block.wayRefs.insert(block.wayRefs.end(), way.refs.begin(), way.refs.end());
+					block.wayRefOffsets.push_back(block.wayRefs.size());
+					block.wayKeys.insert_range(block.wayKeys.end(), way.keys | views::transform(str));
+					block.wayVals.insert_range(block.wayVals.end(), way.vals | views::transform(str));
+					block.wayTagOffsets.push_back(block.wayKeys.size());
+				}
+				for(const Proto::Relation &relation : pg.relations) {
+					if(relation.keys.size() != relation.vals.size()) THROW_ERROR("Sizes mismatch in relation's tags...");
+					if(relation.memids.size() != relation.roles_sid.size() || relation.memids.size() != relation.types.size())
+						THROW_ERROR("Sizes mismatch in relation's members...");
+					block.relationIds.push_back(relation.id);
+					block.memberIds.insert(block.memberIds.end(), relation.memids.begin(), relation.memids.end());
+					block.memberTypes.insert_range(block.memberTypes.end(), relation.types | views::transform([](const Proto::Relation::MemberType t) { return (uint8_t) t; }));
+					block.memberRoles.insert_range(block.memberRoles.end(), relation.roles_sid | views::transform([&](const int32_t s) { return (int32_t) str(s); }));
+					block.memberOffsets.push_back(block.memberIds.size());
+					block.relationKeys.insert_range(block.relationKeys.end(), relation.keys | views::transform(str));
+					block.relationVals.insert_range(block.relationVals.end(), relation.vals | views::transform(str));
+					block.relationTagOffsets.push_back(block.relationKeys.size());
+				}
+			}
+		});
+		for(EntityCache &block : blocks | views::take(count)) {
+			writer.append(block);
+			block = EntityCache();
+		}
+	}
+	workers.clear();
+
+	const auto [size, time] = fileStamp(inputFile);
+	writer.close(size, time);
+	cout << "Entity cache written to " << cacheFile << ": " << writer.nodes << " nodes, " << writer.ways << " ways, "
+		<< writer.relations << " relations, " << writer.strings << " strings, " << filesystem::file_size(cacheFile) << " bytes" << endl;
+}
+
+// Read an entity cache as readPBF reads the PBF, with one string table for all entities
+static void readCache(const EntityCacheView &cache, const uint32_t threads, OSMData &data, TmpData &tmpData, vector<BlockData> &blocks,
+		vector<Multipolygon> &multipolygons, SourceIndex *source, const function<void(const string&)> &endPhase) {
+	data.bbox = cache.bbox;
+	if(source) source->bbox = data.bbox;
+	vector<string_view> strings(cache.stringOffsets.size()-1);
+	for(size_t s = 0; s < strings.size(); ++s) strings[s] = cache.string(s);
+	const TagTable table(std::move(strings));
+	const auto relation = [&](const size_t r) {
+		Proto::Relation relation;
+		relation.id = cache.relationIds[r];
+		const auto range = [&]<typename T>(const span<const T> column, const span<const uint64_t> offsets) {
+			return column.subspan(offsets[r], offsets[r+1] - offsets[r]);
+		};
+		relation.keys.insert_range(relation.keys.end(), range(cache.relationKeys, cache.relationTagOffsets));
+		relation.vals.insert_range(relation.vals.end(), range(cache.relationVals, cache.relationTagOffsets));
+		relation.memids.insert_range(relation.memids.end(), range(cache.memberIds, cache.memberOffsets));
+		relation.types.insert_range(relation.types.end(), range(cache.memberTypes, cache.memberOffsets)
+			| views::transform([](const uint8_t t) { return Proto::Relation::MemberType(t); }));
+		relation.roles_sid.insert_range(relation.roles_sid.end(), range(cache.memberRoles, cache.memberOffsets));
+		return relation;
+	};
+
+	// Ways needed by relations, and stores sized for all the nodes
+	for(size_t r = 0; r < cache.relationIds.size(); ++r) {
+		const Proto::Relation rel = relation(r);
+		const RelationTags tags = readRelationTags(rel, table);
+		if(isFRRoute(tags) || isForestMultipolygon(tags)) addMemberWays(rel, neededWays);
+	}
+	ranges::sort(neededWays);
+	neededWays.erase(ranges::unique(neededWays).begin(), neededWays.end());
+	neededWays.shrink_to_fit();
+	cout << "Relation prescan: " << cache.relationIds.size() << " relations read, " << neededWays.size() << " ways needed" << endl;
+	reserveStores(cache.nodeIds.size());
+	endPhase("prescan");
+
+	// Nodes and ways by chunks, merged in order as the blocks of the PBF
+	static constexpr size_t NODE_CHUNK = 1 << 16, WAY_CHUNK = 1 << 13;
+	const uint32_t nodeChunks = (cache.nodeIds.size() + NODE_CHUNK-1) / NODE_CHUNK;
+	const uint32_t wayChunks = (cache.wayIds.size() + WAY_CHUNK-1) / WAY_CHUNK;
+	blocks.resize(nodeChunks + wayChunks);
+	const bool readTags = table.has(TagKey::PLACE) && table.has(TagKey::CAPITAL);
+	parallelFor(nodeChunks, threads, [&](const uint32_t i, const uint32_t) {
+		const size_t start = i * NODE_CHUNK, end = min(start + NODE_CHUNK, cache.nodeIds.size());
+		NodeBatches batches;
+		for(size_t n = start; n < end; ++n) batches[nodes.index(cache.nodeIds[n])].emplace_back(cache.nodeIds[n], cache.nodeCoords[n]);
+		insertNodes(batches);
+		if(!readTags) return;
+		for(size_t t = ranges::lower_bound(cache.taggedNodes, start) - cache.taggedNodes.begin();
+				t < cache.taggedNodes.size() && cache.taggedNodes[t] < end; ++t) {
+			NodeTags tags;
+			for(uint64_t k = cache.nodeTagOffsets[t]; k < cache.nodeTagOffsets[t+1]; ++k)
+				tags.readTag(table, cache.nodeKeys[k], cache.nodeVals[k]);
+			const size_t n = cache.taggedNodes[t];
+			readCapital(cache.nodeIds[n], cache.nodeCoords[n], tags, blocks[i]);
+		}
+	});
+	endPhase("nodes");
+
+	const Rules::Block rulesBlock = wayRules->classify(table);
+	parallelFor(wayChunks, threads, [&](const uint32_t i, const uint32_t) {
+		const size_t start = i * WAY_CHUNK, end = min(start + WAY_CHUNK, cache.wayIds.size());
+		for(size_t w = start; w < end; ++w) {
+			const uint64_t t = cache.wayTagOffsets[w], r = cache.wayRefOffsets[w];
+			const uint64_t T = cache.wayTagOffsets[w+1] - t, R = cache.wayRefOffsets[w+1] - r;
+			readWay(cache.wayIds[w], cache.wayKeys.subspan(t, T), cache.wayVals.subspan(t, T), cache.wayRefs.subspan(r, R),
+				rulesBlock, blocks[nodeChunks + i], source != nullptr);
+		}
+	});
+	endPhase("ways");
+	mergeBlocks(blocks, data, tmpData, source);
+	endPhase("merge");
+
+	// Relations
+	unordered_map<string, uint32_t> relationStrings;
+	for(size_t r = 0; r < cache.relationIds.size(); ++r) {
+		const Proto::Relation rel = relation(r);
+		if(readRelation(rel, table, data, multipolygons) && source)
+			source->relations.push_back(internRelation(rel, table.strings, source->relationStrings, relationStrings));
+	}
+	if(source) endSource(*source);
+}
+
+// Layers of ways an update makes again from the source index, the others being copied with their levels
+// of detail from the former output. Areas are copied when the layer of forests is. A conversion makes all.
+struct UpdatePlan {
+	OSMData former;
+	array<bool, size(wayLayers)> rebuilt;
+	array<bool, size(wayLayers)> memberLayers {}; // layers with ways of forest multipolygons
+	UpdatePlan() { rebuilt.fill(true); }
+};
+
+// The former output of an update, whose layers are kept if it has the levels of detail of this converter.
+// Points of the indexed layout are expanded, and areas made again as they index its distinct points.
+static void readFormer(const char *fileName, UpdatePlan &plan) {
+	OSMData &former = plan.former;
+	former.read(fileName);
+	vector<uint32_t> tolerances;
+	for(const uint32_t zoom : LOD_ZOOMS) tolerances.push_back(lodTolerance(zoom));
+	if(former.lodTolerances != tolerances) {
+		cout << "The former output has other levels of detail, all layers are made again" << endl;
+		return;
+	}
+	plan.rebuilt.fill(false);
+	if(!former.roadIndices.empty()) {
+		vector<vec2i> points(former.roadIndices.size());
+		ranges::transform(former.roadIndices, points.begin(), [&](const uint32_t i) { return former.roads[i]; });
+		former.roads = std::move(points);
+		former.roadIndices = {};
+		plan.rebuilt[FOREST_LAYER] = true;
+	}
+}
+
+// Sorted ids of the member ways of the forest multipolygons
+static vector<int64_t> forestMemberWays(const vector<Proto::Relation> &relations, const TagTable &table) {
+	vector<int64_t> ids;
+	for(const Proto::Relation &r : relations)
+		if(isForestMultipolygon(readRelationTags(r, table))) addMemberWays(r, ids);
+	ranges::sort(ids);
+	ids.erase(ranges::unique(ids).begin(), ids.end());
+	return ids;
+}
+
+// Polylines of a layer in an output, the ways of multipolygons in no layer coming after the last layer
+static pair<uint32_t, uint32_t> layerPolylines(const OSMData &data, const uint32_t layer) {
+	if(layer < (uint32_t) RoadType::NUM) return {data.roadTypeOffsets[layer], data.roadTypeOffsets[layer+1]};
+	const uint32_t w = layer - (uint32_t) RoadType::NUM;
+	if(w < (uint32_t) WaterWayType::NUM) return {data.waterWayTypeOffsets[w], data.waterWayTypeOffsets[w+1]};
+	if(layer == FOREST_LAYER - 1) return data.boundaries;
+	if(layer == FOREST_LAYER) return data.forests;
+	return {data.forests.second, data.roadOffsets.size()-1};
+}
+
+// Apply an OsmChange to the entities of the source index, then make them into what readPBF makes of a PBF
+// sorted by type and id, only for the layers whose polylines change. Those are added to `plan.rebuilt`.
+static void readUpdate(const char *changeFile, SourceIndex &source, UpdatePlan &plan, OSMData &data, TmpData &tmpData,
+		vector<Multipolygon> &multipolygons, const function<void(const string&)> &endPhase) {
+	const OsmChange change(changeFile);
+	cout << "Changes: " << change.nodes.size() << " nodes, " << change.ways.size() << " ways, "
+		<< change.relations.size() << " relations" << endl;
+	const TagTable table(change.strings.s);
+	const auto findWay = [&](const int64_t id)->const SourceIndex::Way* {
+		const auto it = ranges::lower_bound(source.ways, id, {}, &SourceIndex::Way::id);
+		return it != source.ways.end() && it->id == id ? &*it : nullptr;
+	};
+	const auto rebuildLayerOf = [&](const int64_t id) {
+		const SourceIndex::Way *const w = findWay(id);
+		if(w && w->layer != Rules::NONE) plan.rebuilt[w->layer] = true;
+	};
+
+	// Ways whose polylines change: those changed, those with moved or deleted nodes and the members of
+	// changed forest multipolygons. Their layers before and after the change are made again.
+	vector<int64_t> changedNodes, touchedWays;
+	for(const auto &[action, node] : change.nodes) {
+		const auto it = ranges::lower_bound(source.nodes, node.id, {}, &pair<int64_t, vec2i>::first);
+		if(action == OsmChange::DELETE || it == source.nodes.end() || it->first != node.id || !(it->second == node.coords))
+			changedNodes.push_back(node.id);
+	}
+	ranges::sort(changedNodes);
+	for(const SourceIndex::Way &w : source.ways)
+		if(ranges::any_of(w.refs, [&](const int64_t ref) { return ranges::binary_search(changedNodes, ref); }))
+			touchedWays.push_back(w.id);
+	for(const auto &[action, way] : change.ways) touchedWays.push_back(way.id);
+	bool forestsChanged = false;
+	{
+		const TagTable relationTable(source.relationStrings.s);
+		for(const auto &[action, relation] : change.relations) {
+			const auto it = ranges::lower_bound(source.relations, relation.id, {}, &Proto::Relation::id);
+			if(it != source.relations.end() && it->id == relation.id && isForestMultipolygon(readRelationTags(*it, relationTable))) {
+				forestsChanged = true;
+				addMemberWays(*it, touchedWays);
+			}
+			if(action != OsmChange::DELETE && isForestMultipolygon(readRelationTags(relation, table))) {
+				forestsChanged = true;
+				addMemberWays(relation, touchedWays);
+			}
+		}
+		const vector<int64_t> members = forestMemberWays(source.relations, relationTable);
+		for(const int64_t id : members) {
+			const SourceIndex::Way *const w = findWay(id);
+			if(w && w->layer != Rules::NONE) plan.memberLayers[w->layer] = true;
+		}
+		forestsChanged = forestsChanged || ranges::any_of(touchedWays, [&](const int64_t id) { return ranges::binary_search(members, id); });
+	}
+	ranges::sort(touchedWays);
+	touchedWays.erase(ranges::unique(touchedWays).begin(), touchedWays.end());
+	for(const int64_t id : touchedWays) rebuildLayerOf(id);
+
+	// Nodes and capitals, whose tags are given with every change
+	vector<pair<int64_t, optional<pair<int64_t, vec2i>>>> nodeChanges;
+	vector<pair<int64_t, optional<SourceIndex::Capital>>> capitalChanges;
+	for(const auto &[action, node] : change.nodes) {
+		nodeChanges.emplace_back(node.id, nullopt);
+		capitalChanges.emplace_back(node.id, nullopt);
+		if(action == OsmChange::DELETE) continue;
+		nodeChanges.back().second = pair(node.id, node.coords);
+		NodeTags tags;
+		for(size_t i = 0; i < node.keys.size(); ++i) tags.readTag(table, node.keys[i], node.vals[i]);
+		if(tags.place == Place::CITY && tags.capital >= 0 && tags.capital <= 6)
+			capitalChanges.back().second = SourceIndex::Capital{node.id, string(tags.name)};
+	}
+	applyChanges(source.nodes, nodeChanges, [](const pair<int64_t, vec2i> &n) { return n.first; });
+	applyChanges(source.capitals, capitalChanges, [](const SourceIndex::Capital &c) { return c.id; });
+
+	// Ways, classified again
+	const Rules::Block rulesBlock = wayRules->classify(table);
+	vector<pair<int64_t, optional<SourceIndex::Way>>> wayChanges;
+	for(const auto &[action, way] : change.ways) {
+		wayChanges.emplace_back(way.id, nullopt);
+		if(action == OsmChange::DELETE) continue;
+		SourceIndex::Way &w = wayChanges.back().second.emplace(way.id,
+			rulesBlock.mayMatch ? wayRules->match(rulesBlock, way.keys, way.vals) : Rules::NONE);
+		w.refs.resize(way.refs.size());
+		partial_sum(way.refs.begin(), way.refs.end(), w.refs.begin());
+	}
+	applyChanges(source.ways, wayChanges, [](const SourceIndex::Way &w) { return w.id; });
+
+	// Relations, whose strings are then compacted
+	unordered_map<string, uint32_t> ids;
+	for(uint32_t s = 0; s < source.relationStrings.s.size(); ++s)
+		ids.try_emplace(string(source.relationStrings.s[s].begin(), source.relationStrings.s[s].end()), s);
+	vector<pair<int64_t, optional<Proto::Relation>>> relationChanges;
+	vector<int64_t> changedMembers;
+	for(const auto &[action, relation] : change.relations) {
+		relationChanges.emplace_back(relation.id, nullopt);
+		if(action == OsmChange::DELETE) continue;
+		const RelationTags tags = readRelationTags(relation, table);
+		if(!isFRRoute(tags) && !isForestMultipolygon(tags)) continue;
+		relationChanges.back().second = internRelation(relation, table.strings, source.relationStrings, ids);
+		addMemberWays(relation, changedMembers);
+	}
+	applyChanges(source.relations, relationChanges, [](const Proto::Relation &r) { return r.id; });
+	Proto::StringTable strings;
+	ids.clear();
+	{
+		const TagTable relationStrings(source.relationStrings.s);
+		for(Proto::Relation &r : source.relations) r = internRelation(r, relationStrings.strings, strings, ids);
+	}
+	source.relationStrings = std::move(strings);
+	const TagTable relationTable(source.relationStrings.s);
+
+	// Ways needed by relations, those that are neither needed nor in a layer are no longer kept
+	neededWays.clear();
+	for(const Proto::Relation &r : source.relations) addMemberWays(r, neededWays);
+	ranges::sort(neededWays);
+	neededWays.erase(ranges::unique(neededWays).begin(), neededWays.end());
+	erase_if(source.ways, [](const SourceIndex::Way &w) {
+		return w.layer == Rules::NONE && !ranges::binary_search(neededWays, w.id);
+	});
+	// A way that was in no layer nor relation is not in the index, it is only known if the change has it
+	const size_t missing = ranges::count_if(changedMembers, [&](const int64_t id) { return !findWay(id); });
+	if(missing) cout << "Warning: " << missing << " ways of changed relations are not in the source index, "
+		"convert the PBF again if it has them" << endl;
+
+	// Layers after the change. Multipolygons index the polylines of the layers of their members,
+	// so that areas and those layers are made again together.
+	for(const int64_t id : touchedWays) rebuildLayerOf(id);
+	for(const int64_t id : forestMemberWays(source.relations, relationTable)) {
+		const SourceIndex::Way *const w = findWay(id);
+		if(w && w->layer != Rules::NONE) plan.memberLayers[w->layer] = true;
+	}
+	if(forestsChanged) plan.rebuilt[FOREST_LAYER] = true;
+	for(uint32_t l = 0; l < size(wayLayers); ++l)
+		if(plan.memberLayers[l] && plan.rebuilt[l]) plan.rebuilt[FOREST_LAYER] = true;
+	if(plan.rebuilt[FOREST_LAYER])
+		for(uint32_t l = 0; l < size(wayLayers); ++l) plan.rebuilt[l] = plan.rebuilt[l] || plan.memberLayers[l];
+	endPhase("changes");
+
+	// Entities in order of id, as in a sorted PBF
+	data.bbox = source.bbox;
+	if(data.bbox.min.x == numeric_limits<int32_t>::max())
+		for(const vec2i &node : source.nodes | views::values) data.bbox.update(node);
+	const auto findNode = [&](const int64_t id)->const vec2i* {
+		const auto it = ranges::lower_bound(source.nodes, id, {}, &pair<int64_t, vec2i>::first);
+		return it != source.nodes.end() && it->first == id ? &it->second : nullptr;
+	};
+	for(const SourceIndex::Capital &c : source.capitals) {
+		const vec2i *const node = findNode(c.id);
+		if(!node) continue;
+		data.capitals.emplace_back(*node, data.names.size());
+		data.names.insert(data.names.end(), c.name.begin(), c.name.end());
+		data.names.push_back('\0');
+	}
+	// Nodes of the ways, found by a merge of their sorted ids rather than by a search each
+	const auto addNodes = [&](const auto &kept) {
+		vector<int64_t> refs;
+		for(const SourceIndex::Way &w : source.ways) if(kept(w)) refs.insert(refs.end(), w.refs.begin(), w.refs.end());
+		ranges::sort(refs);
+		refs.erase(ranges::unique(refs).begin(), refs.end());
+		auto node = source.nodes.begin();
+		for(const int64_t ref : refs) {
+			while(node != source.nodes.end() && node->first < ref) ++ node;
+			if(node != source.nodes.end() && node->first == ref) nodes(ref)[ref] = node->second;
+		}
+	};
+	vector<TmpRef> wayRefs(source.ways.size());
+	const auto addLayers = [&](const array<bool, size(wayLayers)> &layers) {
+		const auto inLayers = [&](const SourceIndex::Way &w) { return w.layer != Rules::NONE && layers[w.layer]; };
+		addNodes(inLayers);
+		for(size_t i = 0; i < source.ways.size(); ++i)
+			if(inLayers(source.ways[i])) wayRefs[i] = addLayerWay(tmpData, source.ways[i].layer, source.ways[i].refs);
+	};
+	addLayers(plan.rebuilt);
+	// Polylines are ordered along a Hilbert curve in the box of all the layers, if it changes all are ordered again
+	if(!ranges::all_of(plan.rebuilt, identity{})) {
+		Box<vec2i> former, box;
+		for(uint32_t l = 0; l < size(wayLayers); ++l) {
+			const pair<uint32_t, uint32_t> p = layerPolylines(plan.former, l);
+			for(uint64_t j = plan.former.roadOffsets[p.first]; j < plan.former.roadOffsets[p.second]; ++j) {
+				former.update(plan.former.roads[j]);
+				if(!plan.rebuilt[l]) box.update(plan.former.roads[j]);
+			}
+			if(plan.rebuilt[l]) for(const vec2i &q : wayLayer(tmpData, l).data) box.update(q);
+		}
+		if(!(box.min == former.min) || !(box.max == former.max)) {
+			cout << "The box of the polylines changes, all layers are made again" << endl;
+			array<bool, size(wayLayers)> others;
+			for(uint32_t l = 0; l < size(wayLayers); ++l) others[l] = !plan.rebuilt[l];
+			plan.rebuilt.fill(true);
+			addLayers(others);
+		}
+	}
+	addNodes([](const SourceIndex::Way &w) { return ranges::binary_search(neededWays, w.id); });
+	vector<int64_t> deltas;
+	for(size_t i = 0; i < source.ways.size(); ++i) {
+		const SourceIndex::Way &w = source.ways[i];
+		if(!ranges::binary_search(neededWays, w.id)) continue;
+		deltas.resize(w.refs.size());
+		adjacent_difference(w.refs.begin(), w.refs.end(), deltas.begin());
+		keepWay(w.id, deltas, wayRefs[i]);
+	}
+	for(const Proto::Relation &r : source.relations) readRelation(r, relationTable, data, multipolygons);
+	// Multipolygons are only assembled again with the areas
+	if(!plan.rebuilt[FOREST_LAYER]) multipolygons.clear();
+	cout << "Source index: " << source.nodes.size() << " nodes, " << source.capitals.size() << " capitals, "
+		<< source.ways.size() << " ways, " << source.relations.size() << " relations" << endl;
+	cout << "Layers made again:";
+	for(uint32_t l = 0; l < size(wayLayers); ++l) if(plan.rebuilt[l]) cout << ' ' << wayLayers[l];
+	cout << ", kept from the former output:";
+	for(uint32_t l = 0; l < size(wayLayers); ++l) if(!plan.rebuilt[l]) cout << ' ' << wayLayers[l];
+	cout << endl;
+	endPhase("update");
+}
+
+// Copy of a PrimitiveBlock with only what the conversion uses and its own string table: dense nodes in the
+// sorted `keptNodes` or capitals, ways of the layers or needed by relations, and relations producing output.
+// Metadata is dropped. The refs of the kept ways are added to `refs`.
+static Proto::PrimitiveBlock filterBlock(const Proto::PrimitiveBlock &pb, const vector<int64_t> &keptNodes, vector<int64_t> &refs) {
+	Proto::PrimitiveBlock out;
+	out.granularity = pb.granularity;
+	out._has_granularity = pb._has_granularity;
+	out.lat_offset = pb.lat_offset;
+	out._has_lat_offset = pb._has_lat_offset;
+	out.lon_offset = pb.lon_offset;
+	out._has_lon_offset = pb._has_lon_offset;
+	out.date_granularity = pb.date_granularity;
+	out._has_date_granularity = pb._has_date_granularity;
+	vector<uint32_t> strings(pb.stringtable.s.size(), Rules::NONE);
+	const auto str = [&](const uint32_t s) {
+		if(s >= strings.size()) THROW_ERROR("String index out of the string table");
+		if(strings[s] == Rules::NONE) {
+			strings[s] = out.stringtable.s.size();
+			out.stringtable.s.push_back(pb.stringtable.s[s]);
+		}
+		return strings[s];
+	};
+	// The first string, empty, delimits the tags of dense nodes
+	if(!strings.empty()) str(0);
+
+	const TagTable table(pb.stringtable.s);
+	const Rules::Block rulesBlock = wayRules->classify(table);
+	for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
+		Proto::PrimitiveGroup group;
+		if(pg._has_dense) {
+			const Proto::DenseNodes &dense = pg.dense;
+			const size_t N = dense.id.size();
+			if(N != dense.lat.size() || N != dense.lon.size()) THROW_ERROR("Sizes mismatch in denseNodes...");
+			Proto::DenseNodes &kept = group.dense;
+			// Tags are only read if the block has the keys needed to produce a capital
+			const bool readTags = table.has(TagKey::PLACE) && table.has(TagKey::CAPITAL);
+			auto kv_it = dense.keys_vals.begin();
+			int64_t id = 0, lat = 0, lon = 0, keptId = 0, keptLat = 0, keptLon = 0;
+			bool tagged = false;
+			for(size_t i = 0; i < N; ++i) {
+				id += dense.id[i];
+				lat += dense.lat[i];
+				lon += dense.lon[i];
+				const auto tagsBegin = kv_it;
+				NodeTags tags;
+				if(!dense.keys_vals.empty()) {
+					if(kv_it == dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+					for(; *kv_it; kv_it += 2) {
+						if(dense.keys_vals.end() - kv_it < 3) THROW_ERROR("Sizes mismatch in denseNodes...");
+						if(readTags) tags.readTag(table, kv_it[0], kv_it[1]);
+					}
+					++ kv_it;
+				}
+				const bool capital = tags.place == Place::CITY && tags.capital >= 0 && tags.capital <= 6;
+				if(!capital && !ranges::binary_search(keptNodes, id)) continue;
+				kept.id.push_back(id - keptId);
+				kept.lat.push_back(lat - keptLat);
+				kept.lon.push_back(lon - keptLon);
+				keptId = id;
+				keptLat = lat;
+				keptLon = lon;
+				if(capital) {
+					for(auto it = tagsBegin; *it; ++it) kept.keys_vals.push_back(str(*it));
+					tagged = true;
+				}
+				kept.keys_vals.push_back(0);
+			}
+			if(!dense.keys_vals.empty() && kv_it != dense.keys_vals.end()) THROW_ERROR("Sizes mismatch in denseNodes...");
+			if(!tagged) kept.keys_vals.clear();
+			group._has_dense = !kept.id.empty();
+		}
+		for(const Proto::Way &way : pg.ways) {
+			if(way.keys.size() != way.vals.size()) THROW_ERROR("Sizes mismatch in way's tags...");
+			const bool inLayer = rulesBlock.mayMatch && wayRules->match(rulesBlock, way.keys, way.vals) != Rules::NONE;
+			if(!inLayer && !ranges::binary_search(neededWays, way.id)) continue;
+			Proto::Way &w = group.ways.emplace_back();
+			w.id = way.id;
+			w.keys.insert_range(w.keys.end(), way.keys | views::transform(str));
+			w.vals.insert_range(w.vals.end(), way.vals | views::transform(str));
+			w.refs = way.refs;
+			int64_t ref = 0;
+			for(const int64_t delta : way.refs) refs.push_back(ref += delta);
+		}
+		for(const Proto::Relation &relation : pg.relations) {
+			const RelationTags tags = readRelationTags(relation, table);
+			if(!isFRRoute(tags) && !isForestMultipolygon(tags)) continue;
+			Proto::Relation &r = group.relations.emplace_back();
+			r.id = relation.id;
+			r.keys.insert_range(r.keys.end(), relation.keys | views::transform(str));
+			r.vals.insert_range(r.vals.end(), relation.vals | views::transform(str));
+			r.roles_sid.insert_range(r.roles_sid.end(), relation.roles_sid | views::transform(str));
+			r.memids = relation.memids;
+			r.types = relation.types;
+		}
+		if(group._has_dense || !group.ways.empty() || !group.relations.empty())
+			out.primitivegroup.push_back(std::move(group));
+	}
+	return out;
+}
+
+// Write a PBF with only what the conversion uses of the input, so that conversions with the same rules can read
+// a fraction of it. Blobs keep their order, so that a sorted file stays sorted. It needs the ways needed by relations.
+static void writeFilteredPBF(const char *inputFile, const char *outputFile, const uint32_t threads) {
+	BinStream input(inputFile);
+	vector<BlobInfo> blobs = indexBlobs(input);
+	vector<uint8_t> wire, blobData;
+	readBlob(input, blobs[0], wire, blobData);
+	Proto::HeaderBlock header(blobData);
+	const bool sorted = ranges::count(header.optional_features, "Sort.Type_then_ID") > 0;
+	header.writingprogram = "osm-viewer converter, filtered";
+	header._has_writingprogram = true;
+	vector<uint8_t> headerData;
+	header.write(headerData);
+
+	// In a sorted file, blobs before the first one with ways or relations only have nodes
+	uint32_t firstWays = 1;
+	if(sorted) {
+		uint32_t a = 1, b = blobs.size();
+		while(a < b) {
+			const uint32_t m = (a + b) / 2;
+			readBlob(input, blobs[m], wire, blobData);
+			blobs[m].groups = scanGroups(blobData);
+			if(blobs[m].groups & (BlobInfo::WAYS | BlobInfo::RELATIONS)) b = m;
+			else a = m+1;
+		}
+		firstWays = a;
+	}
+	input.close();
+
+	deque<BinStream> inputs;
+	for(uint32_t t = 0; t < threads; ++t) inputs.emplace_back(inputFile);
+	vector<vector<uint8_t>> wires(threads), blobsData(threads);
+	vector<vector<uint8_t>> encoded(blobs.size());
+	atomic<size_t> keptNodes = 0, keptWays = 0, keptRelations = 0;
+	const auto encode = [&](const Proto::PrimitiveBlock &pb, const uint32_t i) {
+		if(pb.primitivegroup.empty()) return;
+		for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
+			keptNodes += pg.dense.id.size();
+			keptWays += pg.ways.size();
+			keptRelations += pg.relations.size();
+		}
+		vector<uint8_t> data;
+		pb.write(data);
+		encoded[i] = encodeBlob("OSMData", data);
+	};
+
+	// Ways and relations first, the nodes to keep are those of the kept ways.
+	// Blobs with nodes are filtered again once they are known.
+	vector<vector<int64_t>> blobRefs(blobs.size());
+	parallelFor(blobs.size(), threads, [&](const uint32_t i, const uint32_t t) {
+		BlobInfo &blob = blobs[i];
+		if(blob.type != BlobInfo::DATA || i < firstWays) return;
+		readBlob(inputs[t], blob, wires[t], blobsData[t]);
+		blob.groups = scanGroups(blobsData[t]);
+		if(!(blob.groups & (BlobInfo::WAYS | BlobInfo::RELATIONS))) return;
+		const Proto::PrimitiveBlock out = filterBlock(Proto::PrimitiveBlock(blobsData[t]), {}, blobRefs[i]);
+		if(!(blob.groups & BlobInfo::DENSE)) encode(out, i);
+	});
+	vector<int64_t> refs;
+	for(vector<int64_t> &r : blobRefs) {
+		refs.insert(refs.end(), r.begin(), r.end());
+		r = {};
+	}
+	ranges::sort(refs);
+	refs.erase(ranges::unique(refs).begin(), refs.end());
+
+	parallelFor(blobs.size(), threads, [&](const uint32_t i, const uint32_t t) {
+		const BlobInfo &blob = blobs[i];
+		if(blob.type != BlobInfo::DATA || (i >= firstWays && !(blob.groups & BlobInfo::DENSE))) return;
+		readBlob(inputs[t], blob, wires[t], blobsData[t]);
+		vector<int64_t> wayRefs;
+		encode(filterBlock(Proto::PrimitiveBlock(blobsData[t]), refs, wayRefs), i);
+	});
+	inputs.clear();
+
+	ofstream out(outputFile, ios::binary);
+	const vector<uint8_t> headerBlob = encodeBlob("OSMHeader", headerData);
+	out.write(reinterpret_cast<const char*>(headerBlob.data()), headerBlob.size());
+	size_t size = headerBlob.size();
+	for(const vector<uint8_t> &blob : encoded) {
+		out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+		size += blob.size();
+	}
+	out.close();
+	if(!out) THROW_ERROR("Failed to write " + string(outputFile));
+	cout << "Filtered PBF: " << keptNodes << " nodes, " << keptWays << " ways and " << keptRelations << " relations in "
+		<< size << " bytes (" << 100. * size / max<uintmax_t>(filesystem::file_size(inputFile), 1) << "% of the input)" << endl;
 }
 
 //////////////
@@ -444,71 +1678,197 @@ static void readRelation(const Proto::Relation &relation, const vector<vector<ui
 //////////////
 
 int main(int argc, const char* argv[]) {
-	if(argc != 3) {
+	const char *inputFile = nullptr, *outputFile = nullptr, *memoryJSON = nullptr, *rulesFile = RULES_DIR "/ways.rules";
+	const char *changeFile = nullptr, *checkFile = nullptr, *filterFile = nullptr, *cacheFile = nullptr;
+	uint32_t threads = max(1u, thread::hardware_concurrency());
+	uint64_t chunkVertices = numeric_limits<uint32_t>::max(), tilePoints = 0;
+	bool printMemory = false, encodePoints = false, indexPoints = false, sourceIndex = false, badArgs = false;
+	for(int i = 1; i < argc; ++i) {
+		const string_view arg = argv[i];
+		if(arg == "-j" && i+1 < argc) threads = max(1, atoi(argv[++i]));
+		else if(arg == "--memory") printMemory = true;
+		else if(arg == "--encode-points") encodePoints = true;
+		else if(arg == "--index-points") indexPoints = true;
+		else if(arg == "--source-index") sourceIndex = true;
+		else if(arg == "--update" && i+1 < argc) changeFile = argv[++i];
+		else if(arg == "--check" && i+1 < argc) checkFile = argv[++i];
+		else if(arg == "--filter-pbf" && i+1 < argc) filterFile = argv[++i];
+		else if(arg == "--cache" && i+1 < argc) cacheFile = argv[++i];
+		else if(arg == "--tile-points" && i+1 < argc) {
+			tilePoints = strtoull(argv[++i], nullptr, 10);
+			if(!tilePoints) badArgs = true;
+		}
+		else if(arg == "--memory-json" && i+1 < argc) memoryJSON = argv[++i];
+		else if(arg == "--rules" && i+1 < argc) rulesFile = argv[++i];
+		else if(arg == "--chunk-vertices" && i+1 < argc) {
+			chunkVertices = strtoull(argv[++i], nullptr, 10);
+			if(!chunkVertices || chunkVertices > numeric_limits<uint32_t>::max()) badArgs = true;
+		}
+		else if(arg.starts_with('-')) badArgs = true;
+		else if(!inputFile) inputFile = argv[i];
+		else if(!outputFile) outputFile = argv[i];
+		else badArgs = true;
+	}
+	// An update rewrites the output given in place of the PBF, with its source index
+	if(changeFile) {
+		if(outputFile || sourceIndex || filterFile || cacheFile) badArgs = true;
+		outputFile = inputFile;
+		inputFile = nullptr;
+	}
+	if(checkFile && (!changeFile || tilePoints)) badArgs = true;
+	if(badArgs || !outputFile) {
 		cerr << "Usage:\n";
-		cerr << ">> " << argv[0] << " `in.osm.pbf` `out.osm.bin`\n";
+		cerr << ">> " << argv[0] << " [-j threads] [--memory] [--memory-json report.json] [--encode-points] [--index-points] [--tile-points n] [--rules ways.rules] [--chunk-vertices n] [--source-index] [--filter-pbf slim.osm.pbf] [--cache entities.cache] `in.osm.pbf` `out.osm.bin`\n";
+		cerr << ">> " << argv[0] << " [options] --update change.osc[.gz] [--check fresh.osm.bin] `out.osm.bin`\n";
+		cerr << "--cache writes the decoded entities of the PBF once, about 10 times its size on disk, and later conversions read them instead of the PBF\n";
 		return 1;
 	}
 
-	BinStream input(argv[1]);
-	uint32_t blobHeaderSize;
-	vector<uint8_t> wire, blobData;
-	bool hasHeader = false;
-
+	if(printMemory || memoryJSON) Memory::enableCounters();
+	const auto startTime = chrono::steady_clock::now();
+	wayRules = make_unique<Rules>(rulesFile, wayLayers);
+	cout << "Loaded " << wayRules->size() << " way rules from " << rulesFile << endl;
 	OSMData data;
 	TmpData tmpData;
+	vector<BlockData> blocks;
 
-	while(input.readInt(blobHeaderSize)) {
-		// Get BlobHeader
-		wire.resize(blobHeaderSize);
-		input.read(reinterpret_cast<char*>(wire.data()), wire.size());
-		const Proto::BlobHeader header(wire);
+	// Memory accounting
+	MemoryReport memReport;
+	const auto endPhase = [&](const string &name) {
+		vector<pair<string, size_t>> containers;
+		size_t nodesBytes = 0, waysBytes = 0;
+		for(const HashMap<vec2i> &shard : nodes.shards) nodesBytes += shard.memory();
+		for(const WayStore &store : ways.shards) waysBytes += store.map.memory() + store.refs.memory();
+		containers.emplace_back("nodes", nodesBytes);
+		containers.emplace_back("ways", waysBytes);
+		containers.emplace_back("neededWays", Memory::bytes(neededWays));
+		size_t blocksBytes = Memory::bytes(blocks);
+		for(const BlockData &block : blocks) {
+			const TmpData &t = block.tmp;
+			for(const TmpRoad &r : t.roads) blocksBytes += r.memory();
+			for(const TmpRoad &r : t.waterWays) blocksBytes += r.memory();
+			blocksBytes += t.boundaries.memory() + t.forests.memory() + Memory::bytes(block.names) + Memory::bytes(block.capitals);
+		}
+		containers.emplace_back("blocks", blocksBytes);
+		for(uint32_t i = 0; i < tmpData.roads.size(); ++i)
+			containers.emplace_back("tmp.roads[" + to_string(i) + "]", tmpData.roads[i].memory());
+		for(uint32_t i = 0; i < tmpData.waterWays.size(); ++i)
+			containers.emplace_back("tmp.waterWays[" + to_string(i) + "]", tmpData.waterWays[i].memory());
+		containers.emplace_back("tmp.boundaries", tmpData.boundaries.memory());
+		containers.emplace_back("tmp.forests", tmpData.forests.memory());
+		containers.emplace_back("tmp.misc", tmpData.misc.memory());
+		containers.emplace_back("tmp.forestsR", tmpData.forestsR.memory());
+		containers.emplace_back("data.roads", Memory::bytes(data.roads));
+		containers.emplace_back("data.roadOffsets", Memory::bytes(data.roadOffsets));
+		containers.emplace_back("data.refs", Memory::bytes(data.refs));
+		containers.emplace_back("data.refOffsets", Memory::bytes(data.refOffsets));
+		containers.emplace_back("data.names", Memory::bytes(data.names));
+		containers.emplace_back("data.capitals", Memory::bytes(data.capitals));
+		containers.emplace_back("data.roadNames", Memory::bytes(data.roadNames));
+		memReport.endPhase(name, std::move(containers));
+	};
 
-		// Get Blob
-		wire.resize(header.datasize);
-		input.read(reinterpret_cast<char*>(wire.data()), wire.size());
-		const Proto::Blob blob(wire);
-		blobData.resize(blob.raw_size);
-		if(blob._data_choice == Proto::Blob::DATA_ZLIB_DATA) {
-			uLongf data_size = blob.raw_size;
-			if(uncompress(blobData.data(), &data_size, blob.data.zlib_data.data(), blob.data.zlib_data.size()) != Z_OK)
-				THROW_ERROR("Failed to uncompress...");
-		} else THROW_ERROR("Uncompression of blob data not implemented " + to_string(blob._data_choice));
-
-		// Read Blob
-		if(header.type == "OSMHeader") {
-			if(hasHeader) THROW_ERROR("multiple OSMHeader...");
-			hasHeader = true;
-			readHeader(blobData, data);
-		} else if(header.type == "OSMData") {
-			if(!hasHeader) THROW_ERROR("OSMData blob before any OSMHeader...");
-			Proto::PrimitiveBlock pb(blobData);
-			if((pb.lat_offset % MIN_GRANULARITY) != 0 || (pb.lon_offset % MIN_GRANULARITY) != 0 || (pb.granularity % MIN_GRANULARITY) != 0)
-				THROW_ERROR("Coordinates should be multiple of " + to_string(MIN_GRANULARITY));
-			pb.lat_offset /= MIN_GRANULARITY;
-			pb.lon_offset /= MIN_GRANULARITY;
-			pb.granularity /= MIN_GRANULARITY;
-			const auto &ST = pb.stringtable.s;
-			for(const Proto::PrimitiveGroup &pg : pb.primitivegroup) {
-				if(!pg.nodes.empty()) THROW_ERROR("Not implemented");
-				if(!pg.changesets.empty()) THROW_ERROR("Not implemented");
-				if(pg._has_dense) readDense(pb, pg.dense, ST, data);
-				for(const Proto::Way &way : pg.ways) readWay(way, ST, tmpData);
-				for(const Proto::Relation &relation : pg.relations) readRelation(relation, ST, data, tmpData);
-			}
-		} else THROW_ERROR("Not recognized blob type: " + header.type);
+	// An update starts from the source index instead of the PBF
+	SourceIndex source;
+	const string sourceFile = string(outputFile) + ".idx";
+	vector<Multipolygon> multipolygons;
+	UpdatePlan plan;
+	if(changeFile) {
+		// Layers the change does not touch are copied from the former output, unless it is made of tiles
+		if(!tilePoints) readFormer(outputFile, plan);
+		source.read(sourceFile.c_str(), size(wayLayers));
+		readUpdate(changeFile, source, plan, data, tmpData, multipolygons, endPhase);
+	} else if(cacheFile) {
+		// The entities are decoded once into the cache, and again only when the PBF changes
+		const auto [size, time] = fileStamp(inputFile);
+		if(!EntityCacheView::matches(cacheFile, size, time)) {
+			writeCache(inputFile, cacheFile, threads);
+			endPhase("cache");
+		} else cout << "Entities read from " << cacheFile << endl;
+		const EntityCacheView cache(cacheFile);
+		readCache(cache, threads, data, tmpData, blocks, multipolygons, sourceIndex ? &source : nullptr, endPhase);
+	} else readPBF(inputFile, threads, data, tmpData, blocks, multipolygons, sourceIndex ? &source : nullptr, endPhase);
+	if(filterFile) {
+		writeFilteredPBF(inputFile, filterFile, threads);
+		endPhase("filter");
 	}
 
-	input.close();
+	// Multipolygons are assembled by batches, to bound the memory held by decoded members,
+	// and added in file order so that the output does not depend on the number of threads
+	const auto multipolygonsStart = chrono::steady_clock::now();
+	const size_t batch = 64 * threads;
+	for(size_t start = 0; start < multipolygons.size(); start += batch) {
+		const uint32_t n = min(batch, multipolygons.size() - start);
+		parallelFor(n, threads, [&](const uint32_t i, const uint32_t) {
+			assembleMultipolygon(multipolygons[start+i]);
+		});
+		for(uint32_t i = 0; i < n; ++i) addMultipolygon(multipolygons[start+i], tmpData.misc, tmpData.forestsR);
+	}
+	cout << "Multipolygons: " << multipolygonStats.count << " assembled in " << multipolygonStats.seconds << "s ("
+		<< chrono::duration<double>(chrono::steady_clock::now() - multipolygonsStart).count() << "s on " << threads << " threads), "
+		<< multipolygonStats.skipped << " ill-formed";
+	if(!multipolygonStats.slowest.empty()) {
+		cout << ", slowest:";
+		for(const auto &[t, id] : multipolygonStats.slowest) cout << ' ' << id << " (" << t << "s)";
+	}
+	cout << endl;
+	endPhase("relations");
+	size_t storedWays = 0, refsMemory = 0;
+	for(const WayStore &store : ways.shards) {
+		storedWays += store.map.size();
+		refsMemory += store.refs.memory();
+	}
+	cout << "Stored ways: " << storedWays << ", node references: " << refsMemory << " bytes";
+	if(storedWays) cout << " (" << double(refsMemory) / storedWays << " bytes per way)";
+	cout << endl;
+
+	// Join the ways of each polyline layer meeting end to end,
+	// except those used by multipolygons that must keep their index
+	cout << "Polylines merged:";
+	for(uint32_t l = 0; l+1 < size(wayLayers); ++l) {
+		if(!plan.rebuilt[l]) continue;
+		TmpRoad &roads = wayLayer(tmpData, l);
+		vector<bool> pinned(roads.off.size()-1, false);
+		for(const TmpRef &ref : tmpData.forestsR.data)
+			if(ref.storage == &roads) pinned[ref.ind] = true;
+		const size_t polylines = roads.off.size()-1, points = roads.data.size();
+		const vector<uint32_t> index = mergePolylines(roads.data, roads.off, pinned);
+		for(TmpRef &ref : tmpData.forestsR.data)
+			if(ref.storage == &roads) ref.ind = index[ref.ind];
+		cout << "\n\t" << wayLayers[l] << ": " << polylines << " -> " << roads.off.size()-1
+			<< " polylines, " << points << " -> " << roads.data.size() << " points";
+	}
+	cout << endl;
+
+	// Order the polylines of each layer along a Hilbert curve, so that those close in space are close in memory
+	{
+		Box<vec2i> bbox;
+		for(uint32_t l = 0; l < size(wayLayers); ++l) {
+			for(const vec2i &p : wayLayer(tmpData, l).data) bbox.update(p);
+			if(plan.rebuilt[l]) continue;
+			const pair<uint32_t, uint32_t> p = layerPolylines(plan.former, l);
+			for(uint64_t j = plan.former.roadOffsets[p.first]; j < plan.former.roadOffsets[p.second]; ++j)
+				bbox.update(plan.former.roads[j]);
+		}
+		for(uint32_t l = 0; l < size(wayLayers); ++l) {
+			if(!plan.rebuilt[l]) continue;
+			TmpRoad &roads = wayLayer(tmpData, l);
+			const vector<uint32_t> index = sortPolylines(roads.data, roads.off, bbox);
+			for(TmpRef &ref : tmpData.forestsR.data)
+				if(ref.storage == &roads) ref.ind = index[ref.ind];
+		}
+	}
+	endPhase("polylines");
 
 	// If no bbox, compute it
 	if(data.bbox.min.x == numeric_limits<int32_t>::max())
-		for(const vec2i &node : nodes | views::values)
-			data.bbox.update(node);
+		for(const HashMap<vec2i> &shard : nodes.shards)
+			for(const vec2i &node : shard | views::values)
+				data.bbox.update(node);
 	
-	// Transfert tmpData ==> data
+	// Transfert tmpData ==> data, the layers an update keeps being copied from the former output
 	const auto addTmpRoads = [&](TmpRoad &roads) {
-		const uint32_t off = data.roads.size();
+		const uint64_t off = data.roads.size();
 		data.roads.insert_range(data.roads.end(), roads.data);
 		roads.data.clear();
 		roads.data.shrink_to_fit();
@@ -516,32 +1876,40 @@ int main(int argc, const char* argv[]) {
 		data.roadOffsets.insert_range(data.roadOffsets.end(),
 			roads.off
 			| views::drop(1)
-			| views::transform([&](const uint32_t o) { return off + o; })
+			| views::transform([&](const uint64_t o) { return off + o; })
 		);
 		roads.off.resize(1);
 		roads.off.shrink_to_fit();
 	};
-	const auto addArrayRoads = [&](auto &off, auto &tmp) {
+	const auto addLayer = [&](const uint32_t layer, TmpRoad &roads) {
+		if(layer < size(wayLayers) ? plan.rebuilt[layer] : plan.rebuilt[FOREST_LAYER]) return addTmpRoads(roads);
+		const OSMData &former = plan.former;
+		const pair<uint32_t, uint32_t> p = layerPolylines(former, layer);
+		const uint64_t off = data.roads.size(), first = former.roadOffsets[p.first];
+		data.roads.insert(data.roads.end(), former.roads.begin() + first, former.roads.begin() + former.roadOffsets[p.second]);
+		for(uint32_t i = p.first; i < p.second; ++i) data.roadOffsets.push_back(off + former.roadOffsets[i+1] - first);
+	};
+	const auto addArrayRoads = [&](auto &off, auto &tmp, const uint32_t firstLayer) {
 		off[0] = data.roadOffsets.size()-1;
 		for(uint32_t i = 0; i < tmp.size(); ++i) {
-			addTmpRoads(tmp[i]);
+			addLayer(firstLayer + i, tmp[i]);
 			off[i+1] = data.roadOffsets.size()-1;
 		}
 	};
-	const auto addPairRoads = [&](pair<uint32_t, uint32_t> &off, TmpRoad &tmp) {
+	const auto addPairRoads = [&](pair<uint32_t, uint32_t> &off, TmpRoad &tmp, const uint32_t layer) {
 		off.first = data.roadOffsets.size()-1;
-		addTmpRoads(tmp);
+		addLayer(layer, tmp);
 		off.second = data.roadOffsets.size()-1;
 	};
 	data.roadOffsets.push_back(0);
-	addArrayRoads(data.roadTypeOffsets, tmpData.roads);
-	addArrayRoads(data.waterWayTypeOffsets, tmpData.waterWays);
-	addPairRoads(data.boundaries, tmpData.boundaries);
-	addPairRoads(data.forests, tmpData.forests);
-	addTmpRoads(tmpData.misc);
+	addArrayRoads(data.roadTypeOffsets, tmpData.roads, 0);
+	addArrayRoads(data.waterWayTypeOffsets, tmpData.waterWays, (uint32_t) RoadType::NUM);
+	addPairRoads(data.boundaries, tmpData.boundaries, FOREST_LAYER - 1);
+	addPairRoads(data.forests, tmpData.forests, FOREST_LAYER);
+	addLayer(FOREST_LAYER + 1, tmpData.misc);
 
 	const auto addTmpRel = [&](TmpRelation &rel) {
-		const uint32_t off = data.refs.size();
+		const uint64_t off = data.refs.size();
 		data.refs.insert_range(data.refs.end(), rel.data | views::transform([&](const TmpRef &ref)->uint32_t {
 			assert(ref.storage);
 			return ref.storage->off[0] + ref.ind;
@@ -551,18 +1919,179 @@ int main(int argc, const char* argv[]) {
 		data.refOffsets.insert_range(data.refOffsets.end(),
 			rel.off
 			| views::drop(1)
-			| views::transform([&](const uint32_t o) { return off + o; })
+			| views::transform([&](const uint64_t o) { return off + o; })
 		);
 		rel.off.clear();
 		rel.off.shrink_to_fit();
 	};
-	data.refOffsets.push_back(0);
-	data.forestsR.first = data.refOffsets.size()-1;
-	addTmpRel(tmpData.forestsR);
-	data.forestsR.second = data.refOffsets.size()-1;
+	// Kept areas only index kept layers, moved as a whole: polylines and points are found by the first of their layer
+	vector<pair<uint32_t, uint32_t>> formerPolylines;
+	vector<pair<uint64_t, uint64_t>> formerPoints;
+	if(!plan.rebuilt[FOREST_LAYER]) {
+		for(uint32_t l = 0; l <= FOREST_LAYER + 1; ++l) {
+			const uint32_t from = layerPolylines(plan.former, l).first, to = layerPolylines(data, l).first;
+			formerPolylines.emplace_back(from, to);
+			formerPoints.emplace_back(plan.former.roadOffsets[from], data.roadOffsets[to]);
+		}
+	}
+	const auto moved = [](const auto &firsts, const auto i) {
+		const auto it = ranges::upper_bound(firsts, i, {}, &remove_cvref_t<decltype(firsts[0])>::first) - 1;
+		return it->second + (i - it->first);
+	};
+	if(plan.rebuilt[FOREST_LAYER]) {
+		data.refOffsets.push_back(0);
+		data.forestsR.first = data.refOffsets.size()-1;
+		addTmpRel(tmpData.forestsR);
+		data.forestsR.second = data.refOffsets.size()-1;
+	} else {
+		data.refs.resize(plan.former.refs.size());
+		ranges::transform(plan.former.refs, data.refs.begin(), [&](const uint32_t i) { return moved(formerPolylines, i); });
+		data.refOffsets = plan.former.refOffsets;
+		data.forestsR = plan.former.forestsR;
+	}
 
-	// Write data
-	data.write(argv[2]);
+	// Chunks of consecutive polylines, whose points are indexed on 32 bits from the first point of their chunk
+	data.roadChunks.assign(1, 0);
+	for(uint32_t i = 0; i+1 < data.roadOffsets.size(); ++i) {
+		if(data.roadOffsets[i+1] - data.roadOffsets[i] > chunkVertices)
+			THROW_ERROR("Polyline of " + to_string(data.roadOffsets[i+1] - data.roadOffsets[i]) + " points, more than --chunk-vertices");
+		if(data.roadOffsets[i+1] - data.roadOffsets[data.roadChunks.back()] > chunkVertices) data.roadChunks.push_back(i);
+	}
+	data.roadChunks.push_back(data.roadOffsets.size()-1);
+	cout << data.roads.size() << " points of polylines in " << data.roadChunks.size()-1 << " chunks" << endl;
+
+	endPhase("transfer");
+
+	// Levels of detail of the polylines, one for each zoom of LOD_ZOOMS: the points that are
+	// within half a pixel of the simplified polylines at that zoom are removed, except the points
+	// where another polyline of the layer ends, so that T-junctions stay joined at every level
+	{
+		const uint32_t P = data.boundaries.second;
+		vector<pair<const char*, pair<uint32_t, uint32_t>>> layers;
+		for(uint32_t l = 0; l < (uint32_t) RoadType::NUM; ++l)
+			layers.emplace_back(wayLayers[l], pair(data.roadTypeOffsets[l], data.roadTypeOffsets[l+1]));
+		for(uint32_t l = 0; l < (uint32_t) WaterWayType::NUM; ++l)
+			layers.emplace_back(wayLayers[(uint32_t) RoadType::NUM + l], pair(data.waterWayTypeOffsets[l], data.waterWayTypeOffsets[l+1]));
+		layers.emplace_back("boundary", data.boundaries);
+		vector<vector<size_t>> points(layers.size());
+		for(uint32_t l = 0; l < layers.size(); ++l)
+			points[l].push_back(data.roadOffsets[layers[l].second.second] - data.roadOffsets[layers[l].second.first]);
+		// Pinned points of polyline i are pinned[pinOffsets[i]..pinOffsets[i+1]), as indices in the polyline
+		vector<uint32_t> pinned;
+		vector<uint64_t> pinOffsets(P+1, 0);
+		{
+			const auto key = [](const vec2i &p) { return uint64_t(uint32_t(p.x)) << 32 | uint32_t(p.y); };
+			vector<unordered_set<uint64_t>> ends(layers.size());
+			for(uint32_t l = 0; l < layers.size(); ++l) {
+				if(!plan.rebuilt[l]) continue;
+				for(uint32_t i = layers[l].second.first; i < layers[l].second.second; ++i) {
+					ends[l].insert(key(data.roads[data.roadOffsets[i]]));
+					ends[l].insert(key(data.roads[data.roadOffsets[i+1]-1]));
+				}
+			}
+			for(uint32_t i = 0; i < P; ++i) {
+				for(uint32_t l = 0; l < layers.size(); ++l) {
+					if(!plan.rebuilt[l] || i < layers[l].second.first || layers[l].second.second <= i) continue;
+					for(uint64_t j = data.roadOffsets[i]+1; j+1 < data.roadOffsets[i+1]; ++j)
+						if(ends[l].count(key(data.roads[j]))) pinned.push_back(j - data.roadOffsets[i]);
+				}
+				pinOffsets[i+1] = pinned.size();
+			}
+		}
+		data.lodTolerances.clear();
+		data.lodRoads.clear();
+		data.lodRoadOffsets.assign(1, 0);
+		for(const uint32_t zoom : LOD_ZOOMS) {
+			const uint32_t tolerance = lodTolerance(zoom);
+			data.lodTolerances.push_back(tolerance);
+			for(uint32_t l = 0; l < layers.size(); ++l) {
+				if(!plan.rebuilt[l]) {
+					// Polylines of the layers an update keeps are simplified as in the former output
+					const OSMData &former = plan.former;
+					const pair<uint32_t, uint32_t> p = layerPolylines(former, l);
+					const uint64_t *const offsets = former.lodRoadOffsets.data() + (data.lodTolerances.size()-1) * former.boundaries.second;
+					const uint64_t off = data.lodRoads.size(), first = offsets[p.first];
+					data.lodRoads.insert(data.lodRoads.end(), former.lodRoads.begin() + first, former.lodRoads.begin() + offsets[p.second]);
+					for(uint32_t i = p.first; i < p.second; ++i) data.lodRoadOffsets.push_back(off + offsets[i+1] - first);
+					continue;
+				}
+				for(uint32_t i = layers[l].second.first; i < layers[l].second.second; ++i) {
+					simplifyPolyline(data.roads.data() + data.roadOffsets[i], data.roadOffsets[i+1] - data.roadOffsets[i],
+						span(pinned).subspan(pinOffsets[i], pinOffsets[i+1] - pinOffsets[i]), tolerance, data.lodRoads);
+					data.lodRoadOffsets.push_back(data.lodRoads.size());
+				}
+			}
+			const uint32_t base = data.lodRoadOffsets.size()-1 - P;
+			for(uint32_t l = 0; l < layers.size(); ++l)
+				points[l].push_back(data.lodRoadOffsets[base + layers[l].second.second] - data.lodRoadOffsets[base + layers[l].second.first]);
+		}
+		cout << pinned.size() << " points of polylines pinned at T-junctions\n";
+		cout << "Levels of detail (points at full detail and zooms";
+		for(const uint32_t zoom : LOD_ZOOMS) cout << ' ' << zoom;
+		cout << "):";
+		for(uint32_t l = 0; l < layers.size(); ++l) {
+			cout << "\n\t" << layers[l].first << ':';
+			for(const size_t n : points[l]) cout << ' ' << n;
+		}
+		cout << endl;
+	}
+	endPhase("levels of detail");
+
+	// Triangulate areas once here rather than at each start of the viewer, or keep those of the former output
+	if(plan.rebuilt[FOREST_LAYER]) triangulateAreas(data, threads);
+	else {
+		const OSMData &former = plan.former;
+		data.forestIndices.resize(former.forestIndices.size());
+		ranges::transform(former.forestIndices, data.forestIndices.begin(), [&](const uint32_t i) { return moved(formerPoints, uint64_t(i)); });
+		data.forestLodCounts = former.forestLodCounts;
+		data.forestLodPoints = former.forestLodPoints;
+		data.forestLodIndices = former.forestLodIndices;
+		data.forestLodOffsets = former.forestLodOffsets;
+		cout << "Areas: " << data.forestIndices.size() / 3 << " triangles kept from the former output" << endl;
+	}
+	plan.former = {};
+	endPhase("areas");
+
+	// Write data, as a quadtree of tiles of at most tilePoints points if asked
+	if(tilePoints) writeTiles(data, outputFile, tilePoints, encodePoints, indexPoints);
+	else {
+		if(indexPoints) {
+			const size_t points = data.roads.size();
+			indexRoads(data);
+			cout << "Indexed polylines: " << points << " -> " << data.roads.size() << " distinct points ("
+				<< 100. * data.roads.size() / max<size_t>(points, 1) << "%)" << endl;
+		}
+		data.write(outputFile, encodePoints);
+	}
+	if(sourceIndex || changeFile) {
+		source.write(sourceFile.c_str());
+		cout << "Source index written to " << sourceFile << endl;
+	}
+	endPhase("write");
+	if(checkFile) {
+		OSMData fresh;
+		fresh.read(checkFile);
+		ostringstream updated, expected;
+		data.write(updated);
+		fresh.write(expected);
+		const bool same = updated.view() == expected.view();
+		cout << "The update is " << (same ? "identical to " : "different from ") << checkFile << endl;
+		if(!same) return 1;
+	}
+	if(printMemory) {
+		memReport.print(cout);
+		HashMap<vec2i>::Stats nodesStats;
+		for(const HashMap<vec2i> &shard : nodes.shards) nodesStats += shard.stats();
+		printStats<vec2i>("Nodes", nodesStats);
+		HashMap<Way>::Stats waysStats;
+		for(const WayStore &store : ways.shards) waysStats += store.map.stats();
+		printStats<Way>("Ways", waysStats);
+	}
+	if(memoryJSON) {
+		ofstream json(memoryJSON);
+		memReport.writeJSON(json);
+	}
+	cout << "Conversion done in " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s" << endl;
 	
 	return 0;
 }
\ No newline at end of file
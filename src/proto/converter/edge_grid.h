@@ -0,0 +1,69 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "vec.h"
+
+// Outer boundary of a component materialised for point in polygon tests:
+// its bounding box, and its edges indexed by horizontal bands of the box
+struct EdgeGrid {
+	Box<vec2i> bbox;
+	int64_t bandHeight = 1;
+	std::vector<uint32_t> offsets; // edges crossing band b are edges[offsets[b]..offsets[b+1])
+	std::vector<std::pair<vec2i, vec2i>> edges; // lowest extremity first
+
+	template<typename Polylines>
+	EdgeGrid(const Polylines &polylines) {
+		std::vector<std::pair<vec2i, vec2i>> all;
+		for(const std::vector<vec2i> &pts : polylines) {
+			for(uint32_t i = 1; i < pts.size(); ++i) {
+				vec2i a = pts[i-1], b = pts[i];
+				bbox.update(a);
+				bbox.update(b);
+				if(a.y > b.y) std::swap(a, b);
+				// Horizontal edges never cross the half-open range of a point
+				if(a.y < b.y) all.emplace_back(a, b);
+			}
+		}
+		const uint32_t B = std::max<size_t>(1, all.size() / 4);
+		bandHeight = (int64_t(bbox.max.y) - bbox.min.y) / B + 1;
+		offsets.assign(B+1, 0);
+		for(const auto &[a, b] : all)
+			for(uint32_t k = band(a.y); k <= band(b.y-1); ++k) ++ offsets[k+1];
+		for(uint32_t k = 0; k < B; ++k) offsets[k+1] += offsets[k];
+		edges.resize(offsets[B]);
+		std::vector<uint32_t> pos(offsets.begin(), offsets.end()-1);
+		for(const auto &e : all)
+			for(uint32_t k = band(e.first.y); k <= band(e.second.y-1); ++k) edges[pos[k]++] = e;
+	}
+
+	inline uint32_t band(const int32_t y) const {
+		return (int64_t(y) - bbox.min.y) / bandHeight;
+	}
+
+	enum Location { OUTSIDE, INSIDE, ON_EDGE };
+	// Each edge spans the half-open range [low y, high y) of rows: v is ON_EDGE if it is on an edge whose range
+	// holds v.y, and otherwise INSIDE if an odd number of them are on its left. Points on horizontal edges
+	// or on the top end of an edge are thus located by the other edges.
+	Location locate(const vec2i v) const {
+		if(v.x < bbox.min.x || v.x > bbox.max.x || v.y < bbox.min.y || v.y > bbox.max.y) return OUTSIDE;
+		const uint32_t k = band(v.y);
+		uint32_t winding = 0;
+		for(uint32_t e = offsets[k]; e < offsets[k+1]; ++e) {
+			const auto &[a, b] = edges[e];
+			if(v.y < a.y) continue;
+			if(b.y <= v.y) continue;
+			const int64_t diff = int64_t(v.x-a.x) * (b.y-a.y) - int64_t(b.x-a.x) * (v.y-a.y);
+			if(diff > 0) ++ winding;
+			else if(diff == 0) return ON_EDGE;
+		}
+		return (winding&1) ? INSIDE : OUTSIDE;
+	}
+};
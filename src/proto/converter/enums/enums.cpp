@@ -0,0 +1,218 @@
+#include "enums.h"
+
+#include <charconv>
+
+#include "utils.h"
+
+using namespace std;
+
+static constexpr uint64_t keyHashPilots[] {
+	0ull, // 0
+	5092388815191131783ull, // 8
+	11156705658460211942ull, // 20
+};
+
+static constexpr PerfectHash::Entry keyHashEntries[] {
+	{"capital", 7, (uint32_t) TagKey::CAPITAL},
+	{"waterway", 8, (uint32_t) TagKey::WATERWAY},
+	{"ref:sandre", 10, (uint32_t) TagKey::REF_SANDRE},
+	{"ref", 3, (uint32_t) TagKey::REF},
+	{"type", 4, (uint32_t) TagKey::TYPE},
+	{"place", 5, (uint32_t) TagKey::PLACE},
+	{"network", 7, (uint32_t) TagKey::NETWORK},
+	{"landuse", 7, (uint32_t) TagKey::LANDUSE},
+	{"name", 4, (uint32_t) TagKey::NAME},
+};
+
+static constexpr PerfectHash keyHash {1ull, 1464ull, keyHashPilots, keyHashEntries};
+
+static constexpr uint64_t valueHashPilots[] {
+	12994781566227106604ull, // 1
+	5092388815191131783ull, // 8
+	0ull, // 0
+};
+
+static constexpr PerfectHash::Entry valueHashEntries[] {
+	{"city", 4, 4},
+	{"FR:N-road", 9, 2},
+	{"forest", 6, 0},
+	{"river", 5, 3},
+	{"FR:A-road", 9, 1},
+	{"waterway", 8, 5},
+	{"route", 5, 6},
+	{"multipolygon", 12, 7},
+};
+
+static constexpr PerfectHash valueHash {7ull, 4976ull, valueHashPilots, valueHashEntries};
+
+static constexpr Landuse landuseValues[] {
+	Landuse::FOREST,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+	(Landuse) TagTable::UNDEF,
+};
+
+static constexpr Network networkValues[] {
+	(Network) TagTable::UNDEF,
+	Network::FR_A_ROAD,
+	Network::FR_N_ROAD,
+	(Network) TagTable::UNDEF,
+	(Network) TagTable::UNDEF,
+	(Network) TagTable::UNDEF,
+	(Network) TagTable::UNDEF,
+	(Network) TagTable::UNDEF,
+	(Network) TagTable::UNDEF,
+};
+
+static constexpr Waterway waterwayValues[] {
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+	Waterway::RIVER,
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+	(Waterway) TagTable::UNDEF,
+};
+
+static constexpr Place placeValues[] {
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+	Place::CITY,
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+	(Place) TagTable::UNDEF,
+};
+
+static constexpr RelationType relationTypeValues[] {
+	(RelationType) TagTable::UNDEF,
+	(RelationType) TagTable::UNDEF,
+	(RelationType) TagTable::UNDEF,
+	(RelationType) TagTable::UNDEF,
+	(RelationType) TagTable::UNDEF,
+	RelationType::WATERWAY,
+	RelationType::ROUTE,
+	RelationType::MULTIPOLYGON,
+	(RelationType) TagTable::UNDEF,
+};
+
+TagTable::TagTable(const vector<vector<uint8_t>> &ST): TagTable([&]() {
+	vector<string_view> strings;
+	strings.reserve(ST.size());
+	for(const vector<uint8_t> &s : ST) strings.emplace_back(reinterpret_cast<const char*>(s.data()), s.size());
+	return strings;
+}()) {}
+
+TagTable::TagTable(vector<string_view> S): strings(std::move(S)), entries(strings.size()) {
+	for(size_t i = 0; i < strings.size(); ++i) {
+		const string_view s = strings[i];
+		Entry &e = entries[i];
+		e.key = (TagKey) keyHash.feed(s);
+		if(e.key != (TagKey) UNDEF) keys.set((size_t) e.key);
+		const uint32_t v = valueHash.feed(s);
+		if(v != PerfectHash::NOT_FOUND) e.value = v;
+		e.isNumber = from_chars(s.begin(), s.end(), e.number).ec == errc();
+	}
+}
+
+void NodeTags::readTag(const TagTable &table, uint32_t key, uint32_t val) {
+	switch(table.entries[key].key) {
+	using enum TagKey;
+	case PLACE:
+		place = placeValues[table.entries[val].value];
+		break;
+	case NAME:
+		name = table.strings[val];
+		break;
+	case CAPITAL:
+		if(!table.entries[val].isNumber)
+			THROW_ERROR("capital is not a number: " + string(table.strings[val]));
+		capital = table.entries[val].number;
+		break;
+	default:
+		break;
+	}
+}
+
+void decltype(RelationTags{}.waterway)::readTag(const TagTable &table, uint32_t key, uint32_t val) {
+	switch(table.entries[key].key) {
+	using enum TagKey;
+	case WATERWAY:
+		waterway = waterwayValues[table.entries[val].value];
+		break;
+	case REF_SANDRE:
+		ref_sandre = table.strings[val];
+		break;
+	default:
+		break;
+	}
+}
+
+void decltype(RelationTags{}.route)::readTag(const TagTable &table, uint32_t key, uint32_t val) {
+	switch(table.entries[key].key) {
+	using enum TagKey;
+	case NETWORK:
+		network = networkValues[table.entries[val].value];
+		break;
+	case REF:
+		ref = table.strings[val];
+		break;
+	default:
+		break;
+	}
+}
+
+void decltype(RelationTags{}.multipolygon)::readTag(const TagTable &table, uint32_t key, uint32_t val) {
+	switch(table.entries[key].key) {
+	using enum TagKey;
+	case LANDUSE:
+		landuse = landuseValues[table.entries[val].value];
+		break;
+	default:
+		break;
+	}
+}
+
+void RelationTags::init() {
+	switch(type) {
+	using enum RelationType;
+	case WATERWAY:
+		new(&waterway) decltype(waterway)();
+		break;
+	case ROUTE:
+		new(&route) decltype(route)();
+		break;
+	case MULTIPOLYGON:
+		new(&multipolygon) decltype(multipolygon)();
+		break;
+	default:
+		break;
+	}
+}
+
+void RelationTags::readType(const TagTable &table, uint32_t val) {
+	type = relationTypeValues[table.entries[val].value];
+}
+
+void RelationTags::readTag(const TagTable &table, uint32_t key, uint32_t val) {
+	switch(type) {
+	using enum RelationType;
+	case WATERWAY:
+		waterway.readTag(table, key, val);		break;
+	case ROUTE:
+		route.readTag(table, key, val);		break;
+	case MULTIPOLYGON:
+		multipolygon.readTag(table, key, val);		break;
+	default:
+		break;
+	}
+}
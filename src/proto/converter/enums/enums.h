@@ -0,0 +1,97 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "converter/perfect_hash.h"
+
+enum class Landuse : uint32_t {
+	FOREST,
+};
+
+enum class Network : uint32_t {
+	FR_A_ROAD,
+	FR_N_ROAD,
+};
+
+enum class Waterway : uint32_t {
+	RIVER,
+};
+
+enum class Place : uint32_t {
+	CITY,
+};
+
+enum class RelationType : uint32_t {
+	WATERWAY,
+	ROUTE,
+	MULTIPOLYGON,
+};
+
+enum class TagKey : uint32_t {
+	PLACE,
+	NAME,
+	CAPITAL,
+	TYPE,
+	WATERWAY,
+	REF_SANDRE,
+	NETWORK,
+	REF,
+	LANDUSE,
+};
+
+// Strings of a PrimitiveBlock classified once, so that tags are then read with integer lookups
+struct TagTable {
+	static inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;
+	// Number of known values, used as the value of unknown strings
+	static inline constexpr uint32_t VALUES = 8;
+	struct Entry {
+		TagKey key = (TagKey) UNDEF;
+		uint32_t value = VALUES;
+		int number = 0;
+		bool isNumber = false;
+	};
+	std::vector<std::string_view> strings;
+	std::vector<Entry> entries;
+	// Known keys found in the strings, a block without some key cannot have tags with it
+	std::bitset<9> keys;
+
+	TagTable(const std::vector<std::vector<uint8_t>> &ST);
+	TagTable(std::vector<std::string_view> strings);
+	bool has(const TagKey key) const { return keys[(size_t) key]; }
+};
+
+struct NodeTags {
+	static inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;
+	Place place = (Place) UNDEF;
+	std::string_view name;
+	int capital = -1;
+	void readTag(const TagTable &table, uint32_t key, uint32_t val);
+};
+
+struct RelationTags {
+	static inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;
+	RelationType type = (RelationType) UNDEF;
+	union {
+		struct { // waterway
+			Waterway waterway = (Waterway) UNDEF;
+			std::string_view ref_sandre;
+			void readTag(const TagTable &table, uint32_t key, uint32_t val);
+		} waterway;
+		struct { // route
+			Network network = (Network) UNDEF;
+			std::string_view ref;
+			void readTag(const TagTable &table, uint32_t key, uint32_t val);
+		} route;
+		struct { // multipolygon
+			Landuse landuse = (Landuse) UNDEF;
+			void readTag(const TagTable &table, uint32_t key, uint32_t val);
+		} multipolygon;
+	};
+	RelationTags() {};
+	void init();
+	void readType(const TagTable &table, uint32_t val);
+	void readTag(const TagTable &table, uint32_t key, uint32_t val);
+};
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 // See <https://www.gnu.org/licenses/>
 
+#include <algorithm>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
@@ -10,16 +11,15 @@
 #include <unordered_map>
 #include <vector>
 
+#include "../perfect_hash.h"
+
 using namespace std;
 
 const vector<const char*>
 	int_t,
 	place {"city"},
-	highway {"motorway", "trunk", "primary"},
 	waterway {"river"},
-	boundary {"administrative"},
 	landuse {"forest"},
-	natural {"wood"},
 	network {"FR:A-road", "FR:N-road"};
 
 using Key = pair<const char*, const vector<const char*>*>;
@@ -30,14 +30,7 @@ Key nodeKeys[] {
 	{"capital", &int_t},
 };
 
-Key wayKeys[] {
-	{"highway", &highway},
-	{"waterway", &waterway},
-	{"boundary", &boundary},
-	{"admin_level", &int_t},
-	{"landuse", &landuse},
-	{"natural", &natural},
-};
+// Ways are classified by the rules of `rules/ways.rules`, read by the converter at start
 
 pair<const char*, vector<Key>> relationKeys[] {
 	{"waterway", {
@@ -69,18 +62,37 @@ int main(int argc, char* argv[]) {
 			it->second = k.first;
 	};
 	for(const Key &k : nodeKeys) searchKey(k);
-	for(const Key &k : wayKeys) searchKey(k);
 	for(const vector<Key> &ks : relationKeys | views::values)
 		for(const Key &k : ks) searchKey(k);
-	
+
+	// All keys and enum values, each string once, for the classification of string tables
+	vector<const char*> allKeys, allValues;
+	const auto addString = [](vector<const char*> &strings, const char* s) {
+		if(ranges::none_of(strings, [&](const char* t) { return !strcmp(s, t); }))
+			strings.push_back(s);
+	};
+	for(const char *k : nodeKeys | views::keys) addString(allKeys, k);
+	addString(allKeys, "type");
+	for(const vector<Key> &ks : relationKeys | views::values)
+		for(const char *k : ks | views::keys) addString(allKeys, k);
+	for(const auto &[values, name] : enumNames) {
+		if(!values || values == &int_t) continue;
+		for(const char *v : *values) addString(allValues, v);
+	}
+	for(const char *v : relationKeys | views::keys) addString(allValues, v);
+	const auto valueIndex = [&](const char* v) {
+		return ranges::find_if(allValues, [&](const char* t) { return !strcmp(v, t); }) - allValues.begin();
+	};
 
 	ofstream Hfile(outputDir / "enums.h");
 	Hfile << R"lim(#pragma once
 
+#include <bitset>
 #include <cstdint>
 #include <string_view>
+#include <vector>
 
-#include "converter/string_switch.h"
+#include "converter/perfect_hash.h"
 )lim";
 	const auto toClass = [&](const char* v) {
 		string s = v;
@@ -113,6 +125,32 @@ int main(int argc, char* argv[]) {
 	for(const char *v : relationKeys | views::keys)
 		Hfile << "\t" << toENUM(v) << ",\n";
 	Hfile << "};\n";
+	Hfile << "\nenum class TagKey : uint32_t {\n";
+	for(const char *k : allKeys)
+		Hfile << "\t" << toENUM(k) << ",\n";
+	Hfile << "};\n";
+	Hfile << R"lim(
+// Strings of a PrimitiveBlock classified once, so that tags are then read with integer lookups
+struct TagTable {
+	static inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;
+	// Number of known values, used as the value of unknown strings
+	static inline constexpr uint32_t VALUES = )lim" << allValues.size() << R"lim(;
+	struct Entry {
+		TagKey key = (TagKey) UNDEF;
+		uint32_t value = VALUES;
+		int number = 0;
+		bool isNumber = false;
+	};
+	std::vector<std::string_view> strings;
+	std::vector<Entry> entries;
+	// Known keys found in the strings, a block without some key cannot have tags with it
+	std::bitset<)lim" << allKeys.size() << R"lim(> keys;
+
+	TagTable(const std::vector<std::vector<uint8_t>> &ST);
+	TagTable(std::vector<std::string_view> strings);
+	bool has(const TagKey key) const { return keys[(size_t) key]; }
+};
+)lim";
 	const auto writeTags = [&](const auto &keys, const char* tabs) {
 		for(const auto &[name, t] : keys) {
 			Hfile << tabs;
@@ -124,18 +162,14 @@ int main(int argc, char* argv[]) {
 			else if(t) Hfile << " = (" << toClass(enumNames[t]) << ") UNDEF";
 			Hfile << ";\n";
 		}
-		Hfile << tabs << "void readTag(const std::string_view &key, const std::string_view &val);\n";
+		Hfile << tabs << "void readTag(const TagTable &table, uint32_t key, uint32_t val);\n";
 	};
 	Hfile << "\nstruct NodeTags {\n";
-	Hfile << "\tstatic inline constexpr uint32_t UNDEF = StringSwitch::NOT_FOUND;\n";
+	Hfile << "\tstatic inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;\n";
 	writeTags(nodeKeys, "\t");
 	Hfile << "};\n";
-	Hfile << "\nstruct WayTags {\n";
-	Hfile << "\tstatic inline constexpr uint32_t UNDEF = StringSwitch::NOT_FOUND;\n";
-	writeTags(wayKeys, "\t");
-	Hfile << "};\n";
 	Hfile << "\nstruct RelationTags {\n";
-	Hfile << "\tstatic inline constexpr uint32_t UNDEF = StringSwitch::NOT_FOUND;\n";
+	Hfile << "\tstatic inline constexpr uint32_t UNDEF = PerfectHash::NOT_FOUND;\n";
 	Hfile << "\tRelationType type = (RelationType) UNDEF;\n";
 	Hfile << "\tunion {\n";
 	for(const auto &[rt, ks] : relationKeys) {
@@ -146,8 +180,8 @@ int main(int argc, char* argv[]) {
 	Hfile << "\t};\n";
 	Hfile << "\tRelationTags() {};\n";
 	Hfile << "\tvoid init();\n";
-	Hfile << "\tvoid readType(const std::string_view &val);\n";
-	Hfile << "\tvoid readTag(const std::string_view &key, const std::string_view &val);\n";
+	Hfile << "\tvoid readType(const TagTable &table, uint32_t val);\n";
+	Hfile << "\tvoid readTag(const TagTable &table, uint32_t key, uint32_t val);\n";
 	Hfile << "};\n";
 	Hfile.close();
 
@@ -161,30 +195,75 @@ int main(int argc, char* argv[]) {
 using namespace std;
 )lim";
 
+	const auto writeHash = [&](const string &name, const vector<const char*> &words, const auto &value) {
+		if(words.empty()) {
+			Cfile << "\nstatic constexpr PerfectHash " << name << " {0, 0, {}, {}};\n";
+			return;
+		}
+		const PerfectHashTables t = buildPerfectHash(words);
+		Cfile << "\nstatic constexpr uint64_t " << name << "Pilots[] {\n";
+		for(const uint32_t p : t.pilots)
+			Cfile << "\t" << PerfectHash::mix(p) << "ull, // " << p << "\n";
+		Cfile << "};\n";
+		Cfile << "\nstatic constexpr PerfectHash::Entry " << name << "Entries[] {\n";
+		for(const uint32_t i : t.words)
+			Cfile << "\t{\"" << words[i] << "\", " << strlen(words[i]) << ", " << value(i) << "},\n";
+		Cfile << "};\n";
+		uint64_t sizes = 0;
+		for(const char *w : words) sizes |= PerfectHash::sizeBit(strlen(w));
+		Cfile << "\nstatic constexpr PerfectHash " << name << " {" << t.seed << "ull, " << sizes << "ull, " << name << "Pilots, " << name << "Entries};\n";
+	};
+	writeHash("keyHash", allKeys, [&](uint32_t i) { return "(uint32_t) TagKey::" + toENUM(allKeys[i]); });
+	writeHash("valueHash", allValues, [&](uint32_t i) { return to_string(i); });
+
+	// Tables from the index of a known value to the corresponding enum, the last entry being for unknown values
+	const auto writeValues = [&](const string &table, const string &type, const auto &values) {
+		vector<string> entries(allValues.size() + 1, "(" + type + ") TagTable::UNDEF");
+		for(const char *v : values)
+			entries[valueIndex(v)] = type + "::" + toENUM(v);
+		Cfile << "\nstatic constexpr " << type << " " << table << "[] {\n";
+		for(const string &e : entries)
+			Cfile << "\t" << e << ",\n";
+		Cfile << "};\n";
+	};
 	for(const auto &[values, name] : enumNames) {
 		if(!values || values == &int_t) continue;
-		Cfile << "\nstatic const StringSwitch " << name << "Switch({\n";
-		for(const char *v : *values)
-			Cfile << "\t{\"" << v << "\", (uint32_t) " << toClass(name) << "::" << toENUM(v) << "},\n";
-		Cfile << "});\n";
+		writeValues(string(name) + "Values", toClass(name), *values);
 	}
+	writeValues("relationTypeValues", "RelationType", relationKeys | views::keys);
 
-	Cfile << "\nstatic const StringSwitch relationTypeSwitch({\n";
-	for(const char *v : relationKeys | views::keys)
-		Cfile << "\t{\"" << v << "\", (uint32_t) RelationType::" << toENUM(v) << "},\n";
-	Cfile << "});\n";
+	Cfile << R"lim(
+TagTable::TagTable(const vector<vector<uint8_t>> &ST): TagTable([&]() {
+	vector<string_view> strings;
+	strings.reserve(ST.size());
+	for(const vector<uint8_t> &s : ST) strings.emplace_back(reinterpret_cast<const char*>(s.data()), s.size());
+	return strings;
+}()) {}
+
+TagTable::TagTable(vector<string_view> S): strings(std::move(S)), entries(strings.size()) {
+	for(size_t i = 0; i < strings.size(); ++i) {
+		const string_view s = strings[i];
+		Entry &e = entries[i];
+		e.key = (TagKey) keyHash.feed(s);
+		if(e.key != (TagKey) UNDEF) keys.set((size_t) e.key);
+		const uint32_t v = valueHash.feed(s);
+		if(v != PerfectHash::NOT_FOUND) e.value = v;
+		e.isNumber = from_chars(s.begin(), s.end(), e.number).ec == errc();
+	}
+}
+)lim";
 
 	const auto writeRead = [&](const auto &keys) {
 		for(const auto &[v, t] : keys) {
 			Cfile << "\tcase " << toENUM(v) << ":\n";
 			if(!t) {
-				Cfile << "\t\t" << toMember(v) << " = val;\n";
+				Cfile << "\t\t" << toMember(v) << " = table.strings[val];\n";
 			} else if(t == &int_t) {
-				Cfile << "\t\tif(from_chars(val.begin(), val.end(), " << toMember(v) << ").ec != errc())\n";
-				Cfile << "\t\t\tTHROW_ERROR(\"" << v << " is not a number: \" + string(val));\n";
+				Cfile << "\t\tif(!table.entries[val].isNumber)\n";
+				Cfile << "\t\t\tTHROW_ERROR(\"" << v << " is not a number: \" + string(table.strings[val]));\n";
+				Cfile << "\t\t" << toMember(v) << " = table.entries[val].number;\n";
 			} else {
-				const char* tn = enumNames[t];
-				Cfile << "\t\t" << toMember(v) << " = (" << toClass(tn) << ") " << tn << "Switch.feed(val);\n";
+				Cfile << "\t\t" << toMember(v) << " = " << enumNames[t] << "Values[table.entries[val].value];\n";
 			}
 			Cfile << "\t\tbreak;\n";
 		}
@@ -194,44 +273,15 @@ using namespace std;
 		Cfile << "}\n";
 	};
 
-	Cfile << "\nenum class NodeKey : uint32_t {\n";
-	for(const char *v : nodeKeys | views::keys)
-		Cfile << "\t" << toENUM(v) << ",\n";
-	Cfile << "};\n";
-	Cfile << "\nstatic const StringSwitch nodeKeySwitch({\n";
-	for(const char *v : nodeKeys | views::keys)
-		Cfile << "\t{\"" << v << "\", (uint32_t) NodeKey::" << toENUM(v) << "},\n";
-	Cfile << "});\n";
-	Cfile << "\nvoid NodeTags::readTag(const string_view &key, const string_view &val) {\n";
-	Cfile << "\tswitch((NodeKey) nodeKeySwitch.feed(key)) {\n";
-	Cfile << "\tusing enum NodeKey;\n";
+	Cfile << "\nvoid NodeTags::readTag(const TagTable &table, uint32_t key, uint32_t val) {\n";
+	Cfile << "\tswitch(table.entries[key].key) {\n";
+	Cfile << "\tusing enum TagKey;\n";
 	writeRead(nodeKeys);
 
-	Cfile << "\nenum class WayKey : uint32_t {\n";
-	for(const char *v : wayKeys | views::keys)
-		Cfile << "\t" << toENUM(v) << ",\n";
-	Cfile << "};\n";
-	Cfile << "\nstatic const StringSwitch wayKeySwitch({\n";
-	for(const char *v : wayKeys | views::keys)
-		Cfile << "\t{\"" << v << "\", (uint32_t) WayKey::" << toENUM(v) << "},\n";
-	Cfile << "});\n";
-	Cfile << "\nvoid WayTags::readTag(const string_view &key, const string_view &val) {\n";
-	Cfile << "\tswitch((WayKey) wayKeySwitch.feed(key)) {\n";
-	Cfile << "\tusing enum WayKey;\n";
-	writeRead(wayKeys);
-
 	for(const auto &[rt, ks] : relationKeys) {
-		Cfile << "\nenum class " << toClass(rt) << "Key : uint32_t {\n";
-		for(const char *v : ks | views::keys)
-			Cfile << "\t" << toENUM(v) << ",\n";
-		Cfile << "};\n";
-		Cfile << "\nstatic const StringSwitch " << rt << "KeySwitch({\n";
-		for(const char *v : ks | views::keys)
-			Cfile << "\t{\"" << v << "\", (uint32_t) " << toClass(rt) << "Key::" << toENUM(v) << "},\n";
-		Cfile << "});\n";
-		Cfile << "\nvoid decltype(RelationTags{}." << rt << ")::readTag(const string_view &key, const string_view &val) {\n";
-		Cfile << "\tswitch((" << toClass(rt) << "Key) " << rt << "KeySwitch.feed(key)) {\n";
-		Cfile << "\tusing enum " << toClass(rt) << "Key;\n";
+		Cfile << "\nvoid decltype(RelationTags{}." << rt << ")::readTag(const TagTable &table, uint32_t key, uint32_t val) {\n";
+		Cfile << "\tswitch(table.entries[key].key) {\n";
+		Cfile << "\tusing enum TagKey;\n";
 		writeRead(ks);
 	}
 
@@ -248,16 +298,16 @@ using namespace std;
 	Cfile << "\t}\n";
 	Cfile << "}\n";
 
-	Cfile << "\nvoid RelationTags::readType(const string_view &val) {\n";
-	Cfile << "\ttype = (RelationType) relationTypeSwitch.feed(val);\n";
+	Cfile << "\nvoid RelationTags::readType(const TagTable &table, uint32_t val) {\n";
+	Cfile << "\ttype = relationTypeValues[table.entries[val].value];\n";
 	Cfile << "}\n";
 
-	Cfile << "\nvoid RelationTags::readTag(const string_view &key, const string_view &val) {\n";
+	Cfile << "\nvoid RelationTags::readTag(const TagTable &table, uint32_t key, uint32_t val) {\n";
 	Cfile << "\tswitch(type) {\n";
 	Cfile << "\tusing enum RelationType;\n";
 	for(const char *v : relationKeys | views::keys) {
 		Cfile << "\tcase " << toENUM(v) << ":\n";
-		Cfile << "\t\t" << toMember(v) << ".readTag(key, val);";
+		Cfile << "\t\t" << toMember(v) << ".readTag(table, key, val);";
 		Cfile << "\t\tbreak;\n";
 	}
 	Cfile << "\tdefault:\n";
@@ -5,8 +5,9 @@
 #pragma once
 
 #include <algorithm>
-#include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
@@ -49,12 +50,14 @@ protected:
 
 	std::vector<int> buckets;
 	std::vector<Node> v;
+	uint32_t rehashes = 0;
+	double rehashSeconds = 0.;
 
 	inline int key(int64_t id) const {
 		return id % buckets.size();
 	}
 
-	Node* _find(const int64_t id) {
+	const Node* _find(const int64_t id) const {
 		if(buckets.empty()) return v.data() + v.size();
 		int b = key(id);
 		for(int i = buckets[b]; i != -1; i = v[i].nxt)
@@ -71,7 +74,7 @@ public:
 	const_iterator begin() const { return v.data(); }
 	const_iterator end() const { return v.data() + v.size(); }
 
-	iterator find(const int64_t id) { return _find(id); }
+	iterator find(const int64_t id) { return const_cast<Node*>(_find(id)); }
 	const_iterator find(const int64_t id) const { return _find(id); }
 
 	T& operator[](const int64_t id) {
@@ -97,18 +100,66 @@ public:
 		return v.size();
 	}
 
+	size_t memory() const {
+		return buckets.capacity() * sizeof(int) + v.capacity() * sizeof(Node);
+	}
+
+	// Make room for n elements without any further rehash
+	void reserve(const size_t n) {
+		if(n > buckets.size()) rehash(nextSize(n));
+		v.reserve(n);
+	}
+
+	struct Stats {
+		size_t size = 0, buckets = 0, bytes = 0;
+		uint32_t rehashes = 0;
+		double rehashSeconds = 0.;
+		// chains[l] is the number of buckets with a chain of length l
+		std::vector<size_t> chains;
+
+		double loadFactor() const { return buckets ? double(size) / buckets : 0.; }
+		Stats& operator+=(const Stats &other) {
+			size += other.size;
+			buckets += other.buckets;
+			bytes += other.bytes;
+			rehashes += other.rehashes;
+			rehashSeconds += other.rehashSeconds;
+			if(chains.size() < other.chains.size()) chains.resize(other.chains.size());
+			for(size_t l = 0; l < other.chains.size(); ++l) chains[l] += other.chains[l];
+			return *this;
+		}
+	};
+
+	Stats stats() const {
+		Stats s;
+		s.size = v.size();
+		s.buckets = buckets.size();
+		s.bytes = memory();
+		s.rehashes = rehashes;
+		s.rehashSeconds = rehashSeconds;
+		for(int b : buckets) {
+			size_t l = 0;
+			for(; b != -1; b = v[b].nxt) ++ l;
+			if(l >= s.chains.size()) s.chains.resize(l+1);
+			++ s.chains[l];
+		}
+		return s;
+	}
+
 protected:
 	static constexpr size_t primes[] = {7, 17, 37, 79, 163, 331, 673, 1361, 2729, 5471, 10949, 21911,
 										43853, 87719, 175447, 350899, 701819, 1403641, 2807303, 5614657,
-										11229331, 22458671, 44917381, 89834777, 179669557, 359339171};
+										11229331, 22458671, 44917381, 89834777, 179669557, 359339171,
+										718678369, 1437356741, 2147483647};
 	
 	static size_t nextSize(size_t n) {
 		auto it = std::ranges::lower_bound(primes, n);
-		assert(it != primes + std::size(primes));
+		if(it == primes + std::size(primes)) throw std::length_error("HashMap cannot hold that many elements");
 		return *it;
 	}
 
 	void rehash(size_t s) {
+		const auto start = std::chrono::steady_clock::now();
 		buckets.assign(s, -1);
 		const int V = v.size();
 		for(int i = 0; i < V; ++i) {
@@ -116,5 +167,9 @@ protected:
 			v[i].nxt = buckets[b];
 			buckets[b] = i;
 		}
+		// Sizing an empty map is not a rehash
+		if(!V) return;
+		++ rehashes;
+		rehashSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 	}
 };
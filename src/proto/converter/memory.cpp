@@ -0,0 +1,170 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+#include <malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+static atomic<bool> counting = false;
+// Live bytes are signed as blocks allocated before counting may be freed after
+static atomic<uint64_t> allocations = 0, allocatedBytes = 0;
+static atomic<int64_t> liveBytes = 0, peakLiveBytes = 0;
+
+static void count(void *p) {
+	const int64_t s = malloc_usable_size(p);
+	allocations.fetch_add(1, memory_order_relaxed);
+	allocatedBytes.fetch_add(s, memory_order_relaxed);
+	const int64_t live = liveBytes.fetch_add(s, memory_order_relaxed) + s;
+	int64_t peak = peakLiveBytes.load(memory_order_relaxed);
+	while(live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, memory_order_relaxed));
+}
+
+// Allocate with `alloc`, calling the new handler until it succeeds as the default operator new does
+template<typename F>
+static void* allocate(F &&alloc) {
+	void *p;
+	while(!(p = alloc())) {
+		const new_handler handler = get_new_handler();
+		if(!handler) throw bad_alloc();
+		handler();
+	}
+	if(counting.load(memory_order_relaxed)) count(p);
+	return p;
+}
+
+static void deallocate(void *p) noexcept {
+	if(!p) return;
+	if(counting.load(memory_order_relaxed)) liveBytes.fetch_sub(malloc_usable_size(p), memory_order_relaxed);
+	free(p);
+}
+
+// Counting allocator hook
+// Array and nothrow forms end up in these operators
+void* operator new(size_t size) {
+	return allocate([&]() { return malloc(size ? size : 1); });
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+	const size_t a = max(size_t(alignment), sizeof(void*));
+	return allocate([&]() { return aligned_alloc(a, (max<size_t>(size, 1) + a-1) / a * a); });
+}
+
+void operator delete(void *p) noexcept {
+	deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	deallocate(p);
+}
+
+void operator delete(void *p, align_val_t) noexcept {
+	deallocate(p);
+}
+
+void operator delete(void *p, size_t, align_val_t) noexcept {
+	deallocate(p);
+}
+
+namespace Memory {
+
+void enableCounters() {
+	counting = true;
+}
+
+Counters counters() {
+	return {allocations, allocatedBytes, uint64_t(max<int64_t>(liveBytes, 0)), uint64_t(max<int64_t>(peakLiveBytes, 0))};
+}
+
+void resetPeak() {
+	peakLiveBytes = liveBytes.load();
+}
+
+size_t currentRSS() {
+	ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	statm >> pages >> resident;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t peakRSS() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return size_t(usage.ru_maxrss) * 1024;
+}
+
+}
+
+MemoryReport::MemoryReport(): phaseStart(chrono::steady_clock::now()) {}
+
+void MemoryReport::endPhase(const string &name, vector<pair<string, size_t>> &&containers) {
+	const auto now = chrono::steady_clock::now();
+	phases.emplace_back(name, chrono::duration<double>(now - phaseStart).count(),
+		Memory::counters(), Memory::currentRSS(), Memory::peakRSS(), std::move(containers));
+	Memory::resetPeak();
+	phaseStart = chrono::steady_clock::now();
+}
+
+static string humanBytes(const double bytes) {
+	static constexpr const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+	double b = bytes;
+	uint32_t u = 0;
+	while(b >= 1024. && u+1 < size(units)) { b /= 1024.; ++ u; }
+	ostringstream ss;
+	ss << fixed << setprecision(u ? 1 : 0) << b << ' ' << units[u];
+	return ss.str();
+}
+
+void MemoryReport::print(ostream &out) const {
+	const ios_base::fmtflags flags = out.flags();
+	const streamsize precision = out.precision();
+	out << "Memory per phase:\n";
+	Memory::Counters last;
+	for(const Phase &p : phases) {
+		out << "  " << p.name << " (" << fixed << setprecision(3) << p.seconds << "s)\n";
+		out << "    RSS " << humanBytes(p.rss) << ", peak RSS " << humanBytes(p.peakRSS) << '\n';
+		out << "    heap " << humanBytes(p.counters.liveBytes) << ", phase peak " << humanBytes(p.counters.peakLiveBytes)
+			<< ", " << p.counters.allocations - last.allocations << " allocations of "
+			<< humanBytes(p.counters.allocatedBytes - last.allocatedBytes) << '\n';
+		last = p.counters;
+		for(const auto &[name, bytes] : p.containers) {
+			if(bytes < 1024) continue;
+			out << "      " << left << setw(24) << name << right << humanBytes(bytes) << '\n';
+		}
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void MemoryReport::writeJSON(ostream &out) const {
+	out << "{\n\t\"phases\": [";
+	for(size_t i = 0; i < phases.size(); ++i) {
+		const Phase &p = phases[i];
+		out << (i ? "," : "") << "\n\t\t{\n";
+		out << "\t\t\t\"name\": \"" << p.name << "\",\n";
+		out << "\t\t\t\"seconds\": " << p.seconds << ",\n";
+		out << "\t\t\t\"rss\": " << p.rss << ",\n";
+		out << "\t\t\t\"peak_rss\": " << p.peakRSS << ",\n";
+		out << "\t\t\t\"allocations\": " << p.counters.allocations << ",\n";
+		out << "\t\t\t\"allocated_bytes\": " << p.counters.allocatedBytes << ",\n";
+		out << "\t\t\t\"live_bytes\": " << p.counters.liveBytes << ",\n";
+		out << "\t\t\t\"phase_peak_live_bytes\": " << p.counters.peakLiveBytes << ",\n";
+		out << "\t\t\t\"containers\": {";
+		for(size_t j = 0; j < p.containers.size(); ++j)
+			out << (j ? "," : "") << "\n\t\t\t\t\"" << p.containers[j].first << "\": " << p.containers[j].second;
+		out << "\n\t\t\t}\n\t\t}";
+	}
+	out << "\n\t]\n}\n";
+}
@@ -0,0 +1,60 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Memory {
+
+// Counters maintained by the replaced global operator new/delete once counting is enabled,
+// allocations cost a plain malloc until then
+void enableCounters();
+struct Counters {
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+	uint64_t liveBytes = 0;
+	uint64_t peakLiveBytes = 0;
+};
+Counters counters();
+// Make the peak of live bytes restart from the current live bytes
+void resetPeak();
+
+// Resident set size of the process, in bytes
+size_t currentRSS();
+size_t peakRSS();
+
+template<typename T>
+inline size_t bytes(const std::vector<T> &v) {
+	return v.capacity() * sizeof(T);
+}
+
+}
+
+// Memory used by the converter at the end of each of its phases
+struct MemoryReport {
+	struct Phase {
+		std::string name;
+		double seconds;
+		Memory::Counters counters;
+		size_t rss, peakRSS;
+		std::vector<std::pair<std::string, size_t>> containers;
+	};
+	std::vector<Phase> phases;
+
+	MemoryReport();
+	// Close the current phase, `containers` being the bytes held by the main structures at that point
+	void endPhase(const std::string &name, std::vector<std::pair<std::string, size_t>> &&containers);
+
+	void print(std::ostream &out) const;
+	void writeJSON(std::ostream &out) const;
+
+protected:
+	std::chrono::steady_clock::time_point phaseStart;
+};
@@ -0,0 +1,236 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "osc.h"
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <zlib.h>
+
+#include "utils.h"
+
+using namespace std;
+
+// Whole content of a file, gzip compressed or not
+static string readFile(const char *fileName) {
+	const gzFile file = gzopen(fileName, "rb");
+	if(!file) THROW_ERROR("Failed to open " + string(fileName));
+	string content;
+	char buffer[1 << 16];
+	int n;
+	while((n = gzread(file, buffer, sizeof(buffer))) > 0) content.append(buffer, n);
+	gzclose(file);
+	if(n < 0) THROW_ERROR("Failed to read " + string(fileName));
+	return content;
+}
+
+static void appendUtf8(string &out, const uint32_t c) {
+	if(c < 0x80) out += char(c);
+	else if(c < 0x800) {
+		out += char(0xc0 | c >> 6);
+		out += char(0x80 | (c & 0x3f));
+	} else if(c < 0x10000) {
+		out += char(0xe0 | c >> 12);
+		out += char(0x80 | (c >> 6 & 0x3f));
+		out += char(0x80 | (c & 0x3f));
+	} else {
+		out += char(0xf0 | c >> 18);
+		out += char(0x80 | (c >> 12 & 0x3f));
+		out += char(0x80 | (c >> 6 & 0x3f));
+		out += char(0x80 | (c & 0x3f));
+	}
+}
+
+// Attribute value with its entities replaced
+static string unescape(const string_view s) {
+	string out;
+	out.reserve(s.size());
+	for(size_t i = 0; i < s.size(); ++i) {
+		if(s[i] != '&') {
+			out += s[i];
+			continue;
+		}
+		const size_t end = s.find(';', i);
+		if(end == string_view::npos) THROW_ERROR("Unterminated entity in OsmChange: " + string(s));
+		const string_view e = s.substr(i+1, end-i-1);
+		if(e == "amp") out += '&';
+		else if(e == "lt") out += '<';
+		else if(e == "gt") out += '>';
+		else if(e == "quot") out += '"';
+		else if(e == "apos") out += '\'';
+		else if(e.size() > 1 && e[0] == '#') {
+			const bool hex = e[1] == 'x' || e[1] == 'X';
+			uint32_t c = 0;
+			const char *const first = e.data() + (hex ? 2 : 1), *const last = e.data() + e.size();
+			if(from_chars(first, last, c, hex ? 16 : 10).ptr != last) THROW_ERROR("Bad entity in OsmChange: " + string(e));
+			appendUtf8(out, c);
+		} else THROW_ERROR("Unknown entity in OsmChange: " + string(e));
+		i = end;
+	}
+	return out;
+}
+
+static int64_t parseId(const string &s) {
+	int64_t x = 0;
+	if(from_chars(s.data(), s.data() + s.size(), x).ptr != s.data() + s.size()) THROW_ERROR("Bad id in OsmChange: " + s);
+	return x;
+}
+
+// Degrees to 1e-7 degrees, rounded to the nearest
+static int32_t parseCoordinate(const string &s) {
+	size_t i = 0;
+	const bool negative = !s.empty() && s[0] == '-';
+	if(negative || (!s.empty() && s[0] == '+')) ++ i;
+	int64_t x = 0;
+	uint32_t decimals = 0;
+	bool dot = false, digits = false, roundUp = false;
+	for(; i < s.size(); ++i) {
+		if(s[i] == '.' && !dot) dot = true;
+		else if('0' <= s[i] && s[i] <= '9') {
+			digits = true;
+			if(!dot) x = 10 * x + (s[i] - '0');
+			else if(decimals < 7) {
+				x = 10 * x + (s[i] - '0');
+				++ decimals;
+			} else if(decimals++ == 7) roundUp = s[i] >= '5';
+		} else THROW_ERROR("Bad coordinate in OsmChange: " + s);
+		if(x > 1800000000) THROW_ERROR("Bad coordinate in OsmChange: " + s);
+	}
+	for(; decimals < 7; ++decimals) x *= 10;
+	if(roundUp) ++ x;
+	if(!digits || x > 1800000000) THROW_ERROR("Bad coordinate in OsmChange: " + s);
+	return int32_t(negative ? -x : x);
+}
+
+OsmChange::OsmChange(const char *fileName) {
+	const string content = readFile(fileName);
+	unordered_map<string, uint32_t> ids;
+	strings.s.emplace_back();
+	ids.emplace("", 0);
+	const auto intern = [&](const string &s) {
+		const auto [it, added] = ids.try_emplace(s, strings.s.size());
+		if(added) strings.s.emplace_back(s.begin(), s.end());
+		return it->second;
+	};
+
+	// Current action, entity and the last ref or member id for delta coding
+	enum { NONE, NODE, WAY, RELATION } entity = NONE;
+	Action action = MODIFY;
+	bool inAction = false;
+	int64_t last = 0;
+	const auto endEntity = [&]() {
+		if(entity == NONE) THROW_ERROR("Unexpected end of element in " + string(fileName));
+		entity = NONE;
+	};
+
+	vector<pair<string_view, string>> attrs;
+	const auto attr = [&](const string_view name)->const string& {
+		for(const auto &[n, v] : attrs) if(n == name) return v;
+		THROW_ERROR("Missing attribute " + string(name) + " in " + string(fileName));
+	};
+	const auto optAttr = [&](const string_view name)->const string* {
+		for(const auto &[n, v] : attrs) if(n == name) return &v;
+		return nullptr;
+	};
+
+	size_t pos = 0;
+	const auto skipTo = [&](const string_view end) {
+		pos = content.find(end, pos);
+		if(pos == string::npos) THROW_ERROR("Truncated file " + string(fileName));
+		pos += end.size();
+	};
+	const auto isSpace = [](const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+	while((pos = content.find('<', pos)) != string::npos) {
+		if(content.compare(pos, 2, "<?") == 0) { skipTo("?>"); continue; }
+		if(content.compare(pos, 4, "<!--") == 0) { skipTo("-->"); continue; }
+		if(content.compare(pos, 2, "<!") == 0) { skipTo(">"); continue; }
+		const bool closing = content.compare(pos, 2, "</") == 0;
+		pos += closing ? 2 : 1;
+		size_t end = pos;
+		while(end < content.size() && !isSpace(content[end]) && content[end] != '>' && content[end] != '/') ++ end;
+		const string_view name(content.data() + pos, end - pos);
+		pos = end;
+		attrs.clear();
+		bool selfClosing = false;
+		for(;;) {
+			while(pos < content.size() && isSpace(content[pos])) ++ pos;
+			if(pos >= content.size()) THROW_ERROR("Truncated file " + string(fileName));
+			if(content[pos] == '>') { ++ pos; break; }
+			if(content.compare(pos, 2, "/>") == 0) { pos += 2; selfClosing = true; break; }
+			const size_t eq = content.find('=', pos);
+			if(eq == string::npos || eq+1 >= content.size()) THROW_ERROR("Bad attribute in " + string(fileName));
+			size_t nameEnd = eq;
+			while(nameEnd > pos && isSpace(content[nameEnd-1])) -- nameEnd;
+			size_t quote = eq+1;
+			while(quote < content.size() && isSpace(content[quote])) ++ quote;
+			if(quote >= content.size() || (content[quote] != '"' && content[quote] != '\'')) THROW_ERROR("Bad attribute in " + string(fileName));
+			const size_t valueEnd = content.find(content[quote], quote+1);
+			if(valueEnd == string::npos) THROW_ERROR("Truncated file " + string(fileName));
+			attrs.emplace_back(string_view(content.data() + pos, nameEnd - pos), unescape(string_view(content.data() + quote+1, valueEnd - quote-1)));
+			pos = valueEnd+1;
+		}
+
+		if(name == "create" || name == "modify" || name == "delete") {
+			if(closing) inAction = false;
+			else if(!selfClosing) {
+				inAction = true;
+				action = name == "create" ? CREATE : name == "modify" ? MODIFY : DELETE;
+			}
+		} else if(name == "node" || name == "way" || name == "relation") {
+			if(closing) {
+				endEntity();
+				continue;
+			}
+			if(!inAction) THROW_ERROR("Entity outside of create, modify or delete in " + string(fileName));
+			if(entity != NONE) THROW_ERROR("Nested entities in " + string(fileName));
+			const int64_t id = parseId(attr("id"));
+			last = 0;
+			if(name == "node") {
+				entity = NODE;
+				Node &node = nodes.emplace_back(action, Node{id, vec2i(0, 0), {}, {}}).second;
+				const string *const lat = optAttr("lat"), *const lon = optAttr("lon");
+				if(lat && lon) node.coords = vec2i(parseCoordinate(*lon), parseCoordinate(*lat));
+				else if(action != DELETE) THROW_ERROR("Node " + to_string(id) + " without coordinates in " + string(fileName));
+			} else if(name == "way") {
+				entity = WAY;
+				ways.emplace_back(action, Proto::Way()).second.id = id;
+			} else {
+				entity = RELATION;
+				relations.emplace_back(action, Proto::Relation()).second.id = id;
+			}
+			if(selfClosing) endEntity();
+		} else if(name == "tag" && !closing) {
+			const uint32_t k = intern(attr("k")), v = intern(attr("v"));
+			if(entity == NODE) {
+				nodes.back().second.keys.push_back(k);
+				nodes.back().second.vals.push_back(v);
+			} else if(entity == WAY) {
+				ways.back().second.keys.push_back(k);
+				ways.back().second.vals.push_back(v);
+			} else if(entity == RELATION) {
+				relations.back().second.keys.push_back(k);
+				relations.back().second.vals.push_back(v);
+			} else THROW_ERROR("Tag outside of an entity in " + string(fileName));
+		} else if(name == "nd" && !closing) {
+			if(entity != WAY) THROW_ERROR("Node reference outside of a way in " + string(fileName));
+			const int64_t ref = parseId(attr("ref"));
+			ways.back().second.refs.push_back(ref - last);
+			last = ref;
+		} else if(name == "member" && !closing) {
+			if(entity != RELATION) THROW_ERROR("Member outside of a relation in " + string(fileName));
+			Proto::Relation &relation = relations.back().second;
+			const string &type = attr("type");
+			const int64_t ref = parseId(attr("ref"));
+			relation.memids.push_back(ref - last);
+			last = ref;
+			relation.types.push_back(type == "node" ? Proto::Relation::NODE : type == "way" ? Proto::Relation::WAY : Proto::Relation::RELATION);
+			const string *const role = optAttr("role");
+			relation.roles_sid.push_back(role ? intern(*role) : 0);
+		}
+	}
+	if(entity != NONE || inAction) THROW_ERROR("Truncated file " + string(fileName));
+}
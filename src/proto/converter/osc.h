@@ -0,0 +1,32 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "vec.h"
+
+#include "proto/generated/osm.pb.h"
+
+// Changes of an OsmChange file (.osc, or .osc.gz), in document order. Ways and relations are those of
+// a PrimitiveBlock, with delta coded refs and memids, and tags and roles indexing `strings`.
+struct OsmChange {
+	enum Action : uint8_t { CREATE, MODIFY, DELETE };
+
+	struct Node {
+		int64_t id;
+		vec2i coords; // in 1e-7 degrees, as the nodes of the converter
+		std::vector<uint32_t> keys, vals;
+	};
+
+	Proto::StringTable strings; // strings.s[0] is empty, as in PBF string tables
+	std::vector<std::pair<Action, Node>> nodes;
+	std::vector<std::pair<Action, Proto::Way>> ways;
+	std::vector<std::pair<Action, Proto::Relation>> relations;
+
+	OsmChange(const char *fileName);
+};
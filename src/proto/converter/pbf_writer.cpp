@@ -0,0 +1,41 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "pbf_writer.h"
+
+#include <limits>
+#include <string>
+
+#include <zlib.h>
+
+#include "utils.h"
+
+#include "proto/generated/osm.pb.h"
+
+using namespace std;
+
+vector<uint8_t> encodeBlob(const string_view type, const vector<uint8_t> &data) {
+	if(data.size() > (size_t) numeric_limits<int32_t>::max()) THROW_ERROR("Blob too large");
+	Proto::Blob blob;
+	blob.raw_size = data.size();
+	blob._has_raw_size = true;
+	uLongf size = compressBound(data.size());
+	new(&blob.data.zlib_data) vector<uint8_t>(size);
+	blob._data_choice = Proto::Blob::DATA_ZLIB_DATA;
+	if(compress(blob.data.zlib_data.data(), &size, data.data(), data.size()) != Z_OK)
+		THROW_ERROR("Failed to compress...");
+	blob.data.zlib_data.resize(size);
+	vector<uint8_t> blobWire;
+	blob.write(blobWire);
+
+	Proto::BlobHeader header;
+	header.type = type;
+	header.datasize = blobWire.size();
+	vector<uint8_t> out(4);
+	header.write(out);
+	const uint32_t headerSize = out.size() - 4;
+	for(uint32_t i = 0; i < 4; ++i) out[i] = headerSize >> (24 - 8*i);
+	out.insert(out.end(), blobWire.begin(), blobWire.end());
+	return out;
+}
@@ -0,0 +1,13 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Blob of a .osm.pbf file as it is stored: size of its BlobHeader, the BlobHeader, and the Blob
+// with `data` deflated by zlib. Blobs are independent, so that they can be made by several threads.
+std::vector<uint8_t> encodeBlob(std::string_view type, const std::vector<uint8_t> &data);
@@ -0,0 +1,134 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Minimal perfect hash of a fixed set of words, whose tables are produced by the enums generator.
+// A word selects a bucket, whose pilot displaces it to its own slot (PTHash scheme),
+// so a lookup is one hash, one probe of the tables and one length-checked compare.
+struct PerfectHash {
+	inline static constexpr uint32_t NOT_FOUND = -1;
+
+	struct Entry {
+		const char *word;
+		uint32_t size;
+		uint32_t value;
+	};
+
+	uint64_t seed;
+	uint64_t sizes; // bit l set if a word has size l (63 for 63 and more), other words are rejected without hashing
+	std::span<const uint64_t> pilots; // already mixed
+	std::span<const Entry> entries; // indexed by slot
+
+	static constexpr uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// Reads the word 8 bytes at a time, tables must be generated on a machine of the same endianness
+	static inline uint64_t hash(const std::string_view &word, const uint64_t seed) {
+		uint64_t h = seed ^ (word.size() * 0x9e3779b97f4a7c15ull);
+		size_t i = 0;
+		uint64_t w;
+		for(; i + 8 <= word.size(); i += 8) {
+			std::memcpy(&w, word.data() + i, 8);
+			h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+			h ^= h >> 32;
+		}
+		// Tail of less than 8 bytes read with fixed size loads, that may overlap
+		const char *p = word.data() + i;
+		const size_t r = word.size() - i;
+		if(r >= 4) {
+			uint32_t a, b;
+			std::memcpy(&a, p, 4);
+			std::memcpy(&b, p + r - 4, 4);
+			w = a | uint64_t(b) << 32;
+		} else if(r) w = uint8_t(p[0]) | uint32_t(uint8_t(p[r/2])) << 8 | uint32_t(uint8_t(p[r-1])) << 16;
+		else w = 0;
+		return mix(h ^ w);
+	}
+
+	// Map 32 bits of hash to [0, n) with a multiplication instead of a division
+	static inline uint32_t reduce(const uint32_t x, const size_t n) {
+		return (uint64_t(x) * n) >> 32;
+	}
+
+	static inline uint32_t bucket(const uint64_t h, const size_t buckets) {
+		return reduce(h >> 32, buckets);
+	}
+
+	static inline uint32_t slot(const uint64_t h, const uint64_t mixedPilot, const size_t slots) {
+		return reduce(uint32_t(h ^ mixedPilot), slots);
+	}
+
+	static constexpr uint64_t sizeBit(const size_t size) {
+		return uint64_t(1) << (size < 63 ? size : 63);
+	}
+
+	uint32_t feed(const std::string_view &word) const {
+		if(!(sizes & sizeBit(word.size()))) return NOT_FOUND;
+		const uint64_t h = hash(word, seed);
+		const Entry &e = entries[slot(h, pilots[bucket(h, pilots.size())], entries.size())];
+		return e.size == word.size() && !std::memcmp(e.word, word.data(), word.size()) ? e.value : NOT_FOUND;
+	}
+};
+
+// Search result, turned into a PerfectHash once the words are put in slot order and the pilots mixed
+struct PerfectHashTables {
+	uint64_t seed;
+	std::vector<uint32_t> pilots;
+	std::vector<uint32_t> words; // index of the word in each slot
+};
+
+// Search the seed and the pilots of a minimal perfect hash of `words`, buckets being placed from the largest
+template<typename W>
+inline PerfectHashTables buildPerfectHash(const std::vector<W> &words) {
+	constexpr uint32_t MAX_PILOT = 1 << 20;
+	const size_t N = words.size(), B = N / 4 + 1;
+	for(uint64_t seed = 1;; ++seed) {
+		PerfectHashTables t{seed, std::vector<uint32_t>(B, 0), std::vector<uint32_t>(N, -1)};
+		std::vector<uint64_t> hashes(N);
+		std::vector<std::vector<uint32_t>> buckets(B);
+		for(uint32_t i = 0; i < N; ++i) {
+			hashes[i] = PerfectHash::hash(words[i], seed);
+			buckets[PerfectHash::bucket(hashes[i], B)].push_back(i);
+		}
+		std::vector<uint32_t> order(B);
+		for(uint32_t b = 0; b < B; ++b) order[b] = b;
+		std::ranges::stable_sort(order, [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+		bool ok = true;
+		std::vector<uint32_t> slots;
+		for(const uint32_t b : order) {
+			if(buckets[b].empty()) break;
+			uint32_t pilot = 0;
+			for(; pilot < MAX_PILOT; ++pilot) {
+				slots.clear();
+				for(const uint32_t i : buckets[b]) {
+					const uint32_t s = PerfectHash::slot(hashes[i], PerfectHash::mix(pilot), N);
+					if(t.words[s] != uint32_t(-1) || std::ranges::find(slots, s) != slots.end()) break;
+					slots.push_back(s);
+				}
+				if(slots.size() == buckets[b].size()) break;
+			}
+			if(pilot == MAX_PILOT) {
+				ok = false;
+				break;
+			}
+			t.pilots[b] = pilot;
+			for(uint32_t j = 0; j < slots.size(); ++j) t.words[slots[j]] = buckets[b][j];
+		}
+		if(ok) return t;
+	}
+}
@@ -0,0 +1,185 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "polylines.h"
+
+#include <algorithm>
+#include <limits>
+#include <ranges>
+#include <unordered_map>
+
+#include "utils.h"
+
+using namespace std;
+
+vector<uint32_t> mergePolylines(vector<vec2i> &pts, vector<uint64_t> &off, const vector<bool> &pinned) {
+	constexpr uint32_t NONE = -1;
+	const uint32_t N = off.size()-1;
+	// Endpoint e is the first point of polyline e/2 if e is even, its last point otherwise
+	const auto point = [&](const uint32_t e)->const vec2i& {
+		return pts[(e&1) ? off[e/2+1]-1 : off[e/2]];
+	};
+	const auto key = [](const vec2i &p) {
+		return uint64_t(uint32_t(p.x)) << 32 | uint32_t(p.y);
+	};
+
+	// Endpoints are joined when they are the only two at their point, of distinct polylines that may be merged
+	unordered_map<uint64_t, pair<uint32_t, uint32_t>> ends; // first endpoint at a point, and number of endpoints
+	ends.reserve(2*N);
+	for(uint32_t e = 0; e < 2*N; ++e) {
+		const auto [it, added] = ends.try_emplace(key(point(e)), e, 0);
+		++ it->second.second;
+	}
+	vector<uint32_t> partner(2*N, NONE);
+	for(uint32_t e = 0; e < 2*N; ++e) {
+		const auto &[f, count] = ends.find(key(point(e)))->second;
+		if(count != 2 || f == e || f/2 == e/2 || pinned[e/2] || pinned[f/2]) continue;
+		partner[e] = f;
+		partner[f] = e;
+	}
+	ends = {};
+
+	vector<vec2i> merged;
+	merged.reserve(pts.size());
+	vector<uint64_t> mergedOff = {0};
+	vector<uint32_t> index(N, NONE);
+	const auto append = [&](const uint32_t e, const bool first) {
+		const uint32_t i = e/2;
+		const auto begin = pts.begin() + off[i] + (first || (e&1) ? 0 : 1), end = pts.begin() + off[i+1] - (first || !(e&1) ? 0 : 1);
+		if(e&1) merged.insert(merged.end(), make_reverse_iterator(end), make_reverse_iterator(begin));
+		else merged.insert(merged.end(), begin, end);
+		index[i] = mergedOff.size()-1;
+	};
+	for(uint32_t i = 0; i < N; ++i) {
+		if(index[i] != NONE) continue;
+		// Go back to an end of the chain of polylines containing i, or break the cycle at i
+		uint32_t e = 2*i;
+		for(uint32_t f; (f = partner[e]) != NONE;) {
+			if(f/2 == i) {
+				e = 2*i;
+				break;
+			}
+			e = f^1;
+		}
+		// Then follow the chain
+		append(e, true);
+		for(uint32_t f; (f = partner[e^1]) != NONE && index[f/2] == NONE; e = f) append(f, false);
+		mergedOff.push_back(merged.size());
+	}
+	pts = std::move(merged);
+	off = std::move(mergedOff);
+	return index;
+}
+
+// Index of cell (x, y) along the Hilbert curve of order 16
+static uint32_t hilbertIndex(uint32_t x, uint32_t y) {
+	uint32_t d = 0;
+	for(uint32_t s = 1u << 15; s; s >>= 1) {
+		const uint32_t rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+		d += s * s * ((3 * rx) ^ ry);
+		// Rotate the quadrant so that the curve inside it starts and ends as the curve of order 1
+		if(!ry) {
+			if(rx) {
+				x = s-1 - (x & (s-1));
+				y = s-1 - (y & (s-1));
+			}
+			swap(x, y);
+		}
+	}
+	return d;
+}
+
+vector<uint32_t> sortPolylines(vector<vec2i> &pts, vector<uint64_t> &off, const Box<vec2i> &bbox) {
+	const uint32_t N = off.size()-1;
+	const double sx = 65535. / max(1., double(bbox.max.x) - bbox.min.x), sy = 65535. / max(1., double(bbox.max.y) - bbox.min.y);
+	vector<pair<uint32_t, uint32_t>> keys(N); // (Hilbert index, polyline)
+	for(uint32_t i = 0; i < N; ++i) {
+		Box<vec2i> box;
+		for(uint64_t j = off[i]; j < off[i+1]; ++j) box.update(pts[j]);
+		const double cx = (double(box.min.x) + box.max.x) / 2., cy = (double(box.min.y) + box.max.y) / 2.;
+		keys[i] = {hilbertIndex(
+			clamp((cx - bbox.min.x) * sx, 0., 65535.),
+			clamp((cy - bbox.min.y) * sy, 0., 65535.)
+		), i};
+	}
+	ranges::sort(keys);
+
+	vector<vec2i> sorted;
+	sorted.reserve(pts.size());
+	vector<uint64_t> sortedOff = {0};
+	sortedOff.reserve(off.size());
+	vector<uint32_t> index(N);
+	for(const uint32_t i : keys | views::values) {
+		index[i] = sortedOff.size()-1;
+		sorted.insert(sorted.end(), pts.begin() + off[i], pts.begin() + off[i+1]);
+		sortedOff.push_back(sorted.size());
+	}
+	pts = std::move(sorted);
+	off = std::move(sortedOff);
+	return index;
+}
+
+void indexRoads(OSMData &data) {
+	if(!data.roadIndices.empty()) return;
+	if(data.roads.size() > numeric_limits<uint32_t>::max())
+		THROW_ERROR("Indexed polylines have " + to_string(data.roads.size()) + " points, more than 32 bits indices");
+	unordered_map<uint64_t, uint32_t> ids;
+	ids.reserve(data.roads.size());
+	vector<vec2i> distinct;
+	data.roadIndices.resize(data.roads.size());
+	for(size_t i = 0; i < data.roads.size(); ++i) {
+		const vec2i &p = data.roads[i];
+		const auto [it, added] = ids.try_emplace(uint64_t(uint32_t(p.x)) << 32 | uint32_t(p.y), distinct.size());
+		if(added) distinct.push_back(p);
+		data.roadIndices[i] = it->second;
+	}
+	for(uint32_t &i : data.forestIndices) i = data.roadIndices[i];
+	data.roads = std::move(distinct);
+}
+
+void simplifyPolyline(const vec2i *pts, const uint32_t n, const span<const uint32_t> pinned, const double tolerance, vector<vec2i> &out) {
+	if(n <= 2) {
+		out.insert(out.end(), pts, pts+n);
+		return;
+	}
+	// Squared distance of p to the segment [a, b]
+	const auto dist2 = [](const vec2i &p, const vec2i &a, const vec2i &b) {
+		const double dx = double(b.x) - a.x, dy = double(b.y) - a.y;
+		const double px = double(p.x) - a.x, py = double(p.y) - a.y;
+		const double l2 = dx*dx + dy*dy;
+		const double t = l2 > 0. ? clamp((px*dx + py*dy) / l2, 0., 1.) : 0.;
+		const double ex = px - t*dx, ey = py - t*dy;
+		return ex*ex + ey*ey;
+	};
+	const double tol2 = tolerance * tolerance;
+	vector<bool> keep(n, false);
+	keep[0] = keep[n-1] = true;
+	// Ranges still to split, with an explicit stack as merged polylines may be long
+	vector<pair<uint32_t, uint32_t>> ranges;
+	uint32_t first = 0;
+	for(const uint32_t i : pinned) {
+		keep[i] = true;
+		ranges.emplace_back(first, i);
+		first = i;
+	}
+	ranges.emplace_back(first, n-1);
+	while(!ranges.empty()) {
+		const auto [first, last] = ranges.back();
+		ranges.pop_back();
+		double worst = tol2;
+		uint32_t split = 0;
+		for(uint32_t i = first+1; i < last; ++i) {
+			const double d = dist2(pts[i], pts[first], pts[last]);
+			if(d > worst) {
+				worst = d;
+				split = i;
+			}
+		}
+		if(!split) continue;
+		keep[split] = true;
+		ranges.emplace_back(first, split);
+		ranges.emplace_back(split, last);
+	}
+	for(uint32_t i = 0; i < n; ++i) if(keep[i]) out.push_back(pts[i]);
+}
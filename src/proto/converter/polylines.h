@@ -0,0 +1,33 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "vec.h"
+
+#include "data/data.h"
+
+// Join polylines that meet end to end at a point where no other polyline ends into maximal polylines.
+// Polyline i is pts[off[i]..off[i+1]), pinned polylines are left as they are and never joined.
+// Polylines keep the order of their first member, and the index of the polyline containing
+// each former polyline is returned.
+std::vector<uint32_t> mergePolylines(std::vector<vec2i> &pts, std::vector<uint64_t> &off, const std::vector<bool> &pinned);
+
+// Sort polylines by the Hilbert index of the centre of their bounding box on a grid of 2^16 x 2^16 cells
+// covering bbox, so that polylines close in space are close in memory. Polylines with the same index
+// keep their order, and the new index of each polyline is returned.
+std::vector<uint32_t> sortPolylines(std::vector<vec2i> &pts, std::vector<uint64_t> &off, const Box<vec2i> &bbox);
+
+// Indexed layout of data (see OSMData::roadIndices): roads keeps one copy of each distinct point, in order of first
+// appearance, and forestIndices are remapped to these copies. Levels of detail are left as they are.
+void indexRoads(OSMData &data);
+
+// Append to out the points of pts[0..n) kept by Douglas-Peucker simplification: every removed point
+// is within `tolerance` of the simplified polyline, both ends and the points of `pinned`, increasing
+// indices in (0, n-1), are kept
+void simplifyPolyline(const vec2i *pts, uint32_t n, std::span<const uint32_t> pinned, double tolerance, std::vector<vec2i> &out);
@@ -0,0 +1,104 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Lists of node ids stored back to back in a single byte buffer.
+// Each run is a varint count followed by the zigzag varint deltas between consecutive ids,
+// and runs are located through an offset table.
+struct RefArena {
+	struct Sentinel {};
+
+	struct Iterator {
+		using iterator_category = std::input_iterator_tag;
+		using difference_type   = std::ptrdiff_t;
+		using value_type        = int64_t;
+
+		const uint8_t *it = nullptr;
+		uint32_t left = 0;
+		int64_t cur = 0;
+
+		Iterator() = default;
+		Iterator(const uint8_t *it): it(it) {
+			left = (uint32_t) readVarint(this->it);
+			++ *this;
+		}
+
+		int64_t operator*() const { return cur; }
+		Iterator& operator++() {
+			if(left) {
+				const uint64_t z = readVarint(it);
+				cur += static_cast<int64_t>((z>>1) ^ -(z&1));
+			}
+			-- left;
+			return *this;
+		}
+		void operator++(int) { ++*this; }
+		bool operator==(Sentinel) const { return left == uint32_t(-1); }
+	};
+
+	struct Run {
+		const uint8_t *start;
+		Iterator begin() const { return Iterator(start); }
+		Sentinel end() const { return {}; }
+		uint32_t size() const {
+			const uint8_t *it = start;
+			return (uint32_t) readVarint(it);
+		}
+		int64_t front() const { return *begin(); }
+		int64_t back() const {
+			int64_t x = 0;
+			for(Iterator it = begin(); it != end(); ++it) x = *it;
+			return x;
+		}
+		std::vector<int64_t> decode() const {
+			std::vector<int64_t> ids;
+			ids.reserve(size());
+			for(Iterator it = begin(); it != end(); ++it) ids.push_back(*it);
+			return ids;
+		}
+	};
+
+	std::vector<uint8_t> bytes;
+	std::vector<uint64_t> offsets;
+
+	// Add a run from already delta coded ids (as found in PBF ways) and return its index
+	uint32_t push(std::span<const int64_t> deltas) {
+		offsets.push_back(bytes.size());
+		writeVarint(deltas.size());
+		for(const int64_t d : deltas)
+			writeVarint((static_cast<uint64_t>(d) << 1) ^ static_cast<uint64_t>(d >> 63));
+		return offsets.size()-1;
+	}
+
+	Run operator[](uint32_t i) const { return {bytes.data() + offsets[i]}; }
+	size_t size() const { return offsets.size(); }
+
+	size_t memory() const {
+		return bytes.capacity() * sizeof(uint8_t) + offsets.capacity() * sizeof(uint64_t);
+	}
+
+protected:
+	static uint64_t readVarint(const uint8_t* &it) {
+		uint64_t value = 0;
+		for(int shift = 0;; shift += 7) {
+			value |= uint64_t(*it & 0x7f) << shift;
+			if(!(*(it++) & 0x80u)) return value;
+		}
+	}
+
+	void writeVarint(uint64_t value) {
+		while(value >= 0x80u) {
+			bytes.push_back(uint8_t(value) | 0x80u);
+			value >>= 7;
+		}
+		bytes.push_back(uint8_t(value));
+	}
+};
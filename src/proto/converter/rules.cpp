@@ -0,0 +1,169 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "rules.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+#include "utils.h"
+
+using namespace std;
+
+static bool parseInt(string_view s, int64_t &x) {
+	return !s.empty() && from_chars(s.begin(), s.end(), x).ptr == s.end();
+}
+
+uint32_t Rules::id(StringIds &ids, string_view s) {
+	return ids.try_emplace(string(s), ids.size()).first->second;
+}
+
+Rules::Rules(const char *fileName, span<const char* const> layers) {
+	ifstream file(fileName);
+	if(!file) THROW_ERROR("Failed to open rules file: " + string(fileName));
+	unordered_map<string, uint32_t> conditionIds;
+	string line;
+	for(uint32_t lineNumber = 1; getline(file, line); ++lineNumber) {
+		const auto error = [&](const string &msg) {
+			THROW_ERROR(string(fileName) + ":" + to_string(lineNumber) + ": " + msg);
+		};
+		line = line.substr(0, line.find('#'));
+		istringstream tokens(line);
+		string layer, token;
+		if(!(tokens >> layer)) continue;
+		const auto l = ranges::find_if(layers, [&](const char *name) { return layer == name; });
+		if(l == layers.end()) error("unknown layer " + layer);
+		Rule &rule = rules.emplace_back((uint32_t) (l - layers.begin()), 0);
+		while(tokens >> token) {
+			const size_t eq = token.find('=');
+			if(eq == string::npos || eq == 0 || eq+1 == token.size()) error("condition should be key=value: " + token);
+			auto [it, added] = conditionIds.try_emplace(token, conditions.size());
+			if(added) {
+				const string_view key = string_view(token).substr(0, eq), spec = string_view(token).substr(eq+1);
+				const uint32_t k = id(keyIds, key);
+				if(k >= keyConditions.size()) keyConditions.resize(k+1);
+				KeyConditions &kc = keyConditions[k];
+				Condition &c = conditions.emplace_back();
+				const size_t dots = spec.find("..");
+				if(spec == "*") {
+					c.kind = Condition::ANY;
+					kc.other.push_back(it->second);
+				} else if(dots != string_view::npos && parseInt(spec.substr(0, dots), c.min) && parseInt(spec.substr(dots+2), c.max)) {
+					c.kind = Condition::RANGE;
+					if(c.min > c.max) error("empty range: " + token);
+					kc.other.push_back(it->second);
+				} else {
+					c.kind = Condition::VALUES;
+					for(size_t start = 0; start <= spec.size();) {
+						size_t end = spec.find('|', start);
+						if(end == string_view::npos) end = spec.size();
+						if(end == start) error("empty value: " + token);
+						kc.byValue.emplace_back(id(valueIds, spec.substr(start, end-start)), it->second);
+						start = end+1;
+					}
+				}
+			}
+			vector<uint32_t> &users = conditions[it->second].rules;
+			const uint32_t r = rules.size()-1;
+			if(users.empty() || users.back() != r) {
+				users.push_back(r);
+				++ rule.conditions;
+			}
+		}
+		if(!rule.conditions) error("rule without condition");
+	}
+	// Rules of one condition match when it holds, only the first of them can be the first match
+	for(Condition &c : conditions) {
+		c.first = c.rules.front();
+		const auto alone = ranges::find_if(c.rules, [&](const uint32_t r) { return rules[r].conditions == 1; });
+		if(alone != c.rules.end()) c.alone = *alone;
+		erase_if(c.rules, [&](const uint32_t r) { return rules[r].conditions == 1; });
+	}
+	for(KeyConditions &kc : keyConditions) {
+		ranges::sort(kc.other, {}, [&](const uint32_t c) { return conditions[c].first; });
+		ranges::sort(kc.byValue, {}, [&](const pair<uint32_t, uint32_t> &vc) { return tuple(vc.first, conditions[vc.second].first, vc.second); });
+		kc.byValue.erase(ranges::unique(kc.byValue).begin(), kc.byValue.end());
+	}
+}
+
+Rules::Block Rules::classify(const TagTable &table) const {
+	Block block;
+	block.keys.resize(table.strings.size(), NONE);
+	block.values.resize(table.strings.size(), NONE);
+	block.numbers.resize(table.strings.size());
+	vector<bool> keyFound(keyConditions.size(), false), valueFound(valueIds.size(), false);
+	for(size_t i = 0; i < table.strings.size(); ++i) {
+		if(const auto it = keyIds.find(table.strings[i]); it != keyIds.end()) keyFound[block.keys[i] = it->second] = true;
+		if(const auto it = valueIds.find(table.strings[i]); it != valueIds.end()) valueFound[block.values[i] = it->second] = true;
+		// The whole string, where the numbers of the TagTable may only be a prefix of it
+		if(int64_t x; parseInt(table.strings[i], x)) block.numbers[i] = x;
+	}
+
+	// Conditions that may hold, and then rules that may match
+	vector<bool> conditionFound(conditions.size(), false);
+	for(uint32_t k = 0; k < keyConditions.size(); ++k) {
+		if(!keyFound[k]) continue;
+		for(const uint32_t c : keyConditions[k].other) conditionFound[c] = true;
+		for(const auto &[v, c] : keyConditions[k].byValue)
+			if(valueFound[v]) conditionFound[c] = true;
+	}
+	vector<uint32_t> counts(rules.size(), 0);
+	for(uint32_t c = 0; c < conditions.size() && !block.mayMatch; ++c) {
+		if(!conditionFound[c]) continue;
+		if(conditions[c].alone != NONE) block.mayMatch = true;
+		for(const uint32_t r : conditions[c].rules)
+			if(++ counts[r] == rules[r].conditions) block.mayMatch = true;
+	}
+	return block;
+}
+
+uint32_t Rules::match(const Block &block, span<const uint32_t> keys, span<const uint32_t> vals) const {
+	// Stamps avoid clearing the per rule counters between entities
+	thread_local vector<uint32_t> conditionStamps, ruleStamps, ruleCounts;
+	thread_local uint32_t stamp = 0;
+	if(conditionStamps.size() < conditions.size()) conditionStamps.resize(conditions.size(), 0);
+	if(ruleStamps.size() < rules.size()) {
+		ruleStamps.resize(rules.size(), 0);
+		ruleCounts.resize(rules.size(), 0);
+	}
+	if(++ stamp == 0) {
+		ranges::fill(conditionStamps, 0);
+		ranges::fill(ruleStamps, 0);
+		stamp = 1;
+	}
+
+	uint32_t best = NONE;
+	const auto count = [&](const uint32_t c) {
+		if(conditionStamps[c] == stamp) return;
+		conditionStamps[c] = stamp;
+		best = min(best, conditions[c].alone);
+		for(const uint32_t r : conditions[c].rules) {
+			if(r >= best) break;
+			if(ruleStamps[r] != stamp) {
+				ruleStamps[r] = stamp;
+				ruleCounts[r] = 0;
+			}
+			if(++ ruleCounts[r] == rules[r].conditions) best = r;
+		}
+	};
+	for(size_t i = 0; i < keys.size(); ++i) {
+		const uint32_t k = block.keys[keys[i]];
+		if(k == NONE) continue;
+		const KeyConditions &kc = keyConditions[k];
+		const uint32_t v = vals[i];
+		for(const uint32_t c : kc.other) {
+			const Condition &cond = conditions[c];
+			if(cond.first >= best) break;
+			const optional<int64_t> &number = block.numbers[v];
+			if(cond.kind == Condition::ANY || (number && cond.min <= *number && *number <= cond.max)) count(c);
+		}
+		if(block.values[v] == NONE) continue;
+		const auto [first, last] = ranges::equal_range(kc.byValue, block.values[v], {}, &pair<uint32_t, uint32_t>::first);
+		for(auto it = first; it != last && conditions[it->second].first < best; ++it) count(it->second);
+	}
+	return best == NONE ? NONE : rules[best].layer;
+}
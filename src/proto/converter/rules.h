@@ -0,0 +1,73 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "enums/enums.h"
+
+// Rules classifying entities into layers from their tags, read from a file (see rules/ways.rules).
+// All rules are compiled into one matcher: a tag only visits the conditions on its key and value,
+// and a condition that holds counts for every rule using it before the first match found, so the
+// cost of a tag grows with the conditions on its key rather than with the number of rules.
+struct Rules {
+	static inline constexpr uint32_t NONE = -1;
+
+	// `layers` are the names that rules may use, match() returns an index in it
+	Rules(const char *fileName, std::span<const char* const> layers);
+
+	// Key and value indices of each string of a block, computed once per block
+	struct Block {
+		std::vector<uint32_t> keys, values;
+		std::vector<std::optional<int64_t>> numbers; // of the strings that are integers, for ranges
+		// Whether some rule has all its conditions on keys and values of the block,
+		// if not no entity of the block can match
+		bool mayMatch = false;
+	};
+	Block classify(const TagTable &table) const;
+
+	// Layer of the first rule whose conditions all hold for the tags, NONE if there is none
+	uint32_t match(const Block &block, std::span<const uint32_t> keys, std::span<const uint32_t> vals) const;
+
+	size_t size() const { return rules.size(); }
+
+protected:
+	struct Condition {
+		enum Kind { ANY, VALUES, RANGE } kind;
+		int64_t min = 0, max = 0;
+		uint32_t first = NONE; // first rule using it
+		uint32_t alone = NONE; // first rule with only this condition, matched without counting
+		std::vector<uint32_t> rules; // increasing, those of several conditions after the constructor
+	};
+	// Conditions by increasing first rule, so that those after a match are skipped
+	struct KeyConditions {
+		std::vector<uint32_t> other; // ANY and RANGE conditions, checked for every value
+		std::vector<std::pair<uint32_t, uint32_t>> byValue; // (value, VALUES condition), sorted by value
+	};
+	struct Rule {
+		uint32_t layer;
+		uint32_t conditions;
+	};
+
+	struct StringHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+	};
+	using StringIds = std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>>;
+
+	StringIds keyIds, valueIds;
+	std::vector<Condition> conditions;
+	std::vector<KeyConditions> keyConditions;
+	std::vector<Rule> rules;
+
+	static uint32_t id(StringIds &ids, std::string_view s);
+};
@@ -0,0 +1,35 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// Store split into S independent shards selected by id,
+// each shard being protected by its own mutex for concurrent insertions
+template<typename Shard, size_t S = 64>
+struct Sharded {
+	static constexpr size_t SHARDS = S;
+
+	static inline size_t index(const int64_t id) {
+		return static_cast<uint64_t>(id) % S;
+	}
+
+	Shard& operator()(const int64_t id) { return shards[index(id)]; }
+	const Shard& operator()(const int64_t id) const { return shards[index(id)]; }
+
+	std::unique_lock<std::mutex> lock(const int64_t id) {
+		return std::unique_lock(mutexes[index(id)]);
+	}
+	std::unique_lock<std::mutex> lockShard(const size_t s) {
+		return std::unique_lock(mutexes[s]);
+	}
+
+	std::array<Shard, S> shards;
+
+protected:
+	std::array<std::mutex, S> mutexes;
+};
@@ -0,0 +1,220 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "source.h"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "utils.h"
+
+using namespace std;
+
+static constexpr char MAGIC[8] = "OSMSRCI";
+static constexpr uint32_t VERSION = 1;
+
+// Varints, zigzag varints for signed values and differences
+struct Encoder {
+	vector<uint8_t> bytes;
+
+	void varint(uint64_t x) {
+		for(; x >= 0x80; x >>= 7) bytes.push_back(uint8_t(x | 0x80));
+		bytes.push_back(uint8_t(x));
+	}
+	void zigzag(const int64_t x) {
+		varint(uint64_t(x) << 1 ^ uint64_t(x >> 63));
+	}
+	void string(const std::string_view s) {
+		varint(s.size());
+		bytes.insert(bytes.end(), s.begin(), s.end());
+	}
+};
+
+struct Decoder {
+	const char *fileName;
+	const uint8_t *it, *end;
+
+	[[noreturn]] void corrupted() const {
+		THROW_ERROR("Corrupted source index " + std::string(fileName));
+	}
+	uint64_t varint() {
+		uint64_t x = 0;
+		for(uint32_t shift = 0;; shift += 7) {
+			if(it == end || shift > 63) corrupted();
+			x |= uint64_t(*it & 0x7f) << shift;
+			if(!(*it++ & 0x80)) return x;
+		}
+	}
+	int64_t zigzag() {
+		const uint64_t z = varint();
+		return int64_t(z >> 1) ^ -int64_t(z & 1);
+	}
+	// Count of elements of at least `minBytes` bytes each
+	size_t count(const size_t minBytes = 1) {
+		const uint64_t n = varint();
+		if(n > uint64_t(end - it) / minBytes) corrupted();
+		return n;
+	}
+	std::string string() {
+		const size_t n = count();
+		std::string s(reinterpret_cast<const char*>(it), n);
+		it += n;
+		return s;
+	}
+	int32_t int32() {
+		const int64_t x = zigzag();
+		if(x < numeric_limits<int32_t>::min() || x > numeric_limits<int32_t>::max()) corrupted();
+		return int32_t(x);
+	}
+};
+
+void SourceIndex::write(const char *fileName) const {
+	Encoder e;
+	e.bytes.assign(MAGIC, MAGIC + sizeof(MAGIC));
+	e.varint(VERSION);
+	for(const vec2i &p : {bbox.min, bbox.max}) {
+		e.zigzag(p.x);
+		e.zigzag(p.y);
+	}
+
+	e.varint(nodes.size());
+	int64_t id = 0;
+	vec2i last(0, 0);
+	for(const auto &[n, p] : nodes) {
+		e.zigzag(n - id);
+		e.zigzag(int64_t(p.x) - last.x);
+		e.zigzag(int64_t(p.y) - last.y);
+		id = n;
+		last = p;
+	}
+
+	e.varint(capitals.size());
+	id = 0;
+	for(const Capital &c : capitals) {
+		e.zigzag(c.id - id);
+		e.string(c.name);
+		id = c.id;
+	}
+
+	e.varint(ways.size());
+	id = 0;
+	for(const Way &w : ways) {
+		e.zigzag(w.id - id);
+		e.varint(uint32_t(w.layer + 1));
+		e.varint(w.refs.size());
+		int64_t ref = 0;
+		for(const int64_t r : w.refs) {
+			e.zigzag(r - ref);
+			ref = r;
+		}
+		id = w.id;
+	}
+
+	e.varint(relationStrings.s.size());
+	for(const vector<uint8_t> &s : relationStrings.s)
+		e.string(std::string_view(reinterpret_cast<const char*>(s.data()), s.size()));
+	e.varint(relations.size());
+	id = 0;
+	for(const Proto::Relation &r : relations) {
+		e.zigzag(r.id - id);
+		e.varint(r.keys.size());
+		for(size_t i = 0; i < r.keys.size(); ++i) {
+			e.varint(r.keys[i]);
+			e.varint(r.vals[i]);
+		}
+		e.varint(r.memids.size());
+		for(size_t i = 0; i < r.memids.size(); ++i) {
+			e.zigzag(r.memids[i]);
+			e.varint(r.types[i]);
+			e.varint(r.roles_sid[i]);
+		}
+		id = r.id;
+	}
+
+	ofstream file(fileName, ios::binary);
+	if(!file) THROW_ERROR("Failed to open " + std::string(fileName));
+	file.write(reinterpret_cast<const char*>(e.bytes.data()), e.bytes.size());
+	file.close();
+	if(!file) THROW_ERROR("Failed to write " + std::string(fileName));
+}
+
+void SourceIndex::read(const char *fileName, const uint32_t layers) {
+	ifstream file(fileName, ios::binary | ios::ate);
+	if(!file) THROW_ERROR("Failed to open " + std::string(fileName));
+	vector<uint8_t> bytes(file.tellg());
+	file.seekg(0);
+	if(!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) THROW_ERROR("Failed to read " + std::string(fileName));
+
+	Decoder d{fileName, bytes.data(), bytes.data() + bytes.size()};
+	if(bytes.size() < sizeof(MAGIC) || memcmp(bytes.data(), MAGIC, sizeof(MAGIC)))
+		THROW_ERROR("Not a source index: " + std::string(fileName));
+	d.it += sizeof(MAGIC);
+	if(d.varint() != VERSION) THROW_ERROR("Unsupported version of " + std::string(fileName));
+	for(vec2i *p : {&bbox.min, &bbox.max}) {
+		p->x = d.int32();
+		p->y = d.int32();
+	}
+
+	nodes.resize(d.count(3));
+	int64_t id = 0;
+	vec2i last(0, 0);
+	for(auto &[n, p] : nodes) {
+		n = id += d.zigzag();
+		const int64_t x = last.x + d.zigzag();
+		const int64_t y = last.y + d.zigzag();
+		if(x != int32_t(x) || y != int32_t(y)) d.corrupted();
+		p = last = vec2i(x, y);
+	}
+
+	capitals.resize(d.count(2));
+	id = 0;
+	for(Capital &c : capitals) {
+		c.id = id += d.zigzag();
+		c.name = d.string();
+	}
+
+	ways.resize(d.count(3));
+	id = 0;
+	for(Way &w : ways) {
+		w.id = id += d.zigzag();
+		const uint64_t layer = d.varint();
+		if(layer > layers) THROW_ERROR("Way " + to_string(w.id) + " of " + std::string(fileName) + " in an unknown layer");
+		w.layer = uint32_t(layer) - 1;
+		w.refs.resize(d.count());
+		int64_t ref = 0;
+		for(int64_t &r : w.refs) r = ref += d.zigzag();
+	}
+
+	relationStrings.s.resize(d.count());
+	for(vector<uint8_t> &s : relationStrings.s) {
+		const std::string str = d.string();
+		s.assign(str.begin(), str.end());
+	}
+	relations.resize(d.count(3));
+	id = 0;
+	for(Proto::Relation &r : relations) {
+		r.id = id += d.zigzag();
+		r.keys.resize(d.count(2));
+		r.vals.resize(r.keys.size());
+		for(size_t i = 0; i < r.keys.size(); ++i) {
+			r.keys[i] = d.varint();
+			r.vals[i] = d.varint();
+		}
+		r.memids.resize(d.count(3));
+		r.types.resize(r.memids.size());
+		r.roles_sid.resize(r.memids.size());
+		for(size_t i = 0; i < r.memids.size(); ++i) {
+			r.memids[i] = d.zigzag();
+			const uint64_t type = d.varint();
+			if(type > Proto::Relation::RELATION) d.corrupted();
+			r.types[i] = Proto::Relation::MemberType(type);
+			r.roles_sid[i] = d.varint();
+		}
+		for(const uint32_t s : r.keys) if(s >= relationStrings.s.size()) d.corrupted();
+		for(const uint32_t s : r.vals) if(s >= relationStrings.s.size()) d.corrupted();
+		for(const int32_t s : r.roles_sid) if(s < 0 || (size_t) s >= relationStrings.s.size()) d.corrupted();
+	}
+	if(d.it != d.end) d.corrupted();
+}
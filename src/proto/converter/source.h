@@ -0,0 +1,61 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vec.h"
+
+#include "proto/generated/osm.pb.h"
+
+// The entities of a PBF that the output is made of, kept next to it so that OsmChange diffs are applied
+// to them and the output made again without reading the PBF. The file is delta coded, but not deflated
+// as it is read and written by each update.
+struct SourceIndex {
+	Box<vec2i> bbox; // of the header of the PBF, empty if it has none
+	std::vector<std::pair<int64_t, vec2i>> nodes; // all nodes, by increasing id
+	struct Capital {
+		int64_t id;
+		std::string name;
+	};
+	std::vector<Capital> capitals; // by increasing node id
+	struct Way {
+		int64_t id;
+		uint32_t layer; // in the layers of the rules, Rules::NONE (-1) for ways only kept as members of relations
+		std::vector<int64_t> refs;
+	};
+	std::vector<Way> ways; // by increasing id
+	// Relations producing output by increasing id, with delta coded memids as in PBF,
+	// and their tags and roles indexing relationStrings
+	Proto::StringTable relationStrings;
+	std::vector<Proto::Relation> relations;
+
+	// Throws if the index is corrupted, or if a way is in a layer past the first `layers`
+	void read(const char *fileName, uint32_t layers);
+	void write(const char *fileName) const;
+};
+
+// Apply changes to entries sorted by increasing id: each change adds or replaces the entry of its id,
+// or removes it if it is empty, and the last change of an id is the one that counts
+template<typename T, typename Id>
+void applyChanges(std::vector<T> &entries, std::vector<std::pair<int64_t, std::optional<T>>> &changes, const Id &id) {
+	std::ranges::stable_sort(changes, {}, &std::pair<int64_t, std::optional<T>>::first);
+	std::vector<T> out;
+	out.reserve(entries.size() + changes.size());
+	auto e = entries.begin();
+	for(size_t c = 0; c < changes.size(); ++c) {
+		if(c+1 < changes.size() && changes[c+1].first == changes[c].first) continue;
+		for(; e != entries.end() && id(*e) < changes[c].first; ++e) out.push_back(std::move(*e));
+		if(e != entries.end() && id(*e) == changes[c].first) ++e;
+		if(changes[c].second) out.push_back(std::move(*changes[c].second));
+	}
+	for(; e != entries.end(); ++e) out.push_back(std::move(*e));
+	entries = std::move(out);
+}
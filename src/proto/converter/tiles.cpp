@@ -0,0 +1,235 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "tiles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <ranges>
+#include <span>
+#include <unordered_map>
+
+#include "data/tiles.h"
+#include "polylines.h"
+#include "utils.h"
+
+using namespace std;
+
+static constexpr uint32_t MAX_LEVEL = 20;
+
+// Closed box of a tile: its bounds are shared with its neighbours, so that clipped polylines join
+struct ClipBox {
+	double x0, y0, x1, y1;
+
+	ClipBox(const Box<vec2i> &tile): x0(tile.min.x), y0(tile.min.y), x1(tile.max.x), y1(tile.max.y) {}
+	bool contains(const vec2i &p) const {
+		return x0 <= p.x && p.x <= x1 && y0 <= p.y && p.y <= y1;
+	}
+};
+
+static bool inTile(const Box<vec2i> &tile, const vec2i &p) {
+	return tile.min.x <= p.x && p.x < tile.max.x && tile.min.y <= p.y && p.y < tile.max.y;
+}
+
+// Bounds are integers, so rounding a point of the box stays in the box
+static vec2i lerp(const vec2i &a, const vec2i &b, const double t) {
+	return vec2i(lround(a.x + t * (double(b.x) - a.x)), lround(a.y + t * (double(b.y) - a.y)));
+}
+
+// Part [t0, t1] of segment ab in the box (Liang-Barsky), false if it misses the box
+static bool clipSegment(const ClipBox &box, const vec2i &a, const vec2i &b, double &t0, double &t1) {
+	t0 = 0.;
+	t1 = 1.;
+	const double dx = double(b.x) - a.x, dy = double(b.y) - a.y;
+	const double p[4] = {-dx, dx, -dy, dy};
+	const double q[4] = {a.x - box.x0, box.x1 - a.x, a.y - box.y0, box.y1 - a.y};
+	for(uint32_t i = 0; i < 4; ++i) {
+		if(p[i] == 0.) {
+			if(q[i] < 0.) return false;
+			continue;
+		}
+		const double t = q[i] / p[i];
+		if(p[i] < 0.) {
+			if(t > t1) return false;
+			t0 = max(t0, t);
+		} else {
+			if(t < t0) return false;
+			t1 = min(t1, t);
+		}
+	}
+	return true;
+}
+
+// Pieces of the polyline in the box, appended to the polylines of out
+static void clipPolyline(const ClipBox &box, const vec2i *pts, const uint64_t n, OSMData &out) {
+	bool open = false;
+	const auto close = [&]() {
+		if(open) out.roadOffsets.push_back(out.roads.size());
+		open = false;
+	};
+	for(uint64_t i = 0; i+1 < n; ++i) {
+		double t0, t1;
+		if(!clipSegment(box, pts[i], pts[i+1], t0, t1)) {
+			close();
+			continue;
+		}
+		if(!open || t0 > 0.) {
+			close();
+			out.roads.push_back(t0 > 0. ? lerp(pts[i], pts[i+1], t0) : pts[i]);
+			open = true;
+		}
+		out.roads.push_back(t1 < 1. ? lerp(pts[i], pts[i+1], t1) : pts[i+1]);
+		if(t1 < 1.) close();
+	}
+	close();
+}
+
+// Part of the triangle in the box (Sutherland-Hodgman), as a fan of triangles appended to out.
+// Points of triangles inside the box are shared through `points`, from indices in src.roads to indices in out.roads.
+static void clipTriangle(const ClipBox &box, const OSMData &src, const uint32_t *tri,
+		OSMData &out, unordered_map<uint32_t, uint32_t> &points) {
+	const vec2i &a = src.roads[tri[0]], &b = src.roads[tri[1]], &c = src.roads[tri[2]];
+	if(max({a.x, b.x, c.x}) < box.x0 || min({a.x, b.x, c.x}) > box.x1
+		|| max({a.y, b.y, c.y}) < box.y0 || min({a.y, b.y, c.y}) > box.y1) return;
+	if(box.contains(a) && box.contains(b) && box.contains(c)) {
+		for(uint32_t k = 0; k < 3; ++k) {
+			const auto [it, added] = points.try_emplace(tri[k], out.roads.size());
+			if(added) out.roads.push_back(src.roads[tri[k]]);
+			out.forestIndices.push_back(it->second);
+		}
+		return;
+	}
+	vector<pair<double, double>> poly = {{a.x, a.y}, {b.x, b.y}, {c.x, c.y}}, next;
+	const auto clipSide = [&](const auto &inside, const auto &cross) {
+		next.clear();
+		for(size_t i = 0; i < poly.size(); ++i) {
+			const auto &u = poly[i], &v = poly[(i+1) % poly.size()];
+			if(inside(u)) next.push_back(u);
+			if(inside(u) != inside(v)) next.push_back(cross(u, v));
+		}
+		swap(poly, next);
+	};
+	const auto atX = [](const double x) {
+		return [x](const pair<double, double> &u, const pair<double, double> &v) {
+			return pair(x, u.second + (x - u.first) * (v.second - u.second) / (v.first - u.first));
+		};
+	};
+	const auto atY = [](const double y) {
+		return [y](const pair<double, double> &u, const pair<double, double> &v) {
+			return pair(u.first + (y - u.second) * (v.first - u.first) / (v.second - u.second), y);
+		};
+	};
+	clipSide([&](const auto &u) { return u.first >= box.x0; }, atX(box.x0));
+	clipSide([&](const auto &u) { return u.first <= box.x1; }, atX(box.x1));
+	clipSide([&](const auto &u) { return u.second >= box.y0; }, atY(box.y0));
+	clipSide([&](const auto &u) { return u.second <= box.y1; }, atY(box.y1));
+	if(poly.size() < 3) return;
+	const uint32_t first = out.roads.size();
+	for(const auto &[x, y] : poly) out.roads.emplace_back(lround(x), lround(y));
+	for(uint32_t k = 1; k+1 < poly.size(); ++k)
+		out.forestIndices.insert(out.forestIndices.end(), {first, first + k, first + k+1});
+}
+
+static void clipLabels(const Box<vec2i> &tile, const OSMData &src, const vector<pair<vec2i, uint32_t>> &labels,
+		OSMData &out, vector<pair<vec2i, uint32_t>> &outLabels, unordered_map<uint32_t, uint32_t> &names) {
+	for(const auto &[p, id] : labels) {
+		if(!inTile(tile, p)) continue;
+		const auto [it, added] = names.try_emplace(id, out.names.size());
+		if(added) out.names.insert(out.names.end(), src.names.begin() + id, src.names.begin() + id + strlen(src.names.data() + id) + 1);
+		outLabels.emplace_back(p, it->second);
+	}
+}
+
+// Part of src in the tile: the polylines of its layers, the triangles of its areas, whose points
+// come after the polylines, and its labels. Levels of detail are left out.
+static OSMData clip(const OSMData &src, const Box<vec2i> &tile) {
+	OSMData out;
+	out.bbox.min = tile.min;
+	out.bbox.max = tile.max - vec2i(1, 1);
+	const ClipBox box(tile);
+
+	const uint32_t P = src.boundaries.second;
+	vector<uint32_t> firsts(P+1);
+	out.roadOffsets.assign(1, 0);
+	for(uint32_t i = 0; i < P; ++i) {
+		firsts[i] = out.roadOffsets.size()-1;
+		clipPolyline(box, src.roads.data() + src.roadOffsets[i], src.roadOffsets[i+1] - src.roadOffsets[i], out);
+	}
+	firsts[P] = out.roadOffsets.size()-1;
+	ranges::transform(src.roadTypeOffsets, out.roadTypeOffsets.begin(), [&](const uint32_t i) { return firsts[i]; });
+	ranges::transform(src.waterWayTypeOffsets, out.waterWayTypeOffsets.begin(), [&](const uint32_t i) { return firsts[i]; });
+	out.boundaries = {firsts[src.boundaries.first], firsts[P]};
+	out.lodRoadOffsets.assign(1, 0);
+	out.roadChunks = {0, firsts[P]};
+
+	out.refOffsets.assign(1, 0);
+	out.forests = {firsts[P], firsts[P]};
+	out.forestsR = {0, 0};
+	unordered_map<uint32_t, uint32_t> points;
+	for(size_t t = 0; t+2 < src.forestIndices.size(); t += 3)
+		clipTriangle(box, src, src.forestIndices.data() + t, out, points);
+	out.forestLodOffsets.assign(1, 0);
+
+	unordered_map<uint32_t, uint32_t> names;
+	clipLabels(tile, src, src.capitals, out, out.capitals, names);
+	clipLabels(tile, src, src.roadNames, out, out.roadNames, names);
+	return out;
+}
+
+struct TilesBuilder {
+	ostream &out;
+	const uint64_t maxPoints;
+	const bool encode, index;
+	TileSet set;
+	uint32_t leaves = 0, maxLevel = 0;
+
+	void build(const uint32_t tile, OSMData content) {
+		const Box<vec2i> box = set.tiles[tile].bbox;
+		const uint32_t level = set.tiles[tile].level;
+		const int64_t w = int64_t(box.max.x) - box.min.x, h = int64_t(box.max.y) - box.min.y;
+		if(content.roads.size() <= maxPoints || level == MAX_LEVEL || w < 2 || h < 2) {
+			if(index) indexRoads(content);
+			set.writeLeaf(out, tile, content, encode);
+			++ leaves;
+			maxLevel = max(maxLevel, level);
+			return;
+		}
+		const uint32_t first = set.tiles.size();
+		set.tiles[tile].children = first;
+		const vec2i mid(box.min.x + w/2, box.min.y + h/2);
+		for(uint32_t c = 0; c < 4; ++c) {
+			TileSet::Tile &child = set.tiles.emplace_back(TileSet::Tile{{}, TileSet::LEAF, level+1, 0, 0});
+			child.bbox.min = vec2i(c&1 ? mid.x : box.min.x, c&2 ? mid.y : box.min.y);
+			child.bbox.max = vec2i(c&1 ? box.max.x : mid.x, c&2 ? box.max.y : mid.y);
+		}
+		for(uint32_t c = 0; c < 4; ++c) build(first + c, clip(content, set.tiles[first + c].bbox));
+	}
+};
+
+void writeTiles(const OSMData &data, const char *fileName, const uint64_t maxPoints, const bool encode, const bool index) {
+	const auto startTime = chrono::steady_clock::now();
+	// The root contains everything that is tiled, which may go beyond the bounding box of the header
+	Box<vec2i> bbox = data.bbox;
+	for(const vec2i &p : span(data.roads.data(), data.roadOffsets[data.boundaries.second])) bbox.update(p);
+	for(const uint32_t i : data.forestIndices) bbox.update(data.roads[i]);
+	for(const auto &labels : {&data.capitals, &data.roadNames})
+		for(const vec2i &p : *labels | views::keys) bbox.update(p);
+	if(bbox.min.x > bbox.max.x || bbox.min.y > bbox.max.y) THROW_ERROR("Nothing to tile");
+	ofstream file(fileName, ios::binary);
+	TileSet::writeHeader(file);
+	TilesBuilder builder{file, maxPoints, encode, index, {}};
+	TileSet::Tile &root = builder.set.tiles.emplace_back(TileSet::Tile{{}, TileSet::LEAF, 0, 0, 0});
+	root.bbox.min = bbox.min;
+	root.bbox.max = bbox.max + vec2i(1, 1);
+	builder.build(0, clip(data, root.bbox));
+	const uint64_t bytes = uint64_t(file.tellp()) + builder.set.tiles.size() * sizeof(TileSet::Tile);
+	builder.set.writeDirectory(file);
+	if(!file) THROW_ERROR("Failed to write " + string(fileName));
+	cout << "Tiles: " << builder.set.tiles.size() << " tiles, " << builder.leaves << " leaves up to level " << builder.maxLevel
+		<< ", " << bytes << " bytes, in " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s" << endl;
+}
@@ -0,0 +1,14 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+
+#include "data/data.h"
+
+// Write data as a quadtree of tiles (see data/tiles.h): a tile is split in 4 while it has more than
+// maxPoints points. Polylines and triangles of areas are clipped to the tiles, labels go to the tile
+// containing them. Tiles have no levels of detail. With `index`, leaves have the indexed layout of indexRoads.
+void writeTiles(const OSMData &data, const char *fileName, uint64_t maxPoints, bool encode, bool index);
@@ -0,0 +1,1657 @@
+#include "osm.pb.h"
+
+#include "proto_common.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+namespace Proto {
+
+BlobHeader::BlobHeader(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__type = false;
+	bool __required__datasize = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: type
+			__required__type = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading BlobHeader.type (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in BlobHeader.type is too long...\n";
+				exit(1);
+			}
+			type.assign(it, it + len);
+			it += len;
+			break;
+		}
+		case 2: { // field: indexdata
+			_has_indexdata = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading BlobHeader.indexdata (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in BlobHeader.indexdata is too long...\n";
+				exit(1);
+			}
+			indexdata.assign(it, it + len);
+			it += len;
+			break;
+		}
+		case 3: { // field: datasize
+			__required__datasize = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading BlobHeader.datasize (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			datasize = readInt32(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading BlobHeader wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__type) {
+		cerr << "Field BlobHeader.type required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__datasize) {
+		cerr << "Field BlobHeader.datasize required and not present in wire...";
+		exit(1);
+	}
+}
+
+void BlobHeader::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 2);
+		writeBytes(wire, type);
+	}
+	if(_has_indexdata) {
+		writeKey(wire, 2, 2);
+		writeBytes(wire, indexdata);
+	}
+	{
+		writeKey(wire, 3, 0);
+		writeInt64(wire, int64_t(datasize));
+	}
+}
+
+void destroy_Blob_data(Blob &x) {
+	switch(x._data_choice) {
+	case Blob::DATA_RAW:
+		x.data.raw.~vector<uint8_t>();
+		break;
+	case Blob::DATA_ZLIB_DATA:
+		x.data.zlib_data.~vector<uint8_t>();
+		break;
+	case Blob::DATA_LZMA_DATA:
+		x.data.lzma_data.~vector<uint8_t>();
+		break;
+	case Blob::DATA_LZ4_DATA:
+		x.data.lz4_data.~vector<uint8_t>();
+		break;
+	case Blob::DATA_ZSTD_DATA:
+		x.data.zstd_data.~vector<uint8_t>();
+		break;
+	default:
+		break;
+	}
+	x._data_choice = Blob::_DATA_NONE;
+}
+
+Blob::Blob(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 2: { // field: raw_size
+			_has_raw_size = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Blob.raw_size (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			raw_size = readInt32(it);
+			break;
+		}
+		case 1: { // field: data.raw
+			destroy_Blob_data(*this);
+			_data_choice = DATA_RAW;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Blob.data.raw (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in Blob.data.raw is too long...\n";
+				exit(1);
+			}
+			new(&data.raw) std::vector<uint8_t>(it, it + len);
+			it += len;
+			break;
+		}
+		case 3: { // field: data.zlib_data
+			destroy_Blob_data(*this);
+			_data_choice = DATA_ZLIB_DATA;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Blob.data.zlib_data (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in Blob.data.zlib_data is too long...\n";
+				exit(1);
+			}
+			new(&data.zlib_data) std::vector<uint8_t>(it, it + len);
+			it += len;
+			break;
+		}
+		case 4: { // field: data.lzma_data
+			destroy_Blob_data(*this);
+			_data_choice = DATA_LZMA_DATA;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Blob.data.lzma_data (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in Blob.data.lzma_data is too long...\n";
+				exit(1);
+			}
+			new(&data.lzma_data) std::vector<uint8_t>(it, it + len);
+			it += len;
+			break;
+		}
+		case 6: { // field: data.lz4_data
+			destroy_Blob_data(*this);
+			_data_choice = DATA_LZ4_DATA;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Blob.data.lz4_data (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in Blob.data.lz4_data is too long...\n";
+				exit(1);
+			}
+			new(&data.lz4_data) std::vector<uint8_t>(it, it + len);
+			it += len;
+			break;
+		}
+		case 7: { // field: data.zstd_data
+			destroy_Blob_data(*this);
+			_data_choice = DATA_ZSTD_DATA;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Blob.data.zstd_data (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in Blob.data.zstd_data is too long...\n";
+				exit(1);
+			}
+			new(&data.zstd_data) std::vector<uint8_t>(it, it + len);
+			it += len;
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading Blob wire\n";
+			exit(1);
+		}
+	}
+}
+
+void Blob::write(vector<uint8_t> &wire) const {
+	if(_has_raw_size) {
+		writeKey(wire, 2, 0);
+		writeInt64(wire, int64_t(raw_size));
+	}
+	switch(_data_choice) {
+	case DATA_RAW: {
+		writeKey(wire, 1, 2);
+		writeBytes(wire, data.raw);
+		break;
+	}
+	case DATA_ZLIB_DATA: {
+		writeKey(wire, 3, 2);
+		writeBytes(wire, data.zlib_data);
+		break;
+	}
+	case DATA_LZMA_DATA: {
+		writeKey(wire, 4, 2);
+		writeBytes(wire, data.lzma_data);
+		break;
+	}
+	case DATA_LZ4_DATA: {
+		writeKey(wire, 6, 2);
+		writeBytes(wire, data.lz4_data);
+		break;
+	}
+	case DATA_ZSTD_DATA: {
+		writeKey(wire, 7, 2);
+		writeBytes(wire, data.zstd_data);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+Blob::~Blob() {
+	destroy_Blob_data(*this);
+}
+
+HeaderBBox::HeaderBBox(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__left = false;
+	bool __required__right = false;
+	bool __required__top = false;
+	bool __required__bottom = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: left
+			__required__left = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBBox.left (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			left = readSint64(it);
+			break;
+		}
+		case 2: { // field: right
+			__required__right = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBBox.right (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			right = readSint64(it);
+			break;
+		}
+		case 3: { // field: top
+			__required__top = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBBox.top (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			top = readSint64(it);
+			break;
+		}
+		case 4: { // field: bottom
+			__required__bottom = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBBox.bottom (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			bottom = readSint64(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading HeaderBBox wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__left) {
+		cerr << "Field HeaderBBox.left required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__right) {
+		cerr << "Field HeaderBBox.right required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__top) {
+		cerr << "Field HeaderBBox.top required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__bottom) {
+		cerr << "Field HeaderBBox.bottom required and not present in wire...";
+		exit(1);
+	}
+}
+
+void HeaderBBox::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 0);
+		writeSint64(wire, left);
+	}
+	{
+		writeKey(wire, 2, 0);
+		writeSint64(wire, right);
+	}
+	{
+		writeKey(wire, 3, 0);
+		writeSint64(wire, top);
+	}
+	{
+		writeKey(wire, 4, 0);
+		writeSint64(wire, bottom);
+	}
+}
+
+HeaderBlock::HeaderBlock(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: bbox
+			_has_bbox = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.bbox (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The HeaderBBox stored in HeaderBlock.bbox is too long...\n";
+				exit(1);
+			}
+			bbox = HeaderBBox(span(it, len));
+			it += len;
+			break;
+		}
+		case 4: { // field: required_features
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.required_features (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in HeaderBlock.required_features is too long...\n";
+				exit(1);
+			}
+			required_features.emplace_back(it, it + len);
+			it += len;
+			break;
+		}
+		case 5: { // field: optional_features
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.optional_features (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in HeaderBlock.optional_features is too long...\n";
+				exit(1);
+			}
+			optional_features.emplace_back(it, it + len);
+			it += len;
+			break;
+		}
+		case 16: { // field: writingprogram
+			_has_writingprogram = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.writingprogram (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in HeaderBlock.writingprogram is too long...\n";
+				exit(1);
+			}
+			writingprogram.assign(it, it + len);
+			it += len;
+			break;
+		}
+		case 17: { // field: source
+			_has_source = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.source (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in HeaderBlock.source is too long...\n";
+				exit(1);
+			}
+			source.assign(it, it + len);
+			it += len;
+			break;
+		}
+		case 32: { // field: osmosis_replication_timestamp
+			_has_osmosis_replication_timestamp = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBlock.osmosis_replication_timestamp (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			osmosis_replication_timestamp = readInt64(it);
+			break;
+		}
+		case 33: { // field: osmosis_replication_sequence_number
+			_has_osmosis_replication_sequence_number = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading HeaderBlock.osmosis_replication_sequence_number (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			osmosis_replication_sequence_number = readInt64(it);
+			break;
+		}
+		case 34: { // field: osmosis_replication_base_url
+			_has_osmosis_replication_base_url = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading HeaderBlock.osmosis_replication_base_url (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The string stored in HeaderBlock.osmosis_replication_base_url is too long...\n";
+				exit(1);
+			}
+			osmosis_replication_base_url.assign(it, it + len);
+			it += len;
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading HeaderBlock wire\n";
+			exit(1);
+		}
+	}
+}
+
+void HeaderBlock::write(vector<uint8_t> &wire) const {
+	if(_has_bbox) {
+		writeKey(wire, 1, 2);
+		const std::size_t start = wire.size();
+		bbox.write(wire);
+		writeLength(wire, start);
+	}
+	for(const auto &x : required_features) {
+		writeKey(wire, 4, 2);
+		writeBytes(wire, x);
+	}
+	for(const auto &x : optional_features) {
+		writeKey(wire, 5, 2);
+		writeBytes(wire, x);
+	}
+	if(_has_writingprogram) {
+		writeKey(wire, 16, 2);
+		writeBytes(wire, writingprogram);
+	}
+	if(_has_source) {
+		writeKey(wire, 17, 2);
+		writeBytes(wire, source);
+	}
+	if(_has_osmosis_replication_timestamp) {
+		writeKey(wire, 32, 0);
+		writeInt64(wire, int64_t(osmosis_replication_timestamp));
+	}
+	if(_has_osmosis_replication_sequence_number) {
+		writeKey(wire, 33, 0);
+		writeInt64(wire, int64_t(osmosis_replication_sequence_number));
+	}
+	if(_has_osmosis_replication_base_url) {
+		writeKey(wire, 34, 2);
+		writeBytes(wire, osmosis_replication_base_url);
+	}
+}
+
+StringTable::StringTable(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: s
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading StringTable.s (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The bytes stored in StringTable.s is too long...\n";
+				exit(1);
+			}
+			s.emplace_back(it, it + len);
+			it += len;
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading StringTable wire\n";
+			exit(1);
+		}
+	}
+}
+
+void StringTable::write(vector<uint8_t> &wire) const {
+	for(const auto &x : s) {
+		writeKey(wire, 1, 2);
+		writeBytes(wire, x);
+	}
+}
+
+Info::Info(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: version
+			_has_version = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.version (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			version = readInt32(it);
+			break;
+		}
+		case 2: { // field: timestamp
+			_has_timestamp = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.timestamp (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			timestamp = readInt64(it);
+			break;
+		}
+		case 3: { // field: changeset
+			_has_changeset = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.changeset (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			changeset = readInt64(it);
+			break;
+		}
+		case 4: { // field: uid
+			_has_uid = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.uid (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			uid = readInt32(it);
+			break;
+		}
+		case 5: { // field: user_sid
+			_has_user_sid = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.user_sid (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			user_sid = readInt32(it);
+			break;
+		}
+		case 6: { // field: visible
+			_has_visible = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Info.visible (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			visible = readBool(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading Info wire\n";
+			exit(1);
+		}
+	}
+}
+
+void Info::write(vector<uint8_t> &wire) const {
+	if(_has_version) {
+		writeKey(wire, 1, 0);
+		writeInt64(wire, int64_t(version));
+	}
+	if(_has_timestamp) {
+		writeKey(wire, 2, 0);
+		writeInt64(wire, int64_t(timestamp));
+	}
+	if(_has_changeset) {
+		writeKey(wire, 3, 0);
+		writeInt64(wire, int64_t(changeset));
+	}
+	if(_has_uid) {
+		writeKey(wire, 4, 0);
+		writeInt64(wire, int64_t(uid));
+	}
+	if(_has_user_sid) {
+		writeKey(wire, 5, 0);
+		writeInt64(wire, int64_t(user_sid));
+	}
+	if(_has_visible) {
+		writeKey(wire, 6, 0);
+		writeInt64(wire, int64_t(visible));
+	}
+}
+
+Node::Node(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__id = false;
+	bool __required__lat = false;
+	bool __required__lon = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: id
+			__required__id = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Node.id (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			id = readSint64(it);
+			break;
+		}
+		case 2: { // field: keys
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Node.keys (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Node.keys is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				keys.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 3: { // field: vals
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Node.vals (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Node.vals is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				vals.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 4: { // field: info
+			_has_info = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Node.info (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Info stored in Node.info is too long...\n";
+				exit(1);
+			}
+			info = Info(span(it, len));
+			it += len;
+			break;
+		}
+		case 8: { // field: lat
+			__required__lat = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Node.lat (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			lat = readSint64(it);
+			break;
+		}
+		case 9: { // field: lon
+			__required__lon = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Node.lon (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			lon = readSint64(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading Node wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__id) {
+		cerr << "Field Node.id required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__lat) {
+		cerr << "Field Node.lat required and not present in wire...";
+		exit(1);
+	}
+	if(!__required__lon) {
+		cerr << "Field Node.lon required and not present in wire...";
+		exit(1);
+	}
+}
+
+void Node::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 0);
+		writeSint64(wire, id);
+	}
+	if(!keys.empty()) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : keys) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(!vals.empty()) {
+		writeKey(wire, 3, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : vals) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(_has_info) {
+		writeKey(wire, 4, 2);
+		const std::size_t start = wire.size();
+		info.write(wire);
+		writeLength(wire, start);
+	}
+	{
+		writeKey(wire, 8, 0);
+		writeSint64(wire, lat);
+	}
+	{
+		writeKey(wire, 9, 0);
+		writeSint64(wire, lon);
+	}
+}
+
+DenseInfo::DenseInfo(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: version
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.version (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.version is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				version.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 2: { // field: timestamp
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.timestamp (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.timestamp is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				timestamp.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 3: { // field: changeset
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.changeset (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.changeset is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				changeset.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 4: { // field: uid
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.uid (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.uid is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				uid.push_back(readSint32(it));
+			}
+			break;
+		}
+		case 5: { // field: user_sid
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.user_sid (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.user_sid is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				user_sid.push_back(readSint32(it));
+			}
+			break;
+		}
+		case 6: { // field: visible
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseInfo.visible (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseInfo.visible is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				visible.push_back(readBool(it));
+			}
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading DenseInfo wire\n";
+			exit(1);
+		}
+	}
+}
+
+void DenseInfo::write(vector<uint8_t> &wire) const {
+	if(!version.empty()) {
+		writeKey(wire, 1, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : version) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(!timestamp.empty()) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : timestamp) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!changeset.empty()) {
+		writeKey(wire, 3, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : changeset) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!uid.empty()) {
+		writeKey(wire, 4, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : uid) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!user_sid.empty()) {
+		writeKey(wire, 5, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : user_sid) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!visible.empty()) {
+		writeKey(wire, 6, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : visible) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+}
+
+DenseNodes::DenseNodes(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: id
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseNodes.id (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseNodes.id is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				id.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 5: { // field: denseinfo
+			_has_denseinfo = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseNodes.denseinfo (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The DenseInfo stored in DenseNodes.denseinfo is too long...\n";
+				exit(1);
+			}
+			denseinfo = DenseInfo(span(it, len));
+			it += len;
+			break;
+		}
+		case 8: { // field: lat
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseNodes.lat (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseNodes.lat is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				lat.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 9: { // field: lon
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseNodes.lon (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseNodes.lon is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				lon.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 10: { // field: keys_vals
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading DenseNodes.keys_vals (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in DenseNodes.keys_vals is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				keys_vals.push_back(readInt32(it));
+			}
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading DenseNodes wire\n";
+			exit(1);
+		}
+	}
+}
+
+void DenseNodes::write(vector<uint8_t> &wire) const {
+	if(!id.empty()) {
+		writeKey(wire, 1, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : id) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(_has_denseinfo) {
+		writeKey(wire, 5, 2);
+		const std::size_t start = wire.size();
+		denseinfo.write(wire);
+		writeLength(wire, start);
+	}
+	if(!lat.empty()) {
+		writeKey(wire, 8, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : lat) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!lon.empty()) {
+		writeKey(wire, 9, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : lon) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!keys_vals.empty()) {
+		writeKey(wire, 10, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : keys_vals) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+}
+
+Way::Way(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__id = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: id
+			__required__id = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Way.id (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			id = readInt64(it);
+			break;
+		}
+		case 2: { // field: keys
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.keys (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Way.keys is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				keys.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 3: { // field: vals
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.vals (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Way.vals is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				vals.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 4: { // field: info
+			_has_info = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.info (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Info stored in Way.info is too long...\n";
+				exit(1);
+			}
+			info = Info(span(it, len));
+			it += len;
+			break;
+		}
+		case 8: { // field: refs
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.refs (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Way.refs is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				refs.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 9: { // field: lat
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.lat (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Way.lat is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				lat.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 10: { // field: lon
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Way.lon (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Way.lon is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				lon.push_back(readSint64(it));
+			}
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading Way wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__id) {
+		cerr << "Field Way.id required and not present in wire...";
+		exit(1);
+	}
+}
+
+void Way::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 0);
+		writeInt64(wire, int64_t(id));
+	}
+	if(!keys.empty()) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : keys) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(!vals.empty()) {
+		writeKey(wire, 3, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : vals) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(_has_info) {
+		writeKey(wire, 4, 2);
+		const std::size_t start = wire.size();
+		info.write(wire);
+		writeLength(wire, start);
+	}
+	if(!refs.empty()) {
+		writeKey(wire, 8, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : refs) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!lat.empty()) {
+		writeKey(wire, 9, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : lat) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!lon.empty()) {
+		writeKey(wire, 10, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : lon) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+}
+
+Relation::Relation(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__id = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: id
+			__required__id = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading Relation.id (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			id = readInt64(it);
+			break;
+		}
+		case 2: { // field: keys
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.keys (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Relation.keys is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				keys.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 3: { // field: vals
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.vals (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Relation.vals is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				vals.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 4: { // field: info
+			_has_info = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.info (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Info stored in Relation.info is too long...\n";
+				exit(1);
+			}
+			info = Info(span(it, len));
+			it += len;
+			break;
+		}
+		case 8: { // field: roles_sid
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.roles_sid (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Relation.roles_sid is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				roles_sid.push_back(readInt32(it));
+			}
+			break;
+		}
+		case 9: { // field: memids
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.memids (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Relation.memids is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				memids.push_back(readSint64(it));
+			}
+			break;
+		}
+		case 10: { // field: types
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading Relation.types (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			const uint8_t *it2 = it + len;
+			if(it2 > end_it) {
+				cerr << "The value stored in Relation.types is too long...\n";
+				exit(1);
+			}
+			while(it != it2) {
+				types.push_back((MemberType) readInt32(it));
+			}
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading Relation wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__id) {
+		cerr << "Field Relation.id required and not present in wire...";
+		exit(1);
+	}
+}
+
+void Relation::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 0);
+		writeInt64(wire, int64_t(id));
+	}
+	if(!keys.empty()) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : keys) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(!vals.empty()) {
+		writeKey(wire, 3, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : vals) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(_has_info) {
+		writeKey(wire, 4, 2);
+		const std::size_t start = wire.size();
+		info.write(wire);
+		writeLength(wire, start);
+	}
+	if(!roles_sid.empty()) {
+		writeKey(wire, 8, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : roles_sid) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+	if(!memids.empty()) {
+		writeKey(wire, 9, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : memids) writeSint64(wire, x);
+		writeLength(wire, start);
+	}
+	if(!types.empty()) {
+		writeKey(wire, 10, 2);
+		const std::size_t start = wire.size();
+		for(const auto x : types) writeInt64(wire, int64_t(x));
+		writeLength(wire, start);
+	}
+}
+
+ChangeSet::ChangeSet(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__id = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: id
+			__required__id = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading ChangeSet.id (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			id = readInt64(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading ChangeSet wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__id) {
+		cerr << "Field ChangeSet.id required and not present in wire...";
+		exit(1);
+	}
+}
+
+void ChangeSet::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 0);
+		writeInt64(wire, int64_t(id));
+	}
+}
+
+PrimitiveGroup::PrimitiveGroup(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: nodes
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveGroup.nodes (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Node stored in PrimitiveGroup.nodes is too long...\n";
+				exit(1);
+			}
+			nodes.emplace_back(span(it, len));
+			it += len;
+			break;
+		}
+		case 2: { // field: dense
+			_has_dense = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveGroup.dense (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The DenseNodes stored in PrimitiveGroup.dense is too long...\n";
+				exit(1);
+			}
+			dense = DenseNodes(span(it, len));
+			it += len;
+			break;
+		}
+		case 3: { // field: ways
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveGroup.ways (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Way stored in PrimitiveGroup.ways is too long...\n";
+				exit(1);
+			}
+			ways.emplace_back(span(it, len));
+			it += len;
+			break;
+		}
+		case 4: { // field: relations
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveGroup.relations (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The Relation stored in PrimitiveGroup.relations is too long...\n";
+				exit(1);
+			}
+			relations.emplace_back(span(it, len));
+			it += len;
+			break;
+		}
+		case 5: { // field: changesets
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveGroup.changesets (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The ChangeSet stored in PrimitiveGroup.changesets is too long...\n";
+				exit(1);
+			}
+			changesets.emplace_back(span(it, len));
+			it += len;
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading PrimitiveGroup wire\n";
+			exit(1);
+		}
+	}
+}
+
+void PrimitiveGroup::write(vector<uint8_t> &wire) const {
+	for(const auto &x : nodes) {
+		writeKey(wire, 1, 2);
+		const std::size_t start = wire.size();
+		x.write(wire);
+		writeLength(wire, start);
+	}
+	if(_has_dense) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		dense.write(wire);
+		writeLength(wire, start);
+	}
+	for(const auto &x : ways) {
+		writeKey(wire, 3, 2);
+		const std::size_t start = wire.size();
+		x.write(wire);
+		writeLength(wire, start);
+	}
+	for(const auto &x : relations) {
+		writeKey(wire, 4, 2);
+		const std::size_t start = wire.size();
+		x.write(wire);
+		writeLength(wire, start);
+	}
+	for(const auto &x : changesets) {
+		writeKey(wire, 5, 2);
+		const std::size_t start = wire.size();
+		x.write(wire);
+		writeLength(wire, start);
+	}
+}
+
+PrimitiveBlock::PrimitiveBlock(const span<const uint8_t> &wire) {
+	const uint8_t* it = wire.data();
+	const uint8_t* const end_it = it + wire.size();
+	bool __required__stringtable = false;
+	while(it != end_it) {
+		const uint32_t key = readInt32(it);
+		const uint32_t field_number = key >> 3;
+		const uint32_t wire_type = key & 0x7u;
+		switch(field_number) {
+		case 1: { // field: stringtable
+			__required__stringtable = true;
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.stringtable (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The StringTable stored in PrimitiveBlock.stringtable is too long...\n";
+				exit(1);
+			}
+			stringtable = StringTable(span(it, len));
+			it += len;
+			break;
+		}
+		case 2: { // field: primitivegroup
+			if(wire_type != 2u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.primitivegroup (got " << wire_type << " instead of 2...\n";
+				exit(1);
+			}
+			const uint32_t len = readInt32(it);
+			if(it + len > end_it) {
+				cerr << "The PrimitiveGroup stored in PrimitiveBlock.primitivegroup is too long...\n";
+				exit(1);
+			}
+			primitivegroup.emplace_back(span(it, len));
+			it += len;
+			break;
+		}
+		case 17: { // field: granularity
+			_has_granularity = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.granularity (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			granularity = readInt32(it);
+			break;
+		}
+		case 19: { // field: lat_offset
+			_has_lat_offset = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.lat_offset (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			lat_offset = readInt64(it);
+			break;
+		}
+		case 20: { // field: lon_offset
+			_has_lon_offset = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.lon_offset (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			lon_offset = readInt64(it);
+			break;
+		}
+		case 18: { // field: date_granularity
+			_has_date_granularity = true;
+			if(wire_type != 0u) {
+				cerr << "Bad wire type while reading PrimitiveBlock.date_granularity (got " << wire_type << " instead of 0...\n";
+				exit(1);
+			}
+			date_granularity = readInt32(it);
+			break;
+		}
+		default:
+			cerr << "Bad field number (" << field_number << ") while reading PrimitiveBlock wire\n";
+			exit(1);
+		}
+	}
+	if(!__required__stringtable) {
+		cerr << "Field PrimitiveBlock.stringtable required and not present in wire...";
+		exit(1);
+	}
+}
+
+void PrimitiveBlock::write(vector<uint8_t> &wire) const {
+	{
+		writeKey(wire, 1, 2);
+		const std::size_t start = wire.size();
+		stringtable.write(wire);
+		writeLength(wire, start);
+	}
+	for(const auto &x : primitivegroup) {
+		writeKey(wire, 2, 2);
+		const std::size_t start = wire.size();
+		x.write(wire);
+		writeLength(wire, start);
+	}
+	if(_has_granularity) {
+		writeKey(wire, 17, 0);
+		writeInt64(wire, int64_t(granularity));
+	}
+	if(_has_lat_offset) {
+		writeKey(wire, 19, 0);
+		writeInt64(wire, int64_t(lat_offset));
+	}
+	if(_has_lon_offset) {
+		writeKey(wire, 20, 0);
+		writeInt64(wire, int64_t(lon_offset));
+	}
+	if(_has_date_granularity) {
+		writeKey(wire, 18, 0);
+		writeInt64(wire, int64_t(date_granularity));
+	}
+}
+
+}
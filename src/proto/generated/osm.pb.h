@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <span>
+#include <vector>
+
+namespace Proto {
+
+struct BlobHeader {
+	std::string type;
+	std::vector<uint8_t> indexdata;
+	bool _has_indexdata = false;
+	int32_t datasize;
+
+	BlobHeader() = default;
+	BlobHeader(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct Blob {
+	int32_t raw_size = 0;
+	bool _has_raw_size = false;
+	union __data_t {
+		std::vector<uint8_t> raw;
+		std::vector<uint8_t> zlib_data;
+		std::vector<uint8_t> lzma_data;
+		std::vector<uint8_t> lz4_data;
+		std::vector<uint8_t> zstd_data;
+		__data_t() {}
+		~__data_t() {}
+	} data;
+	enum {
+		DATA_RAW,
+		DATA_ZLIB_DATA,
+		DATA_LZMA_DATA,
+		DATA_LZ4_DATA,
+		DATA_ZSTD_DATA,
+		_DATA_NONE
+	} _data_choice = _DATA_NONE;
+
+	Blob() = default;
+	Blob(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+	~Blob();
+};
+
+struct HeaderBBox {
+	int64_t left;
+	int64_t right;
+	int64_t top;
+	int64_t bottom;
+
+	HeaderBBox() = default;
+	HeaderBBox(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct HeaderBlock {
+	HeaderBBox bbox;
+	bool _has_bbox = false;
+	std::vector<std::string> required_features;
+	std::vector<std::string> optional_features;
+	std::string writingprogram;
+	bool _has_writingprogram = false;
+	std::string source;
+	bool _has_source = false;
+	int64_t osmosis_replication_timestamp = 0;
+	bool _has_osmosis_replication_timestamp = false;
+	int64_t osmosis_replication_sequence_number = 0;
+	bool _has_osmosis_replication_sequence_number = false;
+	std::string osmosis_replication_base_url;
+	bool _has_osmosis_replication_base_url = false;
+
+	HeaderBlock() = default;
+	HeaderBlock(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct StringTable {
+	std::vector<std::vector<uint8_t>> s;
+
+	StringTable() = default;
+	StringTable(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct Info {
+	int32_t version = -1;
+	bool _has_version = false;
+	int64_t timestamp = 0;
+	bool _has_timestamp = false;
+	int64_t changeset = 0;
+	bool _has_changeset = false;
+	int32_t uid = 0;
+	bool _has_uid = false;
+	uint32_t user_sid = 0;
+	bool _has_user_sid = false;
+	bool visible = false;
+	bool _has_visible = false;
+
+	Info() = default;
+	Info(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct Node {
+	int64_t id;
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> vals;
+	Info info;
+	bool _has_info = false;
+	int64_t lat;
+	int64_t lon;
+
+	Node() = default;
+	Node(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct DenseInfo {
+	std::vector<int32_t> version;
+	std::vector<int64_t> timestamp;
+	std::vector<int64_t> changeset;
+	std::vector<int32_t> uid;
+	std::vector<int32_t> user_sid;
+	std::vector<bool> visible;
+
+	DenseInfo() = default;
+	DenseInfo(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct DenseNodes {
+	std::vector<int64_t> id;
+	DenseInfo denseinfo;
+	bool _has_denseinfo = false;
+	std::vector<int64_t> lat;
+	std::vector<int64_t> lon;
+	std::vector<int32_t> keys_vals;
+
+	DenseNodes() = default;
+	DenseNodes(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct Way {
+	int64_t id;
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> vals;
+	Info info;
+	bool _has_info = false;
+	std::vector<int64_t> refs;
+	std::vector<int64_t> lat;
+	std::vector<int64_t> lon;
+
+	Way() = default;
+	Way(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct Relation {
+	enum MemberType : int {
+		NODE = 0,
+		WAY = 1,
+		RELATION = 2,
+	};
+
+	int64_t id;
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> vals;
+	Info info;
+	bool _has_info = false;
+	std::vector<int32_t> roles_sid;
+	std::vector<int64_t> memids;
+	std::vector<MemberType> types;
+
+	Relation() = default;
+	Relation(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct ChangeSet {
+	int64_t id;
+
+	ChangeSet() = default;
+	ChangeSet(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct PrimitiveGroup {
+	std::vector<Node> nodes;
+	DenseNodes dense;
+	bool _has_dense = false;
+	std::vector<Way> ways;
+	std::vector<Relation> relations;
+	std::vector<ChangeSet> changesets;
+
+	PrimitiveGroup() = default;
+	PrimitiveGroup(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+struct PrimitiveBlock {
+	StringTable stringtable;
+	std::vector<PrimitiveGroup> primitivegroup;
+	int32_t granularity = 100;
+	bool _has_granularity = false;
+	int64_t lat_offset = 0;
+	bool _has_lat_offset = false;
+	int64_t lon_offset = 0;
+	bool _has_lon_offset = false;
+	int32_t date_granularity = 1000;
+	bool _has_date_granularity = false;
+
+	PrimitiveBlock() = default;
+	PrimitiveBlock(const std::span<const uint8_t> &wire);
+	// Append the wire of the message
+	void write(std::vector<uint8_t> &wire) const;
+};
+
+}
@@ -63,4 +63,18 @@ uint64_t readInt64(const uint8_t* &it) {
 	return value;
 }
 	
-}
\ No newline at end of file
+void writeInt64(vector<uint8_t> &wire, uint64_t value) {
+	for(; value >= 0x80u; value >>= 7) wire.push_back(uint8_t(value | 0x80u));
+	wire.push_back(uint8_t(value));
+}
+
+void writeLength(vector<uint8_t> &wire, const std::size_t start) {
+	uint8_t length[10];
+	uint8_t *it = length;
+	uint64_t value = wire.size() - start;
+	for(; value >= 0x80u; value >>= 7) *(it++) = uint8_t(value | 0x80u);
+	*(it++) = uint8_t(value);
+	wire.insert(wire.begin() + start, length, it);
+}
+
+}
@@ -2,9 +2,11 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 // See <https://www.gnu.org/licenses/>
 
+#include <cstddef>
 #include <cstdint>
 #include <concepts>
 #include <type_traits> 
+#include <vector>
 
 namespace Proto {
 
@@ -22,4 +24,19 @@ inline int64_t readSint64(const uint8_t* &it) {
 	return decodeZigzag(readInt64(it));
 }
 
+void writeInt64(std::vector<uint8_t> &wire, uint64_t value);
+// Insert before the bytes written since `start` their length, making them a length delimited field
+void writeLength(std::vector<uint8_t> &wire, std::size_t start);
+
+inline void writeKey(std::vector<uint8_t> &wire, uint32_t field_number, uint32_t wire_type) {
+	writeInt64(wire, field_number << 3 | wire_type);
+}
+inline void writeSint64(std::vector<uint8_t> &wire, int64_t value) {
+	writeInt64(wire, uint64_t(value) << 1 ^ uint64_t(value >> 63));
+}
+inline void writeBytes(std::vector<uint8_t> &wire, const auto &bytes) {
+	writeInt64(wire, bytes.size());
+	wire.insert(wire.end(), bytes.begin(), bytes.end());
+}
+
 }
\ No newline at end of file
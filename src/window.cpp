@@ -152,32 +152,58 @@ void Window::start() {
 		glBindVertexArray(VAO);
 		progs.main.use();
 
+		// Coarsest level of detail that is precise enough
+		uint32_t lod = 0;
+		while(lod < lodScales.size() && scale < lodScales[lod]) ++ lod;
+
 		// Render forests
 		if(scale > 26e3f) {
 			// TODO: draw trees icon either with frag shader or with texture
 			progs.main.set_color(0.675f, 0.824f, 0.612f);
-			glDrawElements(GL_TRIANGLES, forestsCount, GL_UNSIGNED_INT, 0);
+			glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(vec2f));
+			glVertexArrayElementBuffer(VAO, EBO);
+			if(lod) {
+				const ForestLod &f = forestLods[lod-1];
+				glDrawElements(GL_TRIANGLES, f.count, GL_UNSIGNED_INT, 0);
+				glVertexArrayVertexBuffer(VAO, 0, VBO, forestLodPointsOffset, sizeof(vec2f));
+				glDrawElements(GL_TRIANGLES, f.aggregatesCount, GL_UNSIGNED_INT, f.aggregatesOffset);
+			} else glDrawElements(GL_TRIANGLES, forestsCount, GL_UNSIGNED_INT, 0);
 		}
 
-		// Render roads
+		// Render roads, chunk by chunk
 		// TODO: rivers should be rendered before road borders
 		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cmdBuffer);
+		const bool indexed = !lod && indexedRoads;
+		const GLintptr commandSize = indexed ? sizeof(DrawElementsCommand) : sizeof(DrawCommand);
+		const auto drawRoad = [&](const Road &r) {
+			for(const Chunk &c : chunks) {
+				const GLsizei first = max(r.first, c.first), end = min(r.first + r.count, c.first + c.count);
+				if(first >= end) continue;
+				glVertexArrayVertexBuffer(VAO, 0, VBO, c.offsets[lod], sizeof(vec2f));
+				const void *commands = (const void*) (lodOffsets[lod] + first * commandSize);
+				if(indexed) {
+					glVertexArrayElementBuffer(VAO, c.EBO);
+					glMultiDrawElementsIndirect(GL_LINE_STRIP, GL_UNSIGNED_INT, commands, end - first, 0);
+				} else glMultiDrawArraysIndirect(GL_LINE_STRIP, commands, end - first, 0);
+			}
+		};
 		glLineWidth(5.f);
 		for(const Road &r : roads | views::reverse) {
 			if(!r.border) continue;
 			progs.main.set_color(r.col2);
-			glMultiDrawArraysIndirect(GL_LINE_STRIP, r.offset, r.count, 0);
+			drawRoad(r);
 		}
 		glLineWidth(3.f);
 		for(const Road &r : roads | views::reverse) {
 			progs.main.set_color(r.col);
-			glMultiDrawArraysIndirect(GL_LINE_STRIP, r.offset, r.count, 0);
+			drawRoad(r);
 		}
 
 		// Render capitals
 		progs.capital.use();
 		glPointSize(12.f);
-		glDrawArrays(GL_POINTS, capitalsFirst, capitalsCount);
+		glVertexArrayVertexBuffer(VAO, 0, VBO, capitalsOffset, sizeof(vec2f));
+		glDrawArrays(GL_POINTS, 0, capitalsCount);
 
 		// Render frames
 		glBindVertexArray(frameVAO);
@@ -21,6 +21,14 @@ struct DrawCommand {
 	GLuint baseInstance;
 };
 
+struct DrawElementsCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
 struct Window {
 	void init(const vec2f &v0, const vec2f &v1);
 	void start();
@@ -36,7 +44,7 @@ struct Window {
 	int height = 600;
 
 	GLuint UBO;
-	GLuint VAO, cmdBuffer;
+	GLuint VAO, VBO, EBO, cmdBuffer;
 	GLuint textVAO, frameVAO;
 	Programs progs;
 	Font::CharPositions capitalFont, roadFont;
@@ -47,14 +55,36 @@ struct Window {
 
 	struct Road {
 		vec3f col, col2;
-		const void* offset;
-		GLsizei count;
+		GLsizei first, count; // commands of the road in each level
 		bool border;
 	};
 	std::vector<Road> roads;
-	GLint capitalsFirst;
+	// Commands of level l of detail start lodOffsets[l] bytes in cmdBuffer, level 0 being full detail,
+	// level l+1 is used while scale is below lodScales[l]
+	std::vector<float> lodScales;
+	std::vector<GLintptr> lodOffsets;
+	// Full detail is drawn with DrawElementsCommand through the EBO of the chunk for the indexed layout, with DrawCommand otherwise
+	bool indexedRoads;
+	// Commands first..first+count of a chunk have their firsts relative to the chunk: its points of level l
+	// start offsets[l] bytes in the VBO, and its indices of the indexed layout are alone in its EBO
+	struct Chunk {
+		GLsizei first, count;
+		std::vector<GLintptr> offsets;
+		GLuint EBO;
+	};
+	std::vector<Chunk> chunks;
+	GLintptr capitalsOffset;
 	GLsizei capitalsCount;
 	GLsizei charactersCount;
 	GLsizei forestsCount;
+	// Forests of level l+1 of detail: the first `count` indices of the EBO and the aggregates of smaller areas,
+	// whose indices are relative to the points starting forestLodPointsOffset bytes in the VBO
+	GLintptr forestLodPointsOffset;
+	struct ForestLod {
+		GLsizei count;
+		const void *aggregatesOffset;
+		GLsizei aggregatesCount;
+	};
+	std::vector<ForestLod> forestLods;
 	GLsizei framesCount;
 };
@@ -0,0 +1,113 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Lookups of the generated perfect hashes against an unordered_map and a binary search over the
+// same words, for hits and for near misses (a word of the set with one character changed, so that
+// the size filter does not reject it). Also checks that the three agree on every query.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "converter/perfect_hash.h"
+
+using namespace std;
+
+struct Table {
+	vector<string> words;
+	vector<uint64_t> pilots;
+	vector<PerfectHash::Entry> entries;
+	PerfectHash hash;
+	unordered_map<string_view, uint32_t> map;
+	vector<pair<string_view, uint32_t>> sorted;
+
+	Table(vector<string> W): words(std::move(W)) {
+		const PerfectHashTables t = buildPerfectHash(words);
+		for(const uint32_t p : t.pilots) pilots.push_back(PerfectHash::mix(p));
+		uint64_t sizes = 0;
+		for(const uint32_t i : t.words) {
+			entries.push_back({words[i].c_str(), (uint32_t) words[i].size(), i});
+			sizes |= PerfectHash::sizeBit(words[i].size());
+		}
+		hash = {t.seed, sizes, pilots, entries};
+		for(uint32_t i = 0; i < words.size(); ++i) {
+			map.emplace(words[i], i);
+			sorted.emplace_back(words[i], i);
+		}
+		ranges::sort(sorted);
+	}
+
+	uint32_t search(const string_view &word) const {
+		const auto it = ranges::lower_bound(sorted, word, {}, [](const pair<string_view, uint32_t> &p) { return p.first; });
+		return it != sorted.end() && it->first == word ? it->second : PerfectHash::NOT_FOUND;
+	}
+};
+
+int main(int argc, char *argv[]) {
+	// Number of passes over the queries, a test run only needs one
+	const int passes = argc > 1 ? atoi(argv[1]) : 2000;
+	mt19937 rng(3);
+	const auto randomWord = [&]() {
+		string w(3 + rng() % 12, ' ');
+		for(char &c : w) c = 'a' + rng() % 26;
+		return w;
+	};
+	bool ok = true;
+	for(const uint32_t N : {13, 150, 1000}) {
+		vector<string> words;
+		while(words.size() < N) {
+			string w = randomWord();
+			if(ranges::find(words, w) == words.end()) words.push_back(std::move(w));
+		}
+		const Table table(words);
+		for(const int misses : {0, 50}) {
+			vector<string> queries;
+			for(int q = 0; q < 2000; ++q) {
+				string w = table.words[rng() % N];
+				if(int(rng() % 100) < misses) {
+					w[rng() % w.size()] = 'A' + rng() % 26;
+					if(table.map.count(w)) continue;
+				}
+				queries.push_back(std::move(w));
+			}
+			for(const string &w : queries) {
+				const uint32_t expected = table.map.count(w) ? table.map.at(w) : PerfectHash::NOT_FOUND;
+				if(table.hash.feed(w) != expected || table.search(w) != expected) {
+					cerr << "Lookups disagree on " << w << " among " << N << " words" << endl;
+					ok = false;
+				}
+			}
+			cout << N << " words, " << misses << "% near misses, ns per lookup:";
+			const auto run = [&](const char *name, auto &&lookup) {
+				uint64_t sink = 0;
+				const auto start = chrono::steady_clock::now();
+				for(int p = 0; p < passes; ++p)
+					for(const string &w : queries) sink += lookup(w);
+				const double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				cout << ' ' << name << ' ' << s / (double(passes) * queries.size()) * 1e9;
+				return sink;
+			};
+			const uint64_t a = run("perfect hash", [&](const string_view &w) { return table.hash.feed(w); });
+			const uint64_t b = run("unordered_map", [&](const string_view &w) {
+				const auto it = table.map.find(w);
+				return it == table.map.end() ? PerfectHash::NOT_FOUND : it->second;
+			});
+			const uint64_t c = run("binary search", [&](const string_view &w) { return table.search(w); });
+			cout << endl;
+			if(a != b || a != c) ok = false;
+		}
+	}
+
+	vector<string> big;
+	for(int i = 0; i < 5000; ++i) big.push_back("word" + to_string(i * 7919));
+	const auto start = chrono::steady_clock::now();
+	buildPerfectHash(big);
+	cout << "Search of a perfect hash of 5000 words: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s" << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Way classification on a synthetic block: the rules compiled by Rules, for rules/ways.rules and for
+// a generated file of hundreds of rules, against the hard-coded chain that ways.rules replaces.
+// Rules must give the layer of a naive evaluation of the file, rule by rule in file order, the chain
+// must agree with ways.rules, and a block that classify() skips must have no way that a rule matches.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "converter/rules.h"
+
+using namespace std;
+
+static constexpr const char* layers[] = {
+	"road.motorway", "road.trunk", "road.primary",
+	"waterway.river",
+	"boundary",
+	"forest",
+};
+
+// Result of the timed runs, for them not to be optimized away
+static volatile uint64_t sink;
+
+static bool isInteger(const string_view s, int64_t &x) {
+	return !s.empty() && from_chars(s.begin(), s.end(), x).ptr == s.end();
+}
+
+// The rules file read as written: each rule in file order, each of its conditions on the tags
+struct NaiveRules {
+	struct Condition {
+		string key;
+		bool any = false, range = false;
+		int64_t min = 0, max = 0;
+		vector<string> values;
+	};
+	struct Rule {
+		uint32_t layer;
+		vector<Condition> conditions;
+	};
+	vector<Rule> rules;
+
+	NaiveRules(const string &fileName) {
+		ifstream file(fileName);
+		string line;
+		while(getline(file, line)) {
+			istringstream tokens(line.substr(0, line.find('#')));
+			string layer, token;
+			if(!(tokens >> layer)) continue;
+			Rule &rule = rules.emplace_back(uint32_t(ranges::find(layers, layer) - begin(layers)));
+			while(tokens >> token) {
+				Condition &c = rule.conditions.emplace_back();
+				c.key = token.substr(0, token.find('='));
+				const string spec = token.substr(token.find('=') + 1);
+				const size_t dots = spec.find("..");
+				c.any = spec == "*";
+				c.range = dots != string::npos && isInteger(string_view(spec).substr(0, dots), c.min)
+					&& isInteger(string_view(spec).substr(dots+2), c.max);
+				for(istringstream values(spec); getline(values, token, '|');) c.values.push_back(token);
+			}
+		}
+	}
+	static bool holds(const Condition &c, const string_view value) {
+		int64_t x;
+		if(c.any) return true;
+		if(c.range) return isInteger(value, x) && c.min <= x && x <= c.max;
+		return ranges::find(c.values, value) != c.values.end();
+	}
+	// Rules whose conditions all hold for the tags, in file order
+	vector<uint32_t> matches(const vector<pair<string_view, string_view>> &tags) const {
+		vector<uint32_t> found;
+		for(uint32_t r = 0; r < rules.size(); ++r) {
+			if(ranges::all_of(rules[r].conditions, [&](const Condition &c) {
+				return ranges::any_of(tags, [&](const auto &tag) { return tag.first == c.key && holds(c, tag.second); });
+			})) found.push_back(r);
+		}
+		return found;
+	}
+	uint32_t match(const vector<pair<string_view, string_view>> &tags) const {
+		const vector<uint32_t> found = matches(tags);
+		return found.empty() ? Rules::NONE : rules[found.front()].layer;
+	}
+	// Whether some rule has all its conditions on keys of the strings, with one of its values for value lists
+	bool mayMatch(const vector<string_view> &strings) const {
+		const auto has = [&](const string_view s) { return ranges::find(strings, s) != strings.end(); };
+		return ranges::any_of(rules, [&](const Rule &rule) {
+			return ranges::all_of(rule.conditions, [&](const Condition &c) {
+				return has(c.key) && (c.any || c.range || ranges::any_of(c.values, has));
+			});
+		});
+	}
+};
+
+// The chain of conditions that rules/ways.rules replaces, on strings classified once per block
+struct HardCoded {
+	enum Key : uint8_t { HIGHWAY, WATERWAY, BOUNDARY, ADMIN_LEVEL, LANDUSE, NATURAL, NO_KEY };
+	enum Value : uint8_t { MOTORWAY, TRUNK, PRIMARY, RIVER, ADMINISTRATIVE, FOREST, WOOD, NO_VALUE };
+	vector<Key> keys;
+	vector<Value> values;
+	vector<bool> isNumber;
+	vector<int64_t> numbers;
+
+	HardCoded(const vector<string_view> &strings) {
+		static const unordered_map<string_view, Key> keyIds {{"highway", HIGHWAY}, {"waterway", WATERWAY},
+			{"boundary", BOUNDARY}, {"admin_level", ADMIN_LEVEL}, {"landuse", LANDUSE}, {"natural", NATURAL}};
+		static const unordered_map<string_view, Value> valueIds {{"motorway", MOTORWAY}, {"trunk", TRUNK},
+			{"primary", PRIMARY}, {"river", RIVER}, {"administrative", ADMINISTRATIVE}, {"forest", FOREST}, {"wood", WOOD}};
+		for(const string_view s : strings) {
+			const auto k = keyIds.find(s);
+			keys.push_back(k == keyIds.end() ? NO_KEY : k->second);
+			const auto v = valueIds.find(s);
+			values.push_back(v == valueIds.end() ? NO_VALUE : v->second);
+			int64_t x = 0;
+			isNumber.push_back(isInteger(s, x));
+			numbers.push_back(x);
+		}
+	}
+	uint32_t match(const uint32_t *k, const uint32_t *v, const uint32_t T) const {
+		Value tag[NO_KEY];
+		fill(tag, tag + NO_KEY, NO_VALUE);
+		int64_t adminLevel = -1;
+		for(uint32_t i = 0; i < T; ++i) {
+			if(keys[k[i]] == ADMIN_LEVEL) adminLevel = isNumber[v[i]] ? numbers[v[i]] : -1;
+			else if(keys[k[i]] != NO_KEY) tag[keys[k[i]]] = values[v[i]];
+		}
+		if(tag[HIGHWAY] == MOTORWAY || tag[HIGHWAY] == TRUNK || tag[HIGHWAY] == PRIMARY) return tag[HIGHWAY] - MOTORWAY;
+		if(tag[WATERWAY] == RIVER) return 3;
+		if(tag[BOUNDARY] == ADMINISTRATIVE && adminLevel >= 0 && adminLevel <= 4) return 4;
+		if(tag[LANDUSE] == FOREST || tag[NATURAL] == WOOD) return 5;
+		return Rules::NONE;
+	}
+};
+
+// Strings of a block and ways of TAGS tags with distinct keys, as key and value string indices
+struct SyntheticBlock {
+	static constexpr uint32_t TAGS = 6;
+	vector<string_view> strings;
+	vector<uint32_t> keys, vals;
+
+	vector<pair<string_view, string_view>> tags(const size_t w) const {
+		vector<pair<string_view, string_view>> t;
+		for(size_t i = w * TAGS; i < (w+1) * TAGS; ++i) t.emplace_back(strings[keys[i]], strings[vals[i]]);
+		return t;
+	}
+	size_t ways() const { return keys.size() / TAGS; }
+};
+
+// Keys and values the rules are about, values of integer keys not all being integers
+static const vector<string> ruleKeys {"highway", "waterway", "boundary", "admin_level", "landuse", "natural",
+	"surface", "oneway", "layer", "maxspeed"};
+static const vector<string> ruleValues {"motorway", "trunk", "primary", "secondary", "residential", "river", "stream",
+	"administrative", "maritime", "forest", "wood", "scrub", "yes", "no", "asphalt", "0", "2", "3", "4", "5", "8", "12",
+	"-1", "4a", "2;4", " 3", "+3", "04", "1..3", "30", "50", "none"};
+// Keys of the other tags of ways, whose values are names
+static const vector<string> otherKeys {"name", "source", "ref", "lanes", "created_by", "note", "width", "lit"};
+
+static SyntheticBlock makeBlock(mt19937 &rng, const uint32_t ways, const double keep, const vector<string> &names) {
+	SyntheticBlock block;
+	block.strings.push_back("");
+	const auto add = [&](const vector<string> &from, vector<uint32_t> &ids) {
+		for(const string &s : from) {
+			if(uniform_real_distribution<>()(rng) >= keep) continue;
+			ids.push_back(block.strings.size());
+			block.strings.push_back(s);
+		}
+	};
+	vector<uint32_t> keys, values, others;
+	add(ruleKeys, keys);
+	add(ruleValues, values);
+	add(otherKeys, others);
+	const uint32_t ruleKeyCount = keys.size();
+	keys.insert(keys.end(), others.begin(), others.end());
+	if(keys.size() < SyntheticBlock::TAGS) return block;
+	// Names, the many strings of a real block that no rule is about
+	const uint32_t first = block.strings.size();
+	for(uint32_t i = 0; i < 40; ++i) block.strings.push_back(names[rng() % names.size()]);
+	vector<uint32_t> order(keys.size());
+	for(uint32_t w = 0; w < ways; ++w) {
+		ranges::iota(order, 0u);
+		ranges::shuffle(order, rng);
+		for(uint32_t t = 0; t < SyntheticBlock::TAGS; ++t) {
+			block.keys.push_back(keys[order[t]]);
+			const bool named = order[t] >= ruleKeyCount || values.empty() || rng() % 5 == 0;
+			block.vals.push_back(named ? first + rng() % 40 : values[rng() % values.size()]);
+		}
+	}
+	return block;
+}
+
+// Rules of 1 to 3 conditions of all kinds, on few keys and values so that rules overlap,
+// followed by those of rules/ways.rules
+static void writeRules(mt19937 &rng, const string &fileName, const string &defaultRules, const uint32_t count) {
+	ofstream file(fileName);
+	for(uint32_t r = 0; r < count; ++r) {
+		file << layers[rng() % size(layers)];
+		for(uint32_t c = 1 + rng() % 3; c--;) {
+			file << ' ' << ruleKeys[rng() % ruleKeys.size()] << '=';
+			const uint32_t kind = rng() % 10;
+			if(kind == 0) file << '*';
+			else if(kind <= 2) {
+				const int a = int(rng() % 14) - 2, b = int(rng() % 14) - 2;
+				file << min(a, b) << ".." << max(a, b);
+			} else {
+				for(uint32_t v = kind <= 4 ? 3 : 1; v--;) {
+					string value;
+					do value = ruleValues[rng() % ruleValues.size()];
+					while(value.find(' ') != string::npos);
+					file << value << (v ? "|" : "");
+				}
+			}
+		}
+		file << '\n';
+	}
+	ifstream in(defaultRules);
+	file << in.rdbuf();
+}
+
+int main(int argc, char *argv[]) {
+	// Number of passes over the block, a test run only needs one
+	const int passes = argc > 1 ? atoi(argv[1]) : 200;
+	mt19937 rng(5);
+	vector<string> names;
+	for(uint32_t i = 0; i < 3000; ++i) names.push_back("Rue " + to_string(rng()));
+	const string defaultFile = RULES_DIR "/ways.rules";
+	const string generatedFile = (filesystem::temp_directory_path() / "osm_bench_rules.rules").string();
+	writeRules(rng, generatedFile, defaultFile, 300);
+	const Rules defaultRules(defaultFile.c_str(), layers), generatedRules(generatedFile.c_str(), layers);
+	const NaiveRules naiveDefault(defaultFile), naiveGenerated(generatedFile);
+	filesystem::remove(generatedFile);
+	if(generatedRules.size() < 300) {
+		cerr << "Only " << generatedRules.size() << " rules generated" << endl;
+		return 1;
+	}
+
+	// Layers of the ways of a block by each way of matching
+	const auto check = [&](const SyntheticBlock &block, const Rules &rules, const NaiveRules &naive,
+			const bool hardCoded, uint32_t &skipped, uint32_t &overlaps) {
+		const TagTable table(block.strings);
+		const Rules::Block rulesBlock = rules.classify(table);
+		const HardCoded chain(block.strings);
+		if(rulesBlock.mayMatch != naive.mayMatch(block.strings)) {
+			cerr << "Blocks that may match differ" << endl;
+			return false;
+		}
+		skipped += !rulesBlock.mayMatch;
+		for(size_t w = 0; w < block.ways(); ++w) {
+			const span<const uint32_t> keys(&block.keys[w * SyntheticBlock::TAGS], SyntheticBlock::TAGS);
+			const span<const uint32_t> vals(&block.vals[w * SyntheticBlock::TAGS], SyntheticBlock::TAGS);
+			const vector<uint32_t> found = naive.matches(block.tags(w));
+			const uint32_t expected = naive.match(block.tags(w));
+			overlaps += found.size() > 1 && naive.rules[found[0]].layer != naive.rules[found[1]].layer;
+			if(!rulesBlock.mayMatch && expected != Rules::NONE) {
+				cerr << "A block skipped by classify() has a way that a rule matches" << endl;
+				return false;
+			}
+			if(rulesBlock.mayMatch && rules.match(rulesBlock, keys, vals) != expected) {
+				cerr << "Way " << w << ": the layers of the rules and of the naive evaluation differ" << endl;
+				return false;
+			}
+			if(hardCoded && chain.match(keys.data(), vals.data(), SyntheticBlock::TAGS) != expected) {
+				cerr << "Way " << w << ": the layers of the hard-coded chain and of ways.rules differ" << endl;
+				return false;
+			}
+		}
+		return true;
+	};
+	// A full block, and blocks with few of the strings that the rules are about, which classify() may skip
+	const SyntheticBlock block = makeBlock(rng, 8000, 1., names);
+	for(const auto &[rules, naive, hardCoded] : {tuple(&defaultRules, &naiveDefault, true), tuple(&generatedRules, &naiveGenerated, false)}) {
+		uint32_t skipped = 0, overlaps = 0;
+		if(!check(block, *rules, *naive, hardCoded, skipped, overlaps)) return 1;
+		for(uint32_t b = 0; b < 400; ++b)
+			if(!check(makeBlock(rng, 50, b % 2 ? 0.6 : 0.3, names), *rules, *naive, hardCoded, skipped, overlaps)) return 1;
+		if(!skipped || skipped == 401 || (!hardCoded && !overlaps)) {
+			cerr << "Blocks do not test skipping and the order of rules: " << skipped << " skipped, " << overlaps << " overlaps" << endl;
+			return 1;
+		}
+	}
+
+	const auto run = [&](const char *name, const auto &classify) {
+		const auto start = chrono::steady_clock::now();
+		for(int p = 0; p < passes; ++p) sink = classify();
+		const double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << name << ": " << double(passes) * block.ways() / s / 1e6 << " Mways/s" << endl;
+	};
+	const auto withRules = [&](const Rules &rules) {
+		return [&]() {
+			const TagTable table(block.strings);
+			const Rules::Block rulesBlock = rules.classify(table);
+			uint64_t sink = 0;
+			for(size_t i = 0; i < block.keys.size(); i += SyntheticBlock::TAGS)
+				sink += rules.match(rulesBlock, span(&block.keys[i], SyntheticBlock::TAGS), span(&block.vals[i], SyntheticBlock::TAGS));
+			return sink;
+		};
+	};
+	run("Hard-coded chain", [&]() {
+		const TagTable table(block.strings); // read for the other tags, as the converter does
+		const HardCoded chain(block.strings);
+		uint64_t sink = table.entries.size();
+		for(size_t i = 0; i < block.keys.size(); i += SyntheticBlock::TAGS)
+			sink += chain.match(&block.keys[i], &block.vals[i], SyntheticBlock::TAGS);
+		return sink;
+	});
+	run("Rules of ways.rules", withRules(defaultRules));
+	run("300 generated rules", withRules(generatedRules));
+	return 0;
+}
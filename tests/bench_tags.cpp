@@ -0,0 +1,78 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Tag reading on a synthetic block: strings classified once per block by a TagTable, as the
+// converter does, against strings classified again for each entity. Both must read the same tags.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "converter/enums/enums.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+	// Number of passes over the block, a test run only needs one
+	const int passes = argc > 1 ? atoi(argv[1]) : 200;
+	mt19937 rng(7);
+	const char *common[] = {"place", "name", "capital", "highway", "source", "building", "surface", "natural",
+		"admin_level", "boundary", "oneway", "city", "yes", "no", "residential", "2", "4", "asphalt", "survey"};
+	vector<string_view> strings {""};
+	for(const char *s : common) strings.push_back(s);
+	vector<string> names;
+	names.reserve(3000); // the views of the strings must stay valid
+	while(strings.size() < 3000) {
+		names.push_back("Rue " + to_string(rng()));
+		strings.push_back(names.back());
+	}
+
+	// 8000 nodes of 6 tags, keys among the common strings and values skewed to them. Capital only gets numbers.
+	constexpr int TAGS = 6;
+	vector<uint32_t> kv;
+	for(int e = 0; e < 8000; ++e) {
+		for(int t = 0; t < TAGS; ++t) {
+			const uint32_t k = 1 + rng() % 11;
+			kv.push_back(k);
+			if(k == 3) kv.push_back(16 + rng() % 2);
+			else kv.push_back(rng() % 4 ? 1 + rng() % size(common) : 1 + rng() % (strings.size()-1));
+		}
+	}
+
+	const auto readBlock = [&](const bool perEntity) {
+		uint64_t sink = 0;
+		const TagTable block(strings);
+		vector<string_view> entityStrings;
+		for(size_t i = 0; i < kv.size(); i += 2*TAGS) {
+			NodeTags tags;
+			if(perEntity) {
+				entityStrings.clear();
+				for(size_t j = i; j < i + 2*TAGS; ++j) entityStrings.push_back(strings[kv[j]]);
+				const TagTable entity(entityStrings);
+				for(uint32_t j = 0; j < 2*TAGS; j += 2) tags.readTag(entity, j, j+1);
+			} else {
+				for(size_t j = i; j < i + 2*TAGS; j += 2) tags.readTag(block, kv[j], kv[j+1]);
+			}
+			sink = sink * 31 + (uint32_t) tags.place + tags.capital + tags.name.size();
+		}
+		return sink;
+	};
+
+	if(readBlock(false) != readBlock(true)) {
+		cerr << "Tags read per block and per entity differ" << endl;
+		return 1;
+	}
+	const auto run = [&](const char *name, const bool perEntity) {
+		const auto start = chrono::steady_clock::now();
+		for(int p = 0; p < passes; ++p) readBlock(perEntity);
+		const double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << name << ": " << double(passes) * kv.size() / 2 / s / 1e6 << " Mtags/s" << endl;
+	};
+	run("Strings classified per block", false);
+	run("Strings classified per entity", true);
+	return 0;
+}
@@ -0,0 +1,288 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "synthetic.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "utils.h"
+
+#include "converter/pbf_writer.h"
+#include "proto/generated/osm.pb.h"
+
+using namespace std;
+
+SyntheticExtract SyntheticExtract::grid(const uint32_t size, const int32_t spacing, const uint32_t wayNodes, const char *highway) {
+	SyntheticExtract e;
+	e.gridSize = size;
+	for(uint32_t i = 0; i < size; ++i) {
+		for(uint32_t j = 0; j < size; ++j) {
+			// Points slightly off the lines, for levels of detail to remove
+			const int32_t jitter = (i * 7 + j * 13) % 5 * (spacing / 50);
+			e.nodes.push_back({e.nodeId(i, j), vec2i(20'000'000 + j * spacing, 480'000'000 + i * spacing + jitter), {}});
+		}
+	}
+	for(const Node &n : e.nodes) e.bbox.update(n.coords);
+	e.nodes[size/2 * size + size/2].tags = {{"place", "city"}, {"capital", "2"}, {"name", "Grid City"}};
+	int64_t id = 0;
+	Relation route {1, {}, {{"type", "route"}, {"route", "road"}, {"network", "FR:N-road"}, {"ref", "N 1"}}};
+	for(uint32_t i = 0; i < size; ++i) {
+		for(uint32_t j = 0; j+1 < size; j += wayNodes-1) {
+			Way &w = e.ways.emplace_back(Way{++id, {}, {{"highway", highway}, {"name", "Row " + to_string(i)}}});
+			for(uint32_t k = j; k < min(size, j + wayNodes); ++k) w.refs.push_back(e.nodeId(i, k));
+			if(i == 1) route.members.push_back({id, 1, ""});
+		}
+	}
+	for(uint32_t j = 2; j < size; j += 4) {
+		Way &w = e.ways.emplace_back(Way{++id, {}, {{"waterway", "river"}}});
+		for(uint32_t i = 0; i < size; ++i) w.refs.push_back(e.nodeId(i, j));
+	}
+	for(uint32_t k = 1; k+1 < size; k += 5) {
+		e.ways.push_back({++id, {e.nodeId(k, k), e.nodeId(k, k+1), e.nodeId(k+1, k+1), e.nodeId(k+1, k), e.nodeId(k, k)},
+			{{"landuse", "forest"}}});
+	}
+	Way &outer = e.ways.emplace_back(Way{++id, {}, {}});
+	const uint32_t i0 = size / 3, j0 = 2 * size / 3;
+	for(uint32_t k = 0; k < 3; ++k) outer.refs.push_back(e.nodeId(i0, j0 + k));
+	for(uint32_t k = 0; k < 3; ++k) outer.refs.push_back(e.nodeId(i0 + k, j0 + 3));
+	for(uint32_t k = 0; k < 3; ++k) outer.refs.push_back(e.nodeId(i0 + 3, j0 + 3 - k));
+	for(uint32_t k = 0; k <= 3; ++k) outer.refs.push_back(e.nodeId(i0 + 3 - k, j0));
+	e.relations.push_back(std::move(route));
+	e.relations.push_back({2, {{id, 1, "outer"}}, {{"type", "multipolygon"}, {"landuse", "forest"}}});
+	return e;
+}
+
+vector<int64_t> SyntheticExtract::addSideRoads(const uint32_t every, const uint32_t wayNodes, const char *highway) {
+	const int32_t spacing = nodes[1].coords.x - nodes[0].coords.x;
+	int64_t lastNode = ranges::max(nodes, {}, &Node::id).id, lastWay = ranges::max(ways, {}, &Way::id).id;
+	vector<int64_t> ends;
+	for(uint32_t i = 0; i+1 < gridSize; ++i) {
+		for(uint32_t j = 1; j+1 < gridSize; j += every) {
+			if(j % (wayNodes-1) == 0) continue;
+			const vec2i p = nodes[nodeId(i, j) - 1].coords;
+			Way &w = ways.emplace_back(Way{++lastWay, {}, {{"highway", highway}}});
+			for(const vec2i d : {vec2i(spacing/4, 3*spacing/4), vec2i(-spacing/5, spacing/2), vec2i(spacing/10, spacing/4)}) {
+				nodes.push_back({++lastNode, p + d, {}});
+				w.refs.push_back(lastNode);
+			}
+			w.refs.push_back(nodeId(i, j));
+			ends.push_back(w.refs.back());
+		}
+	}
+	return ends;
+}
+
+// Strings of a block, each once, index 0 being the empty string as in the files of osmium
+struct StringTableBuilder {
+	Proto::StringTable table;
+	unordered_map<string, uint32_t> ids;
+
+	StringTableBuilder() {
+		(*this)("");
+	}
+	uint32_t operator()(const string &s) {
+		const auto [it, added] = ids.try_emplace(s, table.s.size());
+		if(added) table.s.emplace_back(s.begin(), s.end());
+		return it->second;
+	}
+};
+
+void SyntheticExtract::writePBF(const string &fileName, const uint32_t perBlock, const bool sorted) const {
+	ofstream out(fileName, ios::binary);
+	const auto writeBlob = [&](const string_view type, const vector<uint8_t> &data) {
+		const vector<uint8_t> blob = encodeBlob(type, data);
+		out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+	};
+
+	Proto::HeaderBlock header;
+	header._has_bbox = true;
+	header.bbox.left = int64_t(bbox.min.x) * 100;
+	header.bbox.right = int64_t(bbox.max.x) * 100;
+	header.bbox.bottom = int64_t(bbox.min.y) * 100;
+	header.bbox.top = int64_t(bbox.max.y) * 100;
+	header.required_features = {"OsmSchema-V0.6", "DenseNodes"};
+	if(sorted) header.optional_features = {"Sort.Type_then_ID"};
+	vector<uint8_t> data;
+	header.write(data);
+	writeBlob("OSMHeader", data);
+
+	vector<vector<uint8_t>> blocks;
+	const auto writeBlocks = [&]<typename T>(const vector<T> &entities, const auto &fill) {
+		vector<const T*> byId;
+		for(const T &e : entities) byId.push_back(&e);
+		ranges::sort(byId, {}, [](const T *e) { return e->id; });
+		for(size_t first = 0; first < byId.size(); first += perBlock) {
+			StringTableBuilder strings;
+			Proto::PrimitiveBlock block;
+			Proto::PrimitiveGroup &group = block.primitivegroup.emplace_back();
+			for(size_t k = first; k < min(byId.size(), first + perBlock); ++k) fill(*byId[k], group, strings);
+			block.stringtable = std::move(strings.table);
+			block.write(blocks.emplace_back());
+		}
+	};
+	int64_t lastId = 0, lastLat = 0, lastLon = 0;
+	writeBlocks(nodes, [&](const Node &n, Proto::PrimitiveGroup &group, StringTableBuilder &strings) {
+		Proto::DenseNodes &dense = group.dense;
+		if(!group._has_dense) lastId = lastLat = lastLon = 0;
+		group._has_dense = true;
+		dense.id.push_back(n.id - lastId);
+		dense.lat.push_back(n.coords.y - lastLat);
+		dense.lon.push_back(n.coords.x - lastLon);
+		lastId = n.id;
+		lastLat = n.coords.y;
+		lastLon = n.coords.x;
+		for(const auto &[k, v] : n.tags) dense.keys_vals.insert(dense.keys_vals.end(), {(int32_t) strings(k), (int32_t) strings(v)});
+		dense.keys_vals.push_back(0);
+	});
+	const auto addTags = [](const Tags &tags, auto &entity, StringTableBuilder &strings) {
+		for(const auto &[k, v] : tags) {
+			entity.keys.push_back(strings(k));
+			entity.vals.push_back(strings(v));
+		}
+	};
+	writeBlocks(ways, [&](const Way &w, Proto::PrimitiveGroup &group, StringTableBuilder &strings) {
+		Proto::Way &way = group.ways.emplace_back();
+		way.id = w.id;
+		addTags(w.tags, way, strings);
+		int64_t last = 0;
+		for(const int64_t ref : w.refs) {
+			way.refs.push_back(ref - last);
+			last = ref;
+		}
+	});
+	writeBlocks(relations, [&](const Relation &r, Proto::PrimitiveGroup &group, StringTableBuilder &strings) {
+		Proto::Relation &relation = group.relations.emplace_back();
+		relation.id = r.id;
+		addTags(r.tags, relation, strings);
+		int64_t last = 0;
+		for(const Member &m : r.members) {
+			relation.memids.push_back(m.id - last);
+			last = m.id;
+			relation.types.push_back((Proto::Relation::MemberType) m.type);
+			relation.roles_sid.push_back(strings(m.role));
+		}
+	});
+	for(size_t k = 0; k < blocks.size(); ++k)
+		writeBlob("OSMData", blocks[sorted ? k : k % 2 ? k / 2 : blocks.size()-1 - k / 2]);
+	out.close();
+	if(!out) THROW_ERROR("Failed to write " + fileName);
+}
+
+static string escape(const string &s) {
+	string out;
+	for(const char c : s) {
+		if(c == '&') out += "&amp;";
+		else if(c == '<') out += "&lt;";
+		else if(c == '>') out += "&gt;";
+		else if(c == '"') out += "&quot;";
+		else out += c;
+	}
+	return out;
+}
+
+// Coordinate in 1e-7 degrees as decimal degrees
+static string degrees(const int32_t x) {
+	const uint32_t a = x < 0 ? -int64_t(x) : x;
+	const string decimals = to_string(a % 10'000'000);
+	return (x < 0 ? "-" : "") + to_string(a / 10'000'000) + '.' + string(7 - decimals.size(), '0') + decimals;
+}
+
+void writeOsmChange(const SyntheticExtract &before, const SyntheticExtract &after, const string &fileName) {
+	ofstream out(fileName);
+	const auto tags = [&](const Tags &t) {
+		for(const auto &[k, v] : t) out << "\t\t\t<tag k=\"" << escape(k) << "\" v=\"" << escape(v) << "\"/>\n";
+	};
+	const auto writeNode = [&](const SyntheticExtract::Node &n) {
+		out << "\t\t<node id=\"" << n.id << "\" version=\"2\" lat=\"" << degrees(n.coords.y) << "\" lon=\"" << degrees(n.coords.x) << "\">\n";
+		tags(n.tags);
+		out << "\t\t</node>\n";
+	};
+	const auto writeWay = [&](const SyntheticExtract::Way &w) {
+		out << "\t\t<way id=\"" << w.id << "\" version=\"2\">\n";
+		for(const int64_t ref : w.refs) out << "\t\t\t<nd ref=\"" << ref << "\"/>\n";
+		tags(w.tags);
+		out << "\t\t</way>\n";
+	};
+	const auto writeRelation = [&](const SyntheticExtract::Relation &r) {
+		out << "\t\t<relation id=\"" << r.id << "\" version=\"2\">\n";
+		for(const SyntheticExtract::Member &m : r.members)
+			out << "\t\t\t<member type=\"" << array{"node", "way", "relation"}[m.type] << "\" ref=\"" << m.id << "\" role=\"" << escape(m.role) << "\"/>\n";
+		tags(r.tags);
+		out << "\t\t</relation>\n";
+	};
+	// Entities of `after` created or modified, and those of `before` deleted
+	const auto diff = [&]<typename T>(const vector<T> &from, const vector<T> &to, const auto &writeEntity, const string_view action) {
+		unordered_map<int64_t, const T*> former;
+		for(const T &e : from) former[e.id] = &e;
+		for(const T &e : to) {
+			const auto it = former.find(e.id);
+			if(action == "create" ? it == former.end() : action == "modify" && it != former.end() && !(*it->second == e)) writeEntity(e);
+		}
+	};
+	const auto deleted = [&]<typename T>(const vector<T> &from, const vector<T> &to, const char *name) {
+		unordered_map<int64_t, const T*> remaining;
+		for(const T &e : to) remaining[e.id] = &e;
+		for(const T &e : from)
+			if(!remaining.count(e.id)) out << "\t\t<" << name << " id=\"" << e.id << "\" version=\"2\"/>\n";
+	};
+	out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<osmChange version=\"0.6\" generator=\"tests\">\n";
+	for(const string_view action : {"create", "modify"}) {
+		out << "\t<" << action << ">\n";
+		diff(before.nodes, after.nodes, writeNode, action);
+		diff(before.ways, after.ways, writeWay, action);
+		diff(before.relations, after.relations, writeRelation, action);
+		out << "\t</" << action << ">\n";
+	}
+	out << "\t<delete>\n";
+	deleted(before.relations, after.relations, "relation");
+	deleted(before.ways, after.ways, "way");
+	deleted(before.nodes, after.nodes, "node");
+	out << "\t</delete>\n</osmChange>\n";
+	out.close();
+	if(!out) THROW_ERROR("Failed to write " + fileName);
+}
+
+bool fail(const string &message) {
+	cerr << message << endl;
+	return false;
+}
+
+int runInTempDir(const string &name, const function<bool(const filesystem::path &dir)> &test) {
+	const filesystem::path dir = filesystem::temp_directory_path() / ("osm_test_" + name);
+	filesystem::remove_all(dir);
+	filesystem::create_directories(dir);
+	const bool ok = test(dir);
+	filesystem::remove_all(dir);
+	if(!ok) return 1;
+	cout << "Test " << name << " OK" << endl;
+	return 0;
+}
+
+int runConverter(const string &converter, const string &arguments) {
+	const string command = "\"" + converter + "\" " + arguments;
+	return system(command.c_str());
+}
+
+bool sameData(const OSMData &a, const OSMData &b, string &difference) {
+	const auto same = [&](const auto &x, const auto &y, const char *name) {
+		if(x == y) return true;
+		difference = string(name) + " differ";
+		return false;
+	};
+	return same(a.roads, b.roads, "roads") && same(a.roadOffsets, b.roadOffsets, "roadOffsets")
+		&& same(a.roadTypeOffsets, b.roadTypeOffsets, "roadTypeOffsets") && same(a.waterWayTypeOffsets, b.waterWayTypeOffsets, "waterWayTypeOffsets")
+		&& same(a.boundaries, b.boundaries, "boundaries") && same(a.lodTolerances, b.lodTolerances, "lodTolerances")
+		&& same(a.lodRoads, b.lodRoads, "lodRoads") && same(a.lodRoadOffsets, b.lodRoadOffsets, "lodRoadOffsets")
+		&& same(a.refs, b.refs, "refs") && same(a.refOffsets, b.refOffsets, "refOffsets")
+		&& same(a.forests, b.forests, "forests") && same(a.forestsR, b.forestsR, "forestsR")
+		&& same(a.forestIndices, b.forestIndices, "forestIndices") && same(a.forestLodCounts, b.forestLodCounts, "forestLodCounts")
+		&& same(a.forestLodPoints, b.forestLodPoints, "forestLodPoints") && same(a.forestLodIndices, b.forestLodIndices, "forestLodIndices")
+		&& same(a.forestLodOffsets, b.forestLodOffsets, "forestLodOffsets") && same(a.names, b.names, "names")
+		&& same(a.capitals, b.capitals, "capitals") && same(a.roadNames, b.roadNames, "roadNames");
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vec.h"
+
+#include "data/data.h"
+
+using Tags = std::vector<std::pair<std::string, std::string>>;
+
+// Small extracts written as .osm.pbf files for the tests, entities sorted by type and then id
+struct SyntheticExtract {
+	struct Node {
+		int64_t id;
+		vec2i coords; // longitude and latitude in 1e-7 degrees
+		Tags tags;
+		bool operator==(const Node&) const = default;
+	};
+	struct Way {
+		int64_t id;
+		std::vector<int64_t> refs;
+		Tags tags;
+		bool operator==(const Way&) const = default;
+	};
+	struct Member {
+		int64_t id;
+		uint32_t type; // 0 node, 1 way, 2 relation
+		std::string role;
+		bool operator==(const Member&) const = default;
+	};
+	struct Relation {
+		int64_t id;
+		std::vector<Member> members;
+		Tags tags;
+		bool operator==(const Relation&) const = default;
+	};
+	std::vector<Node> nodes;
+	std::vector<Way> ways;
+	std::vector<Relation> relations;
+	Box<vec2i> bbox; // of the header, that of the region of the extract
+
+	// Grid of size x size nodes `spacing` apart, with a road of `highway` along every row, cut in ways
+	// of `wayNodes` nodes, a river along every 4th column from the 3rd, a forest in every 5th cell of the
+	// diagonal from the 2nd, a capital in the middle, a forest multipolygon whose outer way goes round
+	// cells size/3..size/3+3 x 2*size/3..2*size/3+3, and a national road route of the ways of row 1
+	static SyntheticExtract grid(uint32_t size, int32_t spacing, uint32_t wayNodes, const char *highway = "primary");
+	int64_t nodeId(uint32_t i, uint32_t j) const { return 1 + int64_t(i) * gridSize + j; }
+	// Side roads of `highway` on a grid, each of 3 new nodes zigzagging from between rows i and i+1 to node (i, j),
+	// for every row but the last and every `every`-th column j from 1 that is not an end of a row way of `wayNodes`
+	// nodes, so that the side roads end inside row ways. Returns the nodes where they end.
+	std::vector<int64_t> addSideRoads(uint32_t every, uint32_t wayNodes, const char *highway = "primary");
+
+	// At most `perBlock` entities in each block. Unless `sorted`, the header does not have the Sort.Type_then_ID
+	// feature and blocks are taken alternately from the end and from the start, mixing the types of entities.
+	void writePBF(const std::string &fileName, uint32_t perBlock = 8000, bool sorted = true) const;
+
+	uint32_t gridSize = 0;
+};
+
+// OsmChange file making `after` from `before`
+void writeOsmChange(const SyntheticExtract &before, const SyntheticExtract &after, const std::string &fileName);
+
+// Print the message to the error output, returns false for the tests to return it
+bool fail(const std::string &message);
+
+// Run `test` on a new directory osm_test_<name> of the temporary directory, removed afterwards.
+// Returns the exit status of the test program, printing that the test passed if it did.
+int runInTempDir(const std::string &name, const std::function<bool(const std::filesystem::path &dir)> &test);
+
+// Run the converter with its arguments, the output going to the test log. Returns its exit status.
+int runConverter(const std::string &converter, const std::string &arguments);
+
+// Whether the polylines, areas and labels of a and b are the same, with a message about the first difference
+bool sameData(const OSMData &a, const OSMData &b, std::string &difference);
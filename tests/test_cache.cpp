@@ -0,0 +1,93 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Conversions of a synthetic extract through the entity cache of --cache: the first one writes the cache,
+// the next ones read it, with the default rules and with other rules, and each must give the same file as
+// the conversion of the PBF with the same rules. A PBF touched or changed makes the cache stale: it must
+// be written again, and the conversion must be that of the changed PBF.
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "synthetic.h"
+
+#include "converter/cache.h"
+
+using namespace std;
+
+static string readFile(const filesystem::path &file) {
+	ifstream in(file, ios::binary);
+	ostringstream content;
+	content << in.rdbuf();
+	return content.str();
+}
+
+static bool test(const string &converter, const filesystem::path &dir) {
+	SyntheticExtract extract = SyntheticExtract::grid(30, 10'000, 6);
+	const filesystem::path pbf = dir / "grid.osm.pbf", cache = dir / "grid.cache", rules = dir / "other.rules";
+	extract.writePBF(pbf.string(), 300);
+	// Rows are trunk roads and forests are not kept
+	ofstream(rules) << "road.trunk highway=primary\nwaterway.river waterway=river\n";
+	const auto stamp = [&] {
+		return pair(filesystem::file_size(pbf), filesystem::last_write_time(pbf).time_since_epoch().count());
+	};
+
+	// Each conversion through the cache, with its arguments and whether it must read the cache or write it
+	struct Conversion {
+		const char *name, *arguments;
+		bool readsCache;
+	};
+	const Conversion conversions[] {
+		{"Written cache", "", false},
+		{"Read cache", "", true},
+		{"Read cache with other rules", " --rules \"{rules}\"", true},
+		{"Touched PBF", "", false},
+		{"Changed PBF", "", false},
+	};
+	string former;
+	for(const Conversion &conversion : conversions) {
+		const string name = conversion.name;
+		string arguments = conversion.arguments;
+		if(const size_t r = arguments.find("{rules}"); r != string::npos) arguments.replace(r, 7, rules.string());
+		if(name == "Touched PBF") {
+			filesystem::last_write_time(pbf, filesystem::last_write_time(pbf) + chrono::seconds(10));
+		} else if(name == "Changed PBF") {
+			// Written later than the cache, even where file times are coarse
+			extract.nodes[extract.nodeId(5, 3) - 1].coords.y += 300;
+			const auto time = filesystem::last_write_time(pbf);
+			extract.writePBF(pbf.string(), 300);
+			filesystem::last_write_time(pbf, time + chrono::seconds(10));
+		}
+		const auto [size, time] = stamp();
+		if(!former.empty() && EntityCacheView::matches(cache.c_str(), size, time) != conversion.readsCache)
+			return fail(name + ": the cache is " + (conversion.readsCache ? "stale" : "not stale"));
+
+		const filesystem::path plain = dir / "plain.bin", cached = dir / "cached.bin", log = dir / "cached.log";
+		if(runConverter(converter, arguments + " \"" + pbf.string() + "\" \"" + plain.string() + "\" > \"" + (dir / "plain.log").string() + "\"")
+				|| runConverter(converter, arguments + " --cache \"" + cache.string() + "\" \"" + pbf.string() + "\" \"" + cached.string() + "\" > \"" + log.string() + "\""))
+			return fail(name + ": conversion failed");
+		const string message = conversion.readsCache ? "Entities read from" : "Entity cache written to";
+		if(readFile(log).find(message) == string::npos)
+			return fail(name + ": expected \"" + message + "\" in the output of the conversion");
+		if(!EntityCacheView::matches(cache.c_str(), size, time)) return fail(name + ": the cache does not match the PBF");
+		if(readFile(plain) != readFile(cached)) return fail(name + ": the conversions with and without the cache differ");
+		// The file must change with the rules and with the PBF, or the conversion would not tell a stale cache
+		const string output = readFile(cached);
+		if(output == former && (!arguments.empty() || name == "Changed PBF")) return fail(name + ": the output did not change");
+		former = output;
+		cout << name << ": OK" << endl;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter" << endl;
+		return 1;
+	}
+	return runInTempDir("cache", [&](const filesystem::path &dir) { return test(argv[1], dir); });
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Chunks of polylines on a synthetic extract converted with a small --chunk-vertices: the chunks must
+// cover the polylines in order, each with at most that many points and as many as fit, the rest of the
+// output must be the same as without chunks, and the mapped view must read what the file holds.
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <ranges>
+
+#include "synthetic.h"
+
+using namespace std;
+
+static bool checkChunks(const OSMData &data, const uint64_t chunkVertices) {
+	const vector<uint32_t> &chunks = data.roadChunks;
+	const uint32_t polylines = data.roadOffsets.size()-1;
+	if(chunks.size() < 2 || chunks.front() != 0 || chunks.back() != polylines)
+		return fail("Chunks do not span the " + to_string(polylines) + " polylines");
+	for(uint32_t c = 0; c+1 < chunks.size(); ++c) {
+		if(chunks[c] >= chunks[c+1]) return fail("Chunk " + to_string(c) + " is empty");
+		const uint64_t points = data.roadOffsets[chunks[c+1]] - data.roadOffsets[chunks[c]];
+		if(points > chunkVertices) return fail("Chunk " + to_string(c) + " has " + to_string(points) + " points");
+		// The next polyline starts a new chunk only if it does not fit in this one
+		if(c+2 < chunks.size() && data.roadOffsets[chunks[c+1]+1] - data.roadOffsets[chunks[c]] <= chunkVertices)
+			return fail("Chunk " + to_string(c) + " ends before its last fitting polyline");
+	}
+	return true;
+}
+
+static bool test(const string &converter, const filesystem::path &dir) {
+	constexpr uint64_t CHUNK_VERTICES = 150;
+	const SyntheticExtract extract = SyntheticExtract::grid(60, 10'000, 7);
+	const string pbf = (dir / "grid.osm.pbf").string();
+	extract.writePBF(pbf, 1000);
+	const string whole = (dir / "whole.bin").string(), chunked = (dir / "chunked.bin").string(), encoded = (dir / "encoded.bin").string();
+	const string chunkArg = " --chunk-vertices " + to_string(CHUNK_VERTICES) + " ";
+	if(runConverter(converter, "\"" + pbf + "\" \"" + whole + "\"")
+		|| runConverter(converter, chunkArg + "\"" + pbf + "\" \"" + chunked + "\"")
+		|| runConverter(converter, "--encode-points" + chunkArg + "\"" + pbf + "\" \"" + encoded + "\""))
+		return fail("Conversion failed");
+
+	OSMData a, b, c;
+	a.read(whole.c_str());
+	b.read(chunked.c_str());
+	c.read(encoded.c_str());
+	if(a.roadOffsets.size() < 60 || a.roads.size() < 3600) return fail("Polylines of the grid are missing");
+	if(a.roadChunks != vector<uint32_t>{0, uint32_t(a.roadOffsets.size()-1)}) return fail("Chunks without --chunk-vertices");
+	if(!checkChunks(b, CHUNK_VERTICES)) return false;
+	if(b.roadChunks.size() < 10) return fail("Too few chunks to test: " + to_string(b.roadChunks.size()-1));
+	string difference;
+	if(!sameData(a, b, difference)) return fail("Chunked output: " + difference);
+	if(!sameData(b, c, difference) || b.roadChunks != c.roadChunks) return fail("Encoded output: " + difference);
+
+	const OSMView view(chunked.c_str());
+	if(!ranges::equal(view.roadChunks, b.roadChunks) || !ranges::equal(view.roads, b.roads)
+		|| !ranges::equal(view.roadOffsets, b.roadOffsets) || !ranges::equal(view.lodRoads, b.lodRoads)
+		|| !ranges::equal(view.lodRoadOffsets, b.lodRoadOffsets))
+		return fail("Mapped view differs from the read data");
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter" << endl;
+		return 1;
+	}
+	return runInTempDir("chunks", [&](const filesystem::path &dir) { return test(argv[1], dir); });
+}
@@ -0,0 +1,170 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// EdgeGrid::locate against the crossing test over all the edges it replaces, on random rings of a small
+// lattice, which have many horizontal edges, vertices on the same rows and edges through lattice points,
+// cut in polylines as outer ways are. Points are taken at random around the rings, on their vertices,
+// on the lattice points of their edges, horizontal ones included, and on the rows where bands start.
+// A star of many edges checks the bands of a large grid, and a ring near the limits of the coordinates
+// the products of the crossing test.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "synthetic.h"
+
+#include "converter/edge_grid.h"
+
+using namespace std;
+
+// Location of v with all the edges of the polylines, as before edges were indexed
+static EdgeGrid::Location bruteForce(const vector<vector<vec2i>> &polylines, const vec2i v) {
+	uint32_t winding = 0;
+	for(const vector<vec2i> &pts : polylines) {
+		for(uint32_t i = 1; i < pts.size(); ++i) {
+			vec2i a = pts[i-1], b = pts[i];
+			if(a.y > b.y) swap(a, b);
+			if(v.y < a.y || b.y <= v.y) continue;
+			const int64_t diff = int64_t(v.x-a.x) * (b.y-a.y) - int64_t(b.x-a.x) * (v.y-a.y);
+			if(diff > 0) ++ winding;
+			else if(diff == 0) return EdgeGrid::ON_EDGE;
+		}
+	}
+	return (winding&1) ? EdgeGrid::INSIDE : EdgeGrid::OUTSIDE;
+}
+
+// Rings cut in polylines of 1 to 4 edges, each following the previous one
+static vector<vector<vec2i>> cut(const vector<vector<vec2i>> &rings, mt19937 &rng) {
+	vector<vector<vec2i>> polylines;
+	for(const vector<vec2i> &ring : rings) {
+		for(size_t i = 0; i < ring.size();) {
+			const size_t n = min<size_t>(ring.size() - i, 1 + rng() % 4);
+			vector<vec2i> &p = polylines.emplace_back();
+			for(size_t k = i; k <= i + n; ++k) p.push_back(ring[k % ring.size()]);
+			i += n;
+		}
+	}
+	return polylines;
+}
+
+struct Counts {
+	uint64_t points = 0, located[3] = {}, onHorizontal = 0, onBandStart = 0;
+};
+
+static bool check(const char *name, const vector<vector<vec2i>> &polylines, const vector<vec2i> &points, Counts &counts) {
+	const EdgeGrid grid(polylines);
+	for(const vec2i v : points) {
+		const EdgeGrid::Location expected = bruteForce(polylines, v), found = grid.locate(v);
+		if(found != expected)
+			return fail(string(name) + ": point (" + to_string(v.x) + ", " + to_string(v.y) + ") located " + to_string(found)
+				+ " instead of " + to_string(expected));
+		++ counts.points;
+		++ counts.located[expected];
+		if((int64_t(v.y) - grid.bbox.min.y) % grid.bandHeight == 0) ++ counts.onBandStart;
+	}
+	return true;
+}
+
+// Vertices, lattice points of the edges and points on the rows where bands start, from left of the box to right of it
+static vector<vec2i> specialPoints(const vector<vector<vec2i>> &polylines, mt19937 &rng, Counts &counts) {
+	const EdgeGrid grid(polylines);
+	vector<vec2i> points;
+	for(const vector<vec2i> &pts : polylines) {
+		for(uint32_t i = 1; i < pts.size(); ++i) {
+			const vec2i a = pts[i-1], b = pts[i];
+			const int64_t g = gcd(int64_t(b.x) - a.x, int64_t(b.y) - a.y);
+			const int64_t steps = min<int64_t>(g, 8);
+			for(int64_t s = 0; s <= steps; ++s) {
+				const int64_t t = g ? s * g / steps : 0;
+				points.push_back(a + vec2i((int64_t(b.x) - a.x) / max<int64_t>(g, 1) * t, (int64_t(b.y) - a.y) / max<int64_t>(g, 1) * t));
+				if(a.y == b.y) ++ counts.onHorizontal;
+			}
+		}
+	}
+	const int64_t width = int64_t(grid.bbox.max.x) - grid.bbox.min.x;
+	for(int64_t y = grid.bbox.min.y; y <= grid.bbox.max.y; y += grid.bandHeight) {
+		for(const int64_t dy : {-1, 0, 1}) {
+			for(uint32_t k = 0; k < 4; ++k) {
+				const int64_t x = grid.bbox.min.x - 1 + int64_t(rng() % uint64_t(width + 3));
+				points.emplace_back(x, clamp<int64_t>(y + dy, numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max()));
+			}
+		}
+	}
+	return points;
+}
+
+static vector<vec2i> randomPoints(const Box<vec2i> &box, const int64_t margin, const uint32_t n, mt19937 &rng) {
+	vector<vec2i> points;
+	const uint64_t w = int64_t(box.max.x) - box.min.x + 2*margin + 1, h = int64_t(box.max.y) - box.min.y + 2*margin + 1;
+	for(uint32_t k = 0; k < n; ++k)
+		points.emplace_back(box.min.x - margin + int64_t(rng() % w), box.min.y - margin + int64_t(rng() % h));
+	return points;
+}
+
+static bool test(const uint32_t trials) {
+	mt19937 rng(35);
+	Counts counts;
+	// Random rings, possibly crossing themselves and each other, on a lattice of 13 x 13 points
+	for(uint32_t trial = 0; trial < trials; ++trial) {
+		vector<vector<vec2i>> rings(1 + rng() % 3);
+		for(vector<vec2i> &ring : rings) {
+			ring.resize(3 + rng() % 12);
+			for(vec2i &p : ring) p = vec2i(rng() % 13, rng() % 13);
+			// Axis aligned steps, for horizontal edges and vertices on the same rows
+			if(rng() % 2) for(size_t i = 1; i < ring.size(); i += 2) ring[i].y = ring[i-1].y;
+		}
+		const vector<vector<vec2i>> polylines = cut(rings, rng);
+		Box<vec2i> box;
+		for(const vector<vec2i> &ring : rings) for(const vec2i &p : ring) box.update(p);
+		vector<vec2i> points = specialPoints(polylines, rng, counts);
+		const vector<vec2i> around = randomPoints(box, 2, 40, rng);
+		points.insert(points.end(), around.begin(), around.end());
+		if(!check("Lattice rings", polylines, points, counts)) return false;
+	}
+	// A star of 4000 edges, in ~1000 bands
+	{
+		vector<vec2i> star;
+		for(uint32_t i = 0; i < 4000; ++i) {
+			const double a = 2 * numbers::pi * i / 4000, r = i % 2 ? 1e6 : 4e5 + rng() % 1000;
+			star.emplace_back(lround(r * cos(a)), lround(r * sin(a)));
+		}
+		const vector<vector<vec2i>> polylines = cut({star}, rng);
+		vector<vec2i> points = specialPoints(polylines, rng, counts);
+		Box<vec2i> box;
+		for(const vec2i &p : star) box.update(p);
+		const vector<vec2i> around = randomPoints(box, 1000, 20'000, rng);
+		points.insert(points.end(), around.begin(), around.end());
+		if(!check("Star", polylines, points, counts)) return false;
+	}
+	// A ring spanning the coordinates of the world in 1e-7 degrees
+	{
+		const vector<vec2i> ring {{-1'800'000'000, -850'000'000}, {1'800'000'000, -850'000'000}, {1'799'999'999, 850'000'000},
+			{0, 850'000'000}, {-1'800'000'000, 849'999'999}};
+		const vector<vector<vec2i>> polylines = cut({ring}, rng);
+		vector<vec2i> points = specialPoints(polylines, rng, counts);
+		Box<vec2i> box;
+		for(const vec2i &p : ring) box.update(p);
+		const vector<vec2i> around = randomPoints(box, 10, 1000, rng);
+		points.insert(points.end(), around.begin(), around.end());
+		if(!check("World", polylines, points, counts)) return false;
+	}
+	cout << counts.points << " points: " << counts.located[EdgeGrid::INSIDE] << " inside, " << counts.located[EdgeGrid::OUTSIDE]
+		<< " outside, " << counts.located[EdgeGrid::ON_EDGE] << " on edges, " << counts.onHorizontal << " on horizontal edges, "
+		<< counts.onBandStart << " on the first row of a band" << endl;
+	if(!counts.located[EdgeGrid::INSIDE] || !counts.located[EdgeGrid::OUTSIDE] || !counts.located[EdgeGrid::ON_EDGE]
+			|| !counts.onHorizontal || !counts.onBandStart)
+		return fail("Some kind of points is not tested");
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	const uint32_t trials = argc > 1 ? atoi(argv[1]) : 2000;
+	return runInTempDir("edge_grid", [&](const filesystem::path&) { return test(trials); });
+}
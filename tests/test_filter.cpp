@@ -0,0 +1,95 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Slim PBFs of --filter-pbf, from a sorted and an unsorted synthetic extract with entities the conversion
+// does not use: the slim file must keep only the entities of the grid, its conversion must be the same
+// as that of the whole extract, filtering it again must give the same bytes, and filtering and converting
+// with another number of threads must give the same files.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "synthetic.h"
+
+using namespace std;
+
+static string readFile(const filesystem::path &file) {
+	ifstream in(file, ios::binary);
+	ostringstream content;
+	content << in.rdbuf();
+	return content.str();
+}
+
+// Benches off the ways, buildings and a bus route, none of them in the output
+static void addClutter(SyntheticExtract &e) {
+	int64_t node = e.nodes.size(), way = e.ways.size() + 1000;
+	const vec2i origin = e.nodes.front().coords;
+	for(uint32_t k = 0; k < 200; ++k)
+		e.nodes.push_back({++node, origin + vec2i(3'000 + k * 97, 4'000 + k * 89), {{"amenity", "bench"}}});
+	SyntheticExtract::Relation &bus = e.relations.emplace_back(SyntheticExtract::Relation{10, {}, {{"type", "route"}, {"route", "bus"}}});
+	for(uint32_t k = 0; k < 50; ++k) {
+		const vec2i corner = origin + vec2i(5'000 + k * 1'000, 6'000);
+		for(const vec2i d : {vec2i(0, 0), vec2i(300, 0), vec2i(300, 300), vec2i(0, 300)}) e.nodes.push_back({++node, corner + d, {}});
+		e.ways.push_back({++way, {node-3, node-2, node-1, node, node-3}, {{"building", "yes"}}});
+		bus.members.push_back({way, 1, ""});
+	}
+}
+
+static bool test(const string &converter, const filesystem::path &dir) {
+	const SyntheticExtract grid = SyntheticExtract::grid(30, 10'000, 6);
+	SyntheticExtract extract = grid;
+	addClutter(extract);
+	const auto run = [&](const string &arguments, const char *name) {
+		return !runConverter(converter, arguments + " > \"" + (dir / name).string() + ".log\"");
+	};
+	for(const bool sorted : {true, false}) {
+		const string name = sorted ? "Sorted" : "Unsorted";
+		const filesystem::path pbf = dir / "extract.osm.pbf", slim = dir / "slim.osm.pbf", twice = dir / "twice.osm.pbf";
+		const filesystem::path threads = dir / "threads.osm.pbf", expected = dir / "expected.osm.pbf";
+		const filesystem::path whole = dir / "whole.bin", fromSlim = dir / "slim.bin", onThreads = dir / "threads.bin";
+		const filesystem::path unused = dir / "unused.bin";
+		extract.writePBF(pbf.string(), 300, sorted);
+		grid.writePBF(expected.string(), 300, sorted);
+		if(!run("-j 1 --filter-pbf \"" + slim.string() + "\" \"" + pbf.string() + "\" \"" + whole.string() + "\"", "whole")
+				|| !run("-j 1 \"" + slim.string() + "\" \"" + fromSlim.string() + "\"", "slim")
+				|| !run("-j 1 --filter-pbf \"" + twice.string() + "\" \"" + slim.string() + "\" \"" + unused.string() + "\"", "twice")
+				|| !run("-j 4 --filter-pbf \"" + threads.string() + "\" \"" + pbf.string() + "\" \"" + onThreads.string() + "\"", "threads"))
+			return fail(name + ": conversion failed");
+
+		// The slim file has the entities of the grid, and the conversion does not tell it from the whole extract
+		const string log = readFile(dir / "whole.log");
+		const string kept = "Filtered PBF: " + to_string(grid.nodes.size()) + " nodes, " + to_string(grid.ways.size()) + " ways and "
+			+ to_string(grid.relations.size()) + " relations";
+		if(log.find(kept) == string::npos) return fail(name + ": expected \"" + kept + "\" in the output of the filter");
+		if(filesystem::file_size(slim) >= filesystem::file_size(pbf)) return fail(name + ": the slim file is not smaller");
+		OSMData a, b, c;
+		a.read(whole.c_str());
+		b.read(fromSlim.c_str());
+		string difference;
+		if(!sameData(a, b, difference) || a.roadChunks != b.roadChunks)
+			return fail(name + ": the conversions of the slim file and of the extract differ, " + difference);
+		// Which is also that of the grid alone
+		if(!run("-j 1 \"" + expected.string() + "\" \"" + unused.string() + "\"", "expected"))
+			return fail(name + ": conversion failed");
+		c.read(unused.c_str());
+		if(!sameData(a, c, difference)) return fail(name + ": the conversion of the extract and of the grid differ, " + difference);
+
+		const string bytes = readFile(slim);
+		if(readFile(twice) != bytes) return fail(name + ": filtering the slim file changes it");
+		if(readFile(threads) != bytes) return fail(name + ": filtering on 4 threads gives another file");
+		if(readFile(onThreads) != readFile(whole)) return fail(name + ": converting on 4 threads gives another file");
+		cout << name << ": OK" << endl;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter" << endl;
+		return 1;
+	}
+	return runInTempDir("filter", [&](const filesystem::path &dir) { return test(argv[1], dir); });
+}
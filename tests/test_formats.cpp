@@ -0,0 +1,217 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Files of former versions written byte by byte as their writers laid them out: the former format,
+// the 13 members of the baseline one after the other with arrays preceded by their size on 32 bits,
+// and version 1, a table of 21 sections with offsets stored on 32 bits. OSMData and OSMView must read
+// them as the data they hold, with the members of later versions defaulted. Every truncation of them
+// must be rejected, as must trailing bytes after a file of the former format, while sections ignore them.
+// Offsets of version 1 are widened from 32 bits when read, which is checked up to 2^32-1. Offsets past 2^32,
+// in files of version 2 and later only, stay unverified: they need a file of more than 32 GB of points.
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "synthetic.h"
+#include "utils.h"
+
+using namespace std;
+
+// A member as files of former versions store it, offsets on 32 bits
+struct Member {
+	string bytes;
+	uint64_t count;
+	uint32_t elementSize;
+	bool array;
+};
+
+static void put(string &out, const int32_t x) { out.append(reinterpret_cast<const char*>(&x), sizeof(x)); }
+static void put(string &out, const uint32_t x) { out.append(reinterpret_cast<const char*>(&x), sizeof(x)); }
+static void put(string &out, const uint64_t x) { put(out, uint32_t(x)); }
+static void put(string &out, const char x) { out.push_back(x); }
+static void put(string &out, const vec2i p) { put(out, p.x); put(out, p.y); }
+static void put(string &out, const Box<vec2i> &b) { put(out, b.min); put(out, b.max); }
+template<typename A, typename B>
+static void put(string &out, const pair<A, B> &p) { put(out, p.first); put(out, p.second); }
+template<size_t N>
+static void put(string &out, const array<uint32_t, N> &a) { for(const uint32_t x : a) put(out, x); }
+
+template<typename T>
+static Member member(const T &x) {
+	string bytes;
+	put(bytes, x);
+	return {bytes, 1, uint32_t(bytes.size()), false};
+}
+
+template<typename T>
+static Member member(const vector<T> &v) {
+	string bytes, element;
+	for(const T &x : v) put(bytes, x);
+	put(element, T{});
+	return {bytes, v.size(), uint32_t(element.size()), true};
+}
+
+static string formerFormat(const OSMData &d) {
+	const Member members[] {member(d.bbox), member(d.roads), member(d.roadOffsets), member(d.roadTypeOffsets),
+		member(d.waterWayTypeOffsets), member(d.boundaries), member(d.refs), member(d.refOffsets),
+		member(d.forests), member(d.forestsR), member(d.names), member(d.capitals), member(d.roadNames)};
+	string out;
+	for(const Member &m : members) {
+		if(m.array) put(out, uint32_t(m.count));
+		out += m.bytes;
+	}
+	return out;
+}
+
+// Header, then a section of offset, count, element size and a reserved word for each member,
+// each member at an offset aligned on 64 bytes
+static string version1(const OSMData &d) {
+	const Member members[] {member(d.bbox), member(d.roads), member(d.roadOffsets), member(d.roadTypeOffsets),
+		member(d.waterWayTypeOffsets), member(d.boundaries), member(d.lodTolerances), member(d.lodRoads),
+		member(d.lodRoadOffsets), member(d.refs), member(d.refOffsets), member(d.forests), member(d.forestsR),
+		member(d.forestIndices), member(d.forestLodCounts), member(d.forestLodPoints), member(d.forestLodIndices),
+		member(d.forestLodOffsets), member(d.names), member(d.capitals), member(d.roadNames)};
+	string out = string("OSMDATA") + '\0';
+	put(out, uint32_t(1));
+	put(out, uint32_t(size(members)));
+	const auto align = [](const uint64_t offset) { return (offset + 63) / 64 * 64; };
+	uint64_t offset = out.size() + size(members) * 24;
+	for(const Member &m : members) {
+		offset = align(offset);
+		out.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+		out.append(reinterpret_cast<const char*>(&m.count), sizeof(m.count));
+		put(out, m.elementSize);
+		put(out, uint32_t(0));
+		offset += m.bytes.size();
+	}
+	for(const Member &m : members) {
+		out.resize(align(out.size()), '\0');
+		out += m.bytes;
+	}
+	return out;
+}
+
+template<typename A, typename B>
+static bool same(const A &a, const B &b) {
+	if constexpr(requires { a.size(); }) return ranges::equal(a, b);
+	else return a == b;
+}
+
+#define CHECK(member) if(!same(data.member, expected.member)) return fail(string(what) + ": " #member " differs");
+
+// Whether data, an OSMData or an OSMView, holds the expected data
+template<typename D>
+static bool check(const char *what, const D &data, const OSMData &expected) {
+	CHECK(bbox.min) CHECK(bbox.max)
+	CHECK(roads) CHECK(roadOffsets) CHECK(roadTypeOffsets) CHECK(waterWayTypeOffsets) CHECK(boundaries)
+	CHECK(lodTolerances) CHECK(lodRoads) CHECK(lodRoadOffsets) CHECK(roadChunks) CHECK(roadIndices)
+	CHECK(refs) CHECK(refOffsets) CHECK(forests) CHECK(forestsR)
+	CHECK(forestIndices) CHECK(forestLodCounts) CHECK(forestLodPoints) CHECK(forestLodIndices) CHECK(forestLodOffsets)
+	CHECK(names) CHECK(capitals) CHECK(roadNames)
+	return true;
+}
+
+static void writeFile(const filesystem::path &file, const string &bytes) {
+	ofstream out(file, ios::binary);
+	out.write(bytes.data(), bytes.size());
+}
+
+// Whether the file is read, by OSMData and OSMView, as the expected data, or rejected by both if `expected` is null
+static bool read(const string &name, const filesystem::path &file, const string &bytes, const OSMData *expected) {
+	writeFile(file, bytes);
+	const auto rejected = [&](const auto &read) {
+		try {
+			read();
+		} catch(const OSMError&) {
+			return true;
+		}
+		return false;
+	};
+	OSMData data;
+	if(!expected) {
+		if(!rejected([&] { data.read(file.c_str()); }) || !rejected([&] { OSMView view(file.c_str()); }))
+			return fail(name + " is not rejected");
+		return true;
+	}
+	data.read(file.c_str());
+	const OSMView view(file.c_str());
+	return check((name + " read by OSMData").c_str(), data, *expected) && check((name + " read by OSMView").c_str(), view, *expected);
+}
+
+static bool test(const filesystem::path &dir) {
+	// 3 polylines of 2 points, a road, a river and a boundary, a forest way and a forest relation
+	OSMData v1;
+	v1.bbox.update(vec2i(-10, 20));
+	v1.bbox.update(vec2i(1000, 2000));
+	v1.roads = {{-10, 20}, {30, 40}, {50, 60}, {70, 80}, {90, 100}, {1000, 2000}};
+	v1.roadOffsets = {0, 2, 4, 6};
+	v1.roadTypeOffsets = {0, 0, 0, 1};
+	v1.waterWayTypeOffsets = {1, 2};
+	v1.boundaries = {2, 3};
+	v1.lodTolerances = {100};
+	v1.lodRoads = {{-10, 20}, {30, 40}, {50, 60}, {70, 80}, {90, 100}, {1000, 2000}};
+	v1.lodRoadOffsets = {0, 2, 4, 6};
+	v1.refs = {0, 1, 2};
+	v1.refOffsets = {0, 1, 3};
+	v1.forests = {0, 1};
+	v1.forestsR = {1, 2};
+	v1.forestIndices = {0, 1, 2, 3, 4, 5};
+	v1.forestLodCounts = {3};
+	v1.forestLodPoints = {{1, 2}, {3, 4}, {5, 6}};
+	v1.forestLodIndices = {0, 1, 2};
+	v1.forestLodOffsets = {0, 3};
+	v1.names = {'T', 'o', 'w', 'n', '\0', 'R', 'o', 'a', 'd', '\0'};
+	v1.capitals = {{{50, 60}, 0}};
+	v1.roadNames = {{{70, 80}, 5}};
+	// The former format has no levels of detail nor triangles, which are defaulted when it is read
+	OSMData former = v1;
+	former.lodTolerances = {};
+	former.lodRoads = {};
+	former.lodRoadOffsets = {0};
+	former.forestIndices = {};
+	former.forestLodCounts = {};
+	former.forestLodPoints = {};
+	former.forestLodIndices = {};
+	former.forestLodOffsets = {0};
+	// Files before version 2 are made of one chunk
+	for(OSMData *d : {&v1, &former}) d->roadChunks = {0, 3};
+
+	const string files[] {formerFormat(v1), version1(v1)};
+	const char *names[] {"Former format", "Version 1"};
+	const OSMData *expected[] {&former, &v1};
+	const filesystem::path file = dir / "data.bin";
+	for(uint32_t f = 0; f < 2; ++f) {
+		const string name = names[f];
+		if(!read(name, file, files[f], expected[f])) return false;
+		for(size_t size = 0; size < files[f].size(); ++size)
+			if(!read(name + " truncated to " + to_string(size) + " bytes", file, files[f].substr(0, size), nullptr)) return false;
+		const string trailing = files[f] + string(7, '\1');
+		if(!read(name + " with trailing bytes", file, trailing, f ? expected[f] : nullptr)) return false;
+		cout << name << ": OK" << endl;
+	}
+
+	// Offsets on 32 bits are widened without sign, up to the largest they can hold
+	OSMData wide = v1;
+	wide.roadOffsets = {0, 2, 0x8000'0000, 0xFFFF'FFFF};
+	wide.lodRoadOffsets = {0, 0x7FFF'FFFF, 0x8000'0000, 0xFFFF'FFFF};
+	wide.refOffsets = {0, 0xFFFF'FFFE, 0xFFFF'FFFF};
+	const string wideFile = version1(wide);
+	if(!read("Version 1 with offsets up to 2^32-1", file, wideFile, &wide)) return false;
+	// Only offsets on 32 bits are widened: the element size of roadOffsets, the 3rd section, set to 2 bytes
+	string narrower = wideFile;
+	const uint32_t elementSize = 2;
+	memcpy(narrower.data() + 16 + 2 * 24 + 16, &elementSize, sizeof(elementSize));
+	if(!read("Version 1 with offsets on 16 bits", file, narrower, nullptr)) return false;
+	cout << "Widened offsets: OK" << endl;
+	return true;
+}
+
+int main() {
+	return runInTempDir("formats", test);
+}
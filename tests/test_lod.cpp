@@ -0,0 +1,92 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Levels of detail of a synthetic extract whose rows have side roads ending inside their ways: at every
+// level, each simplified polyline must be a subsequence of its points at full detail, from its first to its
+// last point, each point it drops must be within the tolerance of the level of the segment replacing it,
+// and the points where side roads end must be kept by the rows, so that the side roads stay joined.
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+
+#include "synthetic.h"
+
+using namespace std;
+
+// Squared distance of p to the segment [a, b], computed as the simplification does
+static double dist2(const vec2i &p, const vec2i &a, const vec2i &b) {
+	const double dx = double(b.x) - a.x, dy = double(b.y) - a.y;
+	const double px = double(p.x) - a.x, py = double(p.y) - a.y;
+	const double l2 = dx*dx + dy*dy;
+	const double t = l2 > 0. ? clamp((px*dx + py*dy) / l2, 0., 1.) : 0.;
+	const double ex = px - t*dx, ey = py - t*dy;
+	return ex*ex + ey*ey;
+}
+
+static uint64_t key(const vec2i &p) {
+	return uint64_t(uint32_t(p.x)) << 32 | uint32_t(p.y);
+}
+
+static bool test(const string &converter, const filesystem::path &dir) {
+	// Rows of ways of 7 nodes, nodes off the rows by up to 4'000, more than the tolerance of the first level
+	// and less than that of the second one
+	SyntheticExtract extract = SyntheticExtract::grid(40, 50'000, 7);
+	unordered_set<uint64_t> junctions;
+	for(const int64_t id : extract.addSideRoads(3, 7)) junctions.insert(key(extract.nodes[id-1].coords));
+	const string pbf = (dir / "grid.osm.pbf").string(), bin = (dir / "grid.bin").string();
+	extract.writePBF(pbf, 1000);
+	if(runConverter(converter, "\"" + pbf + "\" \"" + bin + "\" > \"" + (dir / "grid.log").string() + "\""))
+		return fail("Conversion failed");
+	OSMData data;
+	data.read(bin.c_str());
+
+	const uint32_t P = data.boundaries.second;
+	for(uint32_t l = 0; l < data.lodTolerances.size(); ++l) {
+		const double tol2 = double(data.lodTolerances[l]) * data.lodTolerances[l];
+		const string level = "Level " + to_string(l) + ": ";
+		uint64_t dropped = 0, kept = 0;
+		for(uint32_t i = 0; i < P; ++i) {
+			const span<const vec2i> full(data.roads.data() + data.roadOffsets[i], data.roads.data() + data.roadOffsets[i+1]);
+			const span<const vec2i> lod(data.lodRoads.data() + data.lodRoadOffsets[l*P + i], data.lodRoads.data() + data.lodRoadOffsets[l*P + i+1]);
+			const string polyline = level + "polyline " + to_string(i);
+			if(lod.size() < 2 || lod.front() != full.front() || lod.back() != full.back())
+				return fail(polyline + " does not keep its ends");
+			// Points of `full` from the last kept one, the next kept one being lod[k]
+			size_t last = 0, k = 1;
+			for(size_t j = 1; j < full.size(); ++j) {
+				if(k < lod.size() && full[j] == lod[k]) {
+					for(size_t d = last+1; d < j; ++d)
+						if(dist2(full[d], full[last], full[j]) > tol2)
+							return fail(polyline + " drops a point out of the tolerance");
+					dropped += j - last - 1;
+					last = j;
+					++k;
+				} else if(data.roadTypeOffsets[0] <= i && i < data.roadTypeOffsets[(size_t) RoadType::NUM] && junctions.count(key(full[j]))) {
+					return fail(polyline + " drops the end of a side road");
+				}
+			}
+			if(k != lod.size()) return fail(polyline + " is not a subsequence of the polyline at full detail");
+			kept += lod.size();
+		}
+		if(!dropped) return fail(level + "no point is dropped");
+		cout << level << kept << " points kept, " << dropped << " dropped" << endl;
+	}
+	// Every side road ends inside a row, on a point the rows must keep
+	uint64_t inside = 0;
+	for(uint32_t i = data.roadTypeOffsets[0]; i < data.roadTypeOffsets[(size_t) RoadType::NUM]; ++i)
+		for(uint64_t j = data.roadOffsets[i]+1; j+1 < data.roadOffsets[i+1]; ++j)
+			inside += junctions.count(key(data.roads[j]));
+	if(inside != junctions.size()) return fail(to_string(inside) + " side roads end inside rows instead of " + to_string(junctions.size()));
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter" << endl;
+		return 1;
+	}
+	return runInTempDir("lod", [&](const filesystem::path &dir) { return test(argv[1], dir); });
+}
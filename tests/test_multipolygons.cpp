@@ -0,0 +1,247 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Forest multipolygons whose ways are merged into rings: a shuffled ring of many short ways,
+// figure-eights and a clover of rings touching at a node, a ring with members of one node and
+// of no node, an outer with an inner, and a ring that does not close. Each component of the output
+// must be made of the expected rings, its ways following each other from the first node of the first
+// one, the unclosed ring must be skipped, and the triangles must cover the rings with n + 2h - 2 of
+// them for n nodes and h holes. Given a size n, the ring has 2n nodes in ways of 2 or 3 nodes,
+// and the time the converter takes to assemble it is printed, as a benchmark of the merge.
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <random>
+
+#include "synthetic.h"
+
+using namespace std;
+
+// Twice the signed area of a ring of points, the last one not repeated
+static int64_t area2(const vector<vec2i> &ring) {
+	int64_t a = 0;
+	for(size_t i = 0; i < ring.size(); ++i) {
+		const vec2i &p = ring[i], &q = ring[(i+1) % ring.size()];
+		a += int64_t(p.x) * q.y - int64_t(q.x) * p.y;
+	}
+	return a;
+}
+
+// Points of a ring, sorted so that rings are compared whatever their first point and orientation
+static vector<vec2i> sorted(vector<vec2i> ring) {
+	ranges::sort(ring, [](const vec2i &a, const vec2i &b) { return pair(a.x, a.y) < pair(b.x, b.y); });
+	return ring;
+}
+
+struct Builder {
+	SyntheticExtract e;
+	mt19937 rng {13};
+	// Rings of each expected component, the outer one first
+	vector<vector<vector<vec2i>>> components;
+
+	int64_t node(const vec2i p) {
+		e.nodes.push_back({int64_t(e.nodes.size()) + 1, vec2i(20'000'000, 480'000'000) + p, {}});
+		e.bbox.update(e.nodes.back().coords);
+		return e.nodes.back().id;
+	}
+	vec2i coords(const int64_t id) const { return e.nodes[id-1].coords; }
+	int64_t way(vector<int64_t> refs) {
+		e.ways.push_back({int64_t(e.ways.size()) + 1, std::move(refs), {}});
+		return e.ways.back().id;
+	}
+	// Ways of 2 to `maxNodes` nodes along a ring of nodes, from its node `start`, some of them reversed
+	vector<int64_t> split(const vector<int64_t> &ring, const uint32_t start, const uint32_t maxNodes) {
+		vector<int64_t> ways;
+		const uint32_t N = ring.size();
+		for(uint32_t i = 0; i < N;) {
+			const uint32_t n = min(N - i, 1 + uint32_t(rng() % (maxNodes-1)));
+			vector<int64_t> refs;
+			for(uint32_t k = i; k <= i + n; ++k) refs.push_back(ring[(start + k) % N]);
+			if(rng() % 2) ranges::reverse(refs);
+			ways.push_back(way(std::move(refs)));
+			i += n;
+		}
+		return ways;
+	}
+	vector<vec2i> points(const vector<int64_t> &ring) const {
+		vector<vec2i> pts;
+		for(const int64_t id : ring) pts.push_back(coords(id));
+		return pts;
+	}
+	void relation(const vector<pair<int64_t, const char*>> &members) {
+		SyntheticExtract::Relation &r = e.relations.emplace_back(SyntheticExtract::Relation{int64_t(e.relations.size()) + 1, {}, {{"type", "multipolygon"}, {"landuse", "forest"}}});
+		for(const auto &[id, role] : members) r.members.push_back({id, 1, role});
+	}
+};
+
+static void build(Builder &b, const uint32_t ringSize) {
+	// A ring of ways of 2 or 3 nodes around a circle, members shuffled
+	{
+		const uint32_t N = 2 * ringSize;
+		const double R = 5e6;
+		vector<int64_t> ring;
+		for(uint32_t i = 0; i < N; ++i) {
+			const double a = 2 * numbers::pi * i / N;
+			ring.push_back(b.node(vec2i(lround(R * cos(a)), lround(R * sin(a)))));
+		}
+		vector<int64_t> ways = b.split(ring, 0, 3);
+		ranges::shuffle(ways, b.rng);
+		vector<pair<int64_t, const char*>> members;
+		for(const int64_t w : ways) members.emplace_back(w, "outer");
+		b.relation(members);
+		b.components.push_back({b.points(ring)});
+	}
+	// Loops of 4 nodes around a node X, each of them in 3 ways, members starting with a way away from X.
+	// Walking the first ways clockwise, the walk leaves X by another loop, comes back to X before it
+	// closes its ring and splits the ring there.
+	const auto flower = [&](const vec2i center, const vector<double> &angles, const bool clockwise) {
+		const int64_t x = b.node(center);
+		vector<vector<int64_t>> loops;
+		for(const double angle : angles) {
+			const auto at = [&](const double r, const double a) {
+				return b.node(center + vec2i(lround(r * cos(angle + a)), lround(r * sin(angle + a))));
+			};
+			loops.push_back({x, at(60'000, -0.4), at(100'000, 0), at(60'000, 0.4)});
+			b.components.push_back({b.points(loops.back())});
+		}
+		vector<pair<int64_t, const char*>> members;
+		for(const vector<int64_t> &loop : loops) {
+			const int64_t first = clockwise ? b.way({loop[2], loop[1]}) : b.way({loop[1], loop[2]}), second = b.way({loop[2], loop[3], loop[0]}), third = b.way({loop[0], loop[1]});
+			members.emplace(members.begin(), first, "outer");
+			members.emplace_back(second, "outer");
+			members.emplace_back(third, "outer");
+		}
+		b.relation(members);
+	};
+	flower(vec2i(-8'000'000, 0), {0, numbers::pi}, false);
+	flower(vec2i(-8'000'000, 1'000'000), {numbers::pi / 2, -numbers::pi / 2}, true);
+	flower(vec2i(-8'000'000, 2'000'000), {0, 2 * numbers::pi / 3, 4 * numbers::pi / 3}, true);
+	// A ring of 4 ways with members of one node and of no node, which have no edge to merge
+	{
+		vector<int64_t> ring;
+		for(const vec2i p : {vec2i(0, 0), vec2i(50'000, 0), vec2i(50'000, 50'000), vec2i(0, 50'000)})
+			ring.push_back(b.node(vec2i(-8'000'000, 3'000'000) + p));
+		vector<pair<int64_t, const char*>> members {{b.way({ring[0]}), "outer"}, {b.way({}), "outer"}};
+		for(const int64_t w : b.split(ring, 1, 2)) members.emplace_back(w, "outer");
+		members.emplace_back(b.way({ring[2]}), "inner");
+		b.relation(members);
+		b.components.push_back({b.points(ring)});
+	}
+	// A closed outer way with an inner ring of 2 ways
+	{
+		vector<int64_t> outer, inner;
+		for(const vec2i p : {vec2i(0, 0), vec2i(90'000, 0), vec2i(90'000, 90'000), vec2i(0, 90'000)})
+			outer.push_back(b.node(vec2i(-8'000'000, 4'000'000) + p));
+		for(const vec2i p : {vec2i(30'000, 30'000), vec2i(30'000, 60'000), vec2i(60'000, 60'000), vec2i(60'000, 30'000)})
+			inner.push_back(b.node(vec2i(-8'000'000, 4'000'000) + p));
+		vector<int64_t> closed = outer;
+		closed.push_back(outer[0]);
+		vector<pair<int64_t, const char*>> members;
+		for(const int64_t w : b.split(inner, 2, 4)) members.emplace_back(w, "inner");
+		members.emplace_back(b.way(closed), "outer");
+		b.relation(members);
+		b.components.push_back({b.points(outer), b.points(inner)});
+	}
+	// Ways that do not close, the relation is skipped
+	{
+		vector<int64_t> path;
+		for(const vec2i p : {vec2i(0, 0), vec2i(50'000, 0), vec2i(50'000, 50'000), vec2i(0, 50'000)})
+			path.push_back(b.node(vec2i(-8'000'000, 5'000'000) + p));
+		b.relation({{b.way({path[0], path[1]}), "outer"}, {b.way({path[2], path[1]}), "outer"}, {b.way({path[2], path[3]}), "outer"}});
+	}
+}
+
+// Rings of a component of the output, each followed from the first node of its first way
+static bool readRings(const OSMData &data, const uint32_t c, vector<vector<vec2i>> &rings) {
+	const auto polyline = [&](const uint32_t i) {
+		return vector<vec2i>(data.roads.begin() + data.roadOffsets[i], data.roads.begin() + data.roadOffsets[i+1]);
+	};
+	vector<vec2i> *ring = nullptr;
+	for(uint64_t r = data.refOffsets[c]; r < data.refOffsets[c+1]; ++r) {
+		vector<vec2i> pts = polyline(data.refs[r]);
+		if(!ring) {
+			ring = &rings.emplace_back(pts);
+		} else if(pts.front() == ring->back()) {
+			ring->insert(ring->end(), pts.begin()+1, pts.end());
+		} else if(pts.back() == ring->back()) {
+			ring->insert(ring->end(), pts.rbegin()+1, pts.rend());
+		} else return fail("Component " + to_string(c) + ": a way does not follow the previous one");
+		if(ring->size() > 1 && ring->back() == ring->front()) {
+			ring->pop_back();
+			ring = nullptr;
+		}
+	}
+	if(ring) return fail("Component " + to_string(c) + ": a ring is not closed");
+	return true;
+}
+
+static bool test(const string &converter, const filesystem::path &dir, const uint32_t ringSize) {
+	Builder b;
+	build(b, ringSize);
+	const string pbf = (dir / "multipolygons.osm.pbf").string(), bin = (dir / "multipolygons.bin").string();
+	const string log = (dir / "multipolygons.log").string();
+	b.e.writePBF(pbf);
+	if(runConverter(converter, "\"" + pbf + "\" \"" + bin + "\" > \"" + log + "\""))
+		return fail("Conversion failed");
+	ifstream logFile(log);
+	string line;
+	while(getline(logFile, line) && !line.starts_with("Multipolygons:"));
+	if(ringSize > 1000) cout << "Ring of " << b.e.relations[0].members.size() << " ways. " << line << endl;
+	const string counts = to_string(b.e.relations.size() - 1) + " assembled";
+	if(line.find(counts) == string::npos || line.find(", 1 ill-formed") == string::npos)
+		return fail("Expected " + counts + " and 1 ill-formed multipolygon: " + line);
+
+	OSMData data;
+	data.read(bin.c_str());
+	vector<vector<vector<vec2i>>> found, expected;
+	int64_t expectedArea = 0;
+	uint64_t expectedTriangles = 0;
+	for(uint32_t c = data.forestsR.first; c < data.forestsR.second; ++c)
+		if(!readRings(data, c, found.emplace_back())) return false;
+	for(const vector<vector<vec2i>> &component : b.components) {
+		vector<vector<vec2i>> &rings = expected.emplace_back();
+		for(const vector<vec2i> &ring : component) {
+			rings.push_back(sorted(ring));
+			expectedTriangles += ring.size() + 2;
+			expectedArea += abs(area2(ring)) * (&ring == &component[0] ? 1 : -1);
+		}
+		expectedTriangles -= 4;
+	}
+	for(vector<vector<vec2i>> &rings : found) {
+		if(ranges::any_of(rings, [](const vector<vec2i> &ring) { return ring.size() < 3; }))
+			return fail("A ring has less than 3 nodes");
+		for(vector<vec2i> &ring : rings) ring = sorted(ring);
+	}
+	const auto byPoints = [](const vector<vector<vec2i>> &c) {
+		vector<pair<int, int>> key;
+		for(const vector<vec2i> &ring : c) for(const vec2i &p : ring) key.emplace_back(p.x, p.y);
+		return key;
+	};
+	ranges::sort(found, {}, byPoints);
+	ranges::sort(expected, {}, byPoints);
+	if(found != expected)
+		return fail(to_string(found.size()) + " components found, not the " + to_string(expected.size()) + " expected rings");
+
+	// The extract has no forest way, all triangles are those of the multipolygons
+	if(data.forestIndices.size() != 3 * expectedTriangles)
+		return fail(to_string(data.forestIndices.size() / 3) + " triangles instead of " + to_string(expectedTriangles));
+	int64_t area = 0;
+	for(size_t t = 0; t < data.forestIndices.size(); t += 3)
+		area += abs(area2({data.roads[data.forestIndices[t]], data.roads[data.forestIndices[t+1]], data.roads[data.forestIndices[t+2]]}));
+	if(area != expectedArea) return fail("The triangles do not cover the rings");
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter [size of the ring]" << endl;
+		return 1;
+	}
+	const uint32_t ringSize = argc > 2 ? atoi(argv[2]) : 500;
+	return runInTempDir("multipolygons", [&](const filesystem::path &dir) { return test(argv[1], dir, ringSize); });
+}
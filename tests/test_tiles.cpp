@@ -0,0 +1,130 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Tiles of random polylines: the leaves must cover the root without overlapping, a viewport lookup
+// must return exactly the leaves sharing a point with the viewport, found by going through all of
+// them, and the points of the polylines in the viewport must be in the loaded leaves.
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <ranges>
+#include <unordered_set>
+
+#include "converter/tiles.h"
+#include "data/tiles.h"
+
+#include "synthetic.h"
+
+using namespace std;
+
+static Box<vec2i> box(const vec2i &min, const vec2i &max) {
+	Box<vec2i> b;
+	b.min = min;
+	b.max = max;
+	return b;
+}
+
+static uint64_t key(const vec2i &p) {
+	return uint64_t(uint32_t(p.x)) << 32 | uint32_t(p.y);
+}
+
+static bool test(const filesystem::path &dir) {
+	const filesystem::path file = dir / "tiles.bin";
+	mt19937 rng(11);
+	constexpr int SIZE = 1'000'000;
+	OSMData data;
+	data.bbox = box(vec2i(0, 0), vec2i(SIZE-1, SIZE-1));
+	// Polylines of 2 to 6 points near each other, denser in a corner so that the quadtree is uneven
+	constexpr uint32_t P = 400;
+	data.roadOffsets.assign(1, 0);
+	for(uint32_t i = 0; i < P; ++i) {
+		const int range = i % 2 ? SIZE : SIZE / 16;
+		vec2i p(rng() % range, rng() % range);
+		for(uint32_t n = 2 + rng() % 5; n--;) {
+			data.roads.push_back(p);
+			p.x = clamp<int>(p.x + int(rng() % 40001) - 20000, 0, SIZE-1);
+			p.y = clamp<int>(p.y + int(rng() % 40001) - 20000, 0, SIZE-1);
+		}
+		data.roadOffsets.push_back(data.roads.size());
+	}
+	data.roadTypeOffsets = {0, 100, 200, 300};
+	data.waterWayTypeOffsets = {300, 350};
+	data.boundaries = {350, P};
+	data.lodRoadOffsets.assign(1, 0);
+	data.roadChunks = {0, P};
+	data.refOffsets.assign(1, 0);
+	data.forests = {P, P};
+	data.forestsR = {0, 0};
+	data.forestLodOffsets.assign(1, 0);
+
+	writeTiles(data, file.c_str(), 64, false, false);
+	const TileSet set(file.c_str());
+
+	vector<uint32_t> leaves;
+	for(uint32_t i = 0; i < set.tiles.size(); ++i)
+		if(set.tiles[i].children == TileSet::LEAF) leaves.push_back(i);
+	if(leaves.size() < 16) return fail("Too few leaves to test: " + to_string(leaves.size()));
+	const auto area = [](const Box<vec2i> &b) { return int64_t(b.max.x - b.min.x) * (b.max.y - b.min.y); };
+	int64_t leavesArea = 0;
+	for(const uint32_t a : leaves) {
+		leavesArea += area(set.tiles[a].bbox);
+		for(const uint32_t b : leaves) {
+			const Box<vec2i> &A = set.tiles[a].bbox, &B = set.tiles[b].bbox;
+			if(a != b && A.min.x < B.max.x && B.min.x < A.max.x && A.min.y < B.max.y && B.min.y < A.max.y)
+				return fail("Leaves " + to_string(a) + " and " + to_string(b) + " overlap");
+		}
+	}
+	if(leavesArea != area(set.tiles[0].bbox)) return fail("Leaves do not cover the root");
+
+	// Viewports of all sizes, some of them points or lines, some of them beyond the root,
+	// and some of them with bounds on or next to the bounds of a leaf
+	const auto nearBound = [&](const int bound) { return bound + int(rng() % 3) - 1; };
+	const auto randomViewport = [&]() {
+		if(rng() % 2) {
+			const Box<vec2i> &a = set.tiles[leaves[rng() % leaves.size()]].bbox, &b = set.tiles[leaves[rng() % leaves.size()]].bbox;
+			const vec2i p(nearBound(rng() % 2 ? a.min.x : a.max.x), nearBound(rng() % 2 ? a.min.y : a.max.y));
+			const vec2i q(nearBound(rng() % 2 ? b.min.x : b.max.x), nearBound(rng() % 2 ? b.min.y : b.max.y));
+			return box(vec2i(min(p.x, q.x), min(p.y, q.y)), vec2i(max(p.x, q.x), max(p.y, q.y)));
+		}
+		const int range = rng() % 4 ? SIZE : SIZE / 16;
+		vec2i a(int(rng() % (range + 200'000)) - 100'000, int(rng() % (range + 200'000)) - 100'000);
+		const int scale = array{0, 100, 10'000, 300'000}[rng() % 4];
+		vec2i b(a.x + (scale ? rng() % scale : 0), a.y + (scale ? rng() % scale : 0));
+		return box(a, b);
+	};
+	for(uint32_t v = 0; v < 20000; ++v) {
+		const Box<vec2i> viewport = randomViewport();
+		vector<uint32_t> found = set.query(viewport), expected;
+		// A leaf intersects the viewport if they share an integer point, the leaf excluding its max bounds
+		for(const uint32_t i : leaves) {
+			const Box<vec2i> &t = set.tiles[i].bbox;
+			if(max(viewport.min.x, t.min.x) <= min(viewport.max.x, t.max.x - 1)
+				&& max(viewport.min.y, t.min.y) <= min(viewport.max.y, t.max.y - 1))
+				expected.push_back(i);
+		}
+		ranges::sort(found);
+		if(found != expected)
+			return fail("Viewport " + to_string(v) + ": " + to_string(found.size()) + " leaves found instead of " + to_string(expected.size()));
+
+		if(v % 200) continue;
+		unordered_set<uint64_t> loaded;
+		for(const uint32_t i : found) {
+			const OSMData tile = set.load(i);
+			for(const vec2i &p : tile.roads) loaded.insert(key(p));
+		}
+		for(const vec2i &p : data.roads) {
+			if(viewport.min.x <= p.x && p.x <= viewport.max.x && viewport.min.y <= p.y && p.y <= viewport.max.y
+					&& !loaded.count(key(p)))
+				return fail("Viewport " + to_string(v) + ": a point of the polylines is in none of the loaded tiles");
+		}
+	}
+	return true;
+}
+
+int main() {
+	return runInTempDir("tiles", test);
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2025, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Updates of a synthetic extract: the output converted with a source index, updated with the OsmChange
+// of each change, must be the same as the output and source index of the changed extract converted
+// from scratch, with only the layers the change touches made again.
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "synthetic.h"
+
+#include "converter/source.h"
+
+using namespace std;
+
+static string readFile(const filesystem::path &file) {
+	ifstream in(file, ios::binary);
+	ostringstream content;
+	content << in.rdbuf();
+	return content.str();
+}
+
+struct Change {
+	const char *name;
+	function<void(SyntheticExtract&)> apply;
+	const char *rebuilt; // layers the update makes again, as it prints them
+};
+
+static bool test(const string &converter, const filesystem::path &dir) {
+	constexpr uint32_t SIZE = 30;
+	const SyntheticExtract base = SyntheticExtract::grid(SIZE, 10'000, 6);
+	const auto node = [](SyntheticExtract &e, const uint32_t i, const uint32_t j)->SyntheticExtract::Node& {
+		return e.nodes[e.nodeId(i, j) - 1];
+	};
+	const auto way = [](SyntheticExtract &e, const int64_t id)->SyntheticExtract::Way& {
+		for(SyntheticExtract::Way &w : e.ways) if(w.id == id) return w;
+		throw runtime_error("No way " + to_string(id));
+	};
+	// Rows have 6 ways from id 6*i+1, rivers and forests follow, and the outer way of the multipolygon is last
+	const Change changes[] {
+		{"Moved node of a road", [&](SyntheticExtract &e) {
+			node(e, 5, 3).coords.y += 300;
+		}, " road.primary"},
+		{"Retagged, new and deleted ways", [&](SyntheticExtract &e) {
+			way(e, 6*7+1).tags = {{"waterway", "river"}};
+			erase_if(e.ways, [](const SyntheticExtract::Way &w) { return w.id == 6*9+2; });
+			SyntheticExtract::Way &w = e.ways.emplace_back(SyntheticExtract::Way{1000, {}, {{"highway", "primary"}}});
+			for(uint32_t i = 0; i < 6; ++i) w.refs.push_back(e.nodeId(i, 1));
+		}, " road.primary waterway.river"},
+		{"New forest", [&](SyntheticExtract &e) {
+			e.ways.push_back({1001, {e.nodeId(3, 8), e.nodeId(3, 9), e.nodeId(4, 9), e.nodeId(4, 8), e.nodeId(3, 8)}, {{"landuse", "forest"}}});
+		}, " forest"},
+		{"Moved node of a multipolygon", [&](SyntheticExtract &e) {
+			node(e, SIZE/3 + 1, 2*SIZE/3).coords.x += 500;
+		}, " road.primary forest"},
+		{"Renamed capital and route", [&](SyntheticExtract &e) {
+			node(e, SIZE/2, SIZE/2).tags[2].second = "Grid Town";
+			e.relations[0].tags[3].second = "N 2";
+		}, ""},
+		{"Road out of the box", [&](SyntheticExtract &e) {
+			e.nodes.push_back({100'000, node(e, SIZE-1, SIZE-1).coords + vec2i(50'000, 50'000), {}});
+			e.ways.push_back({1002, {e.nodeId(SIZE-1, SIZE-1), 100'000}, {{"highway", "primary"}}});
+		}, " road.motorway road.trunk road.primary waterway.river boundary forest"},
+	};
+
+	const filesystem::path basePBF = dir / "base.osm.pbf", baseBin = dir / "base.bin";
+	base.writePBF(basePBF.string(), 300);
+	if(runConverter(converter, "--source-index \"" + basePBF.string() + "\" \"" + baseBin.string() + "\" > \"" + (dir / "base.log").string() + "\""))
+		return fail("Conversion of the base failed");
+	for(const Change &change : changes) {
+		SyntheticExtract changed = base;
+		change.apply(changed);
+		const filesystem::path pbf = dir / "changed.osm.pbf", osc = dir / "change.osc", fresh = dir / "fresh.bin";
+		const filesystem::path updated = dir / "updated.bin", log = dir / "update.log";
+		changed.writePBF(pbf.string(), 300);
+		writeOsmChange(base, changed, osc.string());
+		filesystem::copy_file(baseBin, updated, filesystem::copy_options::overwrite_existing);
+		filesystem::copy_file(baseBin.string() + ".idx", updated.string() + ".idx", filesystem::copy_options::overwrite_existing);
+		if(runConverter(converter, "--source-index \"" + pbf.string() + "\" \"" + fresh.string() + "\" > \"" + (dir / "fresh.log").string() + "\"")
+			|| runConverter(converter, "--update \"" + osc.string() + "\" \"" + updated.string() + "\" > \"" + log.string() + "\""))
+			return fail(string(change.name) + ": conversion failed");
+
+		OSMData a, b;
+		a.read(updated.c_str());
+		b.read(fresh.c_str());
+		string difference;
+		if(!sameData(a, b, difference) || a.roadChunks != b.roadChunks)
+			return fail(string(change.name) + ": the update and the fresh conversion differ, " + difference);
+		if(readFile(updated.string() + ".idx") != readFile(fresh.string() + ".idx"))
+			return fail(string(change.name) + ": the source indices differ");
+		const string output = readFile(log);
+		const string expected = string("Layers made again:") + change.rebuilt + ", kept";
+		if(output.find(expected) == string::npos)
+			return fail(string(change.name) + ": expected \"" + expected + "\" in the output of the update");
+		cout << change.name << ": OK" << endl;
+	}
+
+	// An index whose ways are in layers the rules do not have is rejected before it is used
+	SourceIndex index;
+	index.read((baseBin.string() + ".idx").c_str(), numeric_limits<uint32_t>::max());
+	const filesystem::path updated = dir / "updated.bin";
+	filesystem::copy_file(baseBin, updated, filesystem::copy_options::overwrite_existing);
+	index.ways.front().layer = 1000;
+	index.write((updated.string() + ".idx").c_str());
+	if(!runConverter(converter, "--update \"" + (dir / "change.osc").string() + "\" \"" + updated.string() + "\" > \""
+			+ (dir / "update.log").string() + "\" 2>&1"))
+		return fail("Update of an index with an unknown layer did not fail");
+	cout << "Unknown layer: OK" << endl;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " converter" << endl;
+		return 1;
+	}
+	return runInTempDir("update", [&](const filesystem::path &dir) { return test(argv[1], dir); });
+}